@@ -0,0 +1,409 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "archive_index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glibmm/miscutils.h>
+
+using namespace nuc;
+
+/**
+ * Index file magic number and format version.
+ */
+static const char index_magic[] = "NUCAIDX1";
+
+/**
+ * Prefix of the names of the temporary files to which indices are
+ * written before they are renamed.
+ */
+static const char tmp_prefix[] = "index-";
+
+/**
+ * Maximum total size of the saved indices. Once exceeded, the least
+ * recently used indices are removed.
+ */
+static constexpr off_t max_total_size = 64 * 1024 * 1024;
+
+/**
+ * Maximum time, in seconds, for which an index which is not used is
+ * kept.
+ */
+static constexpr time_t max_age = 30 * 24 * 60 * 60;
+
+/**
+ * Returns the directory, within the user's cache directory, in
+ * which archive indices are saved.
+ */
+static std::string index_dir();
+
+/**
+ * Removes the indices, in the index directory, which have not been
+ * used for longer than max_age, and the least recently used indices
+ * while the total size of the indices exceeds max_total_size.
+ *
+ * An index is considered used when it is saved or loaded, which
+ * updates its modification time.
+ *
+ * @param dir Path to the index directory.
+ */
+static void prune_indices(const std::string &dir);
+
+/**
+ * Appends the binary representation of a value to a buffer.
+ *
+ * @param buf The buffer.
+ * @param value The value.
+ */
+template <typename T>
+static void write_value(std::string &buf, T value);
+
+/**
+ * Appends a string, preceded by its length, to a buffer.
+ *
+ * @param buf The buffer.
+ * @param str The string.
+ */
+static void write_string(std::string &buf, const std::string &str);
+
+/**
+ * Reads a value, written by write_value, from a buffer.
+ *
+ * @param buf The buffer.
+ * @param pos Position within the buffer, incremented past the value.
+ * @param value Reference to the value to read into.
+ *
+ * @return True if the value was read, false if the end of the buffer
+ *   was reached.
+ */
+template <typename T>
+static bool read_value(const std::string &buf, size_t &pos, T &value);
+
+/**
+ * Reads a string, written by write_string, from a buffer.
+ *
+ * @param buf The buffer.
+ * @param pos Position within the buffer, incremented past the string.
+ * @param str Reference to the string to read into.
+ *
+ * @return True if the string was read, false if the end of the buffer
+ *   was reached.
+ */
+static bool read_string(const std::string &buf, size_t &pos, std::string &str);
+
+
+//// Entries
+
+lister::entry archive_index::entry::lister_entry() const {
+    lister::entry ent;
+
+    ent.name = name.c_str();
+    ent.type = type;
+
+    return ent;
+}
+
+struct stat archive_index::entry::attributes() const {
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+
+    st.st_size = size;
+    st.st_mtime = mtime;
+    st.st_mode = mode;
+
+    return st;
+}
+
+
+//// Creating the Index
+
+archive_index::archive_index(const pathname::string &key, const pathname &file) : key(key) {
+    struct stat st;
+
+    if (!stat(file.path().c_str(), &st)) {
+        has_stamp = true;
+
+        file_size = st.st_size;
+        file_mtime = st.st_mtim;
+    }
+}
+
+void archive_index::add(const lister::entry &ent, const struct stat &st) {
+    entry idx_ent;
+
+    idx_ent.name = ent.name;
+    idx_ent.type = ent.type;
+    idx_ent.size = st.st_size;
+    idx_ent.mtime = st.st_mtime;
+    idx_ent.mode = st.st_mode;
+
+    m_entries.push_back(std::move(idx_ent));
+}
+
+
+//// Loading and Saving
+
+std::string index_dir() {
+    return Glib::build_filename(Glib::get_user_cache_dir(), "nucommander", "archive-index");
+}
+
+std::string archive_index::index_path() const {
+    std::ostringstream name;
+    name << std::hex << std::hash<std::string>()(key);
+
+    return Glib::build_filename(index_dir(), name.str());
+}
+
+bool archive_index::load() {
+    if (!has_stamp)
+        return false;
+
+    std::string path = index_path();
+    std::ifstream in(path, std::ios::binary);
+
+    if (!in)
+        return false;
+
+    std::string buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    // Indices which are invalid, or stale, are removed as they will
+    // never be loaded.
+
+    if (!parse(buf)) {
+        unlink(path.c_str());
+        return false;
+    }
+
+    // Mark the index as recently used
+
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return true;
+}
+
+bool archive_index::parse(const std::string &buf) {
+    // Check header
+
+    size_t pos = sizeof(index_magic) - 1;
+
+    if (buf.compare(0, pos, index_magic))
+        return false;
+
+    std::string idx_key;
+    int64_t size, sec, nsec;
+    uint64_t count;
+
+    if (!read_string(buf, pos, idx_key) ||
+        !read_value(buf, pos, size) ||
+        !read_value(buf, pos, sec) ||
+        !read_value(buf, pos, nsec) ||
+        !read_value(buf, pos, count))
+        return false;
+
+    // The key is checked, in case of a hash collision.
+    if (idx_key != key || size != file_size || sec != file_mtime.tv_sec || nsec != file_mtime.tv_nsec)
+        return false;
+
+    // Read entries
+
+    std::vector<entry> entries;
+
+    for (uint64_t i = 0; i < count; i++) {
+        entry ent;
+        int64_t ent_size, ent_mtime;
+        uint32_t ent_mode;
+
+        if (!read_string(buf, pos, ent.name) ||
+            !read_value(buf, pos, ent.type) ||
+            !read_value(buf, pos, ent_size) ||
+            !read_value(buf, pos, ent_mtime) ||
+            !read_value(buf, pos, ent_mode))
+            return false;
+
+        ent.size = ent_size;
+        ent.mtime = ent_mtime;
+        ent.mode = ent_mode;
+
+        entries.push_back(std::move(ent));
+    }
+
+    m_entries = std::move(entries);
+    return true;
+}
+
+void archive_index::save() const {
+    if (!has_stamp)
+        return;
+
+    std::string buf(index_magic);
+
+    write_string(buf, key);
+    write_value<int64_t>(buf, file_size);
+    write_value<int64_t>(buf, file_mtime.tv_sec);
+    write_value<int64_t>(buf, file_mtime.tv_nsec);
+    write_value<uint64_t>(buf, m_entries.size());
+
+    for (const entry &ent : m_entries) {
+        write_string(buf, ent.name);
+        write_value<uint8_t>(buf, ent.type);
+        write_value<int64_t>(buf, ent.size);
+        write_value<int64_t>(buf, ent.mtime);
+        write_value<uint32_t>(buf, ent.mode);
+    }
+
+    // The index is written to a temporary file which then replaces
+    // the old index, so that an index which is being written is
+    // never read.
+
+    std::string dir = index_dir();
+
+    if (g_mkdir_with_parents(dir.c_str(), 0700))
+        return;
+
+    std::string tmp_path = Glib::build_filename(dir, std::string(tmp_prefix) + "XXXXXX");
+    int fd = mkstemp(&tmp_path[0]);
+
+    if (fd < 0)
+        return;
+
+    const char *data = buf.data();
+    size_t left = buf.size();
+
+    while (left) {
+        ssize_t n = write(fd, data, left);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        data += n;
+        left -= n;
+    }
+
+    if (close(fd) || left || rename(tmp_path.c_str(), index_path().c_str()))
+        unlink(tmp_path.c_str());
+
+    prune_indices(dir);
+}
+
+void prune_indices(const std::string &dir) {
+    struct index_file {
+        std::string path;
+        off_t size;
+        time_t mtime;
+    };
+
+    DIR *dp = opendir(dir.c_str());
+
+    if (!dp) return;
+
+    std::vector<index_file> files;
+    off_t total = 0;
+    time_t now = time(nullptr);
+
+    while (struct dirent *ent = readdir(dp)) {
+        struct stat st;
+
+        // Skip temporary files, which may be being written
+        if (ent->d_name[0] == '.' || !strncmp(ent->d_name, tmp_prefix, sizeof(tmp_prefix) - 1))
+            continue;
+
+        std::string path = Glib::build_filename(dir, ent->d_name);
+
+        if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode))
+            continue;
+
+        if (now - st.st_mtime > max_age) {
+            unlink(path.c_str());
+            continue;
+        }
+
+        files.push_back(index_file{path, st.st_size, st.st_mtime});
+        total += st.st_size;
+    }
+
+    closedir(dp);
+
+    // Remove least recently used first
+
+    std::sort(files.begin(), files.end(), [] (const index_file &a, const index_file &b) {
+        return a.mtime < b.mtime;
+    });
+
+    for (auto it = files.begin(); total > max_total_size && it != files.end(); ++it) {
+        if (!unlink(it->path.c_str()))
+            total -= it->size;
+    }
+}
+
+
+//// Serialization
+
+template <typename T>
+void write_value(std::string &buf, T value) {
+    buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void write_string(std::string &buf, const std::string &str) {
+    write_value<uint32_t>(buf, str.size());
+    buf.append(str);
+}
+
+template <typename T>
+bool read_value(const std::string &buf, size_t &pos, T &value) {
+    if (buf.size() - pos < sizeof(T))
+        return false;
+
+    memcpy(&value, buf.data() + pos, sizeof(T));
+    pos += sizeof(T);
+
+    return true;
+}
+
+bool read_string(const std::string &buf, size_t &pos, std::string &str) {
+    uint32_t len;
+
+    if (!read_value(buf, pos, len) || buf.size() - pos < len)
+        return false;
+
+    str.assign(buf, pos, len);
+    pos += len;
+
+    return true;
+}
+
+// Local Variables:
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,164 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_DIRECTORY_ARCHIVE_INDEX_H
+#define NUC_DIRECTORY_ARCHIVE_INDEX_H
+
+#include <string>
+#include <vector>
+
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "paths/pathname.h"
+#include "lister/lister.h"
+
+namespace nuc {
+    /**
+     * Persistent index of the entries of an archive.
+     *
+     * The index stores the entries, of an archive, in the order in
+     * which they were read by the archive lister, together with
+     * their type and stat attributes. It is saved in the user's
+     * cache directory, so that an archive which is visited again,
+     * even after the application is restarted, can be listed
+     * without decompressing it.
+     *
+     * An index is identified by the logical path to the archive,
+     * and is only loaded if the size and modification time of the
+     * archive file, on disk, are the same as when the index was
+     * saved. For archives nested in other archives, the on-disk file
+     * is the outermost archive.
+     *
+     * Only the entry table is stored, not the offsets of the
+     * entries' data within the archive, thus the index avoids
+     * decompressing the archive when it is listed, but not when an
+     * entry is extracted.
+     */
+    class archive_index {
+    public:
+        /**
+         * Archive entry.
+         */
+        struct entry {
+            /** Entry name as returned by the lister */
+            pathname::string name;
+            /** Entry type (DT_ constant) */
+            uint8_t type;
+
+            /** Stat attributes */
+            off_t size;
+            time_t mtime;
+            mode_t mode;
+
+            /**
+             * @return The entry as a lister::entry, which refers to
+             *   the name of this entry.
+             */
+            lister::entry lister_entry() const;
+
+            /**
+             * @return The stat attributes of the entry. Only the
+             *   attributes stored in the index are set.
+             */
+            struct stat attributes() const;
+        };
+
+        /**
+         * Creates an empty index for an archive.
+         *
+         * @param key Logical path to the archive.
+         * @param file Path to the archive file on disk.
+         */
+        archive_index(const pathname::string &key, const pathname &file);
+
+        /**
+         * Loads the saved index of the archive.
+         *
+         * A saved index, which is invalid or was saved before the
+         * archive was changed, is removed.
+         *
+         * @return True if the index was loaded, false if there is no
+         *   saved index or the archive has changed since it was
+         *   saved.
+         */
+        bool load();
+
+        /**
+         * Adds an entry to the index.
+         *
+         * @param ent The entry, as read by the lister.
+         * @param st Stat attributes of the entry.
+         */
+        void add(const lister::entry &ent, const struct stat &st);
+
+        /**
+         * Saves the index to the cache directory. Does nothing if the
+         * archive file's attributes could not be retrieved.
+         *
+         * Errors are ignored as the index is only a cache.
+         */
+        void save() const;
+
+        /**
+         * @return The entries in the index.
+         */
+        const std::vector<entry> &entries() const {
+            return m_entries;
+        }
+
+    private:
+        /** Logical path to the archive */
+        pathname::string key;
+
+        /** Flag: Were the archive file's attributes retrieved */
+        bool has_stamp = false;
+
+        /** Size of the archive file */
+        off_t file_size = 0;
+        /** Modification time of the archive file */
+        struct timespec file_mtime = {0, 0};
+
+        /** Index entries */
+        std::vector<entry> m_entries;
+
+        /**
+         * @return Path to the file in which the index is saved.
+         */
+        std::string index_path() const;
+
+        /**
+         * Parses the contents of a saved index file, and stores its
+         * entries in m_entries.
+         *
+         * @param buf Contents of the index file.
+         *
+         * @return True if the index was parsed, false if it is
+         *   invalid or the archive has changed since it was saved.
+         */
+        bool parse(const std::string &buf);
+    };
+}
+
+#endif // NUC_DIRECTORY_ARCHIVE_INDEX_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -42,10 +42,27 @@ dir_entry *archive_tree::get_entry(const pathname::string &name) {
     return dir_tree::get_entry(m_subpath.append(name).canonicalize());
 }
 
-dir_tree::entry_range archive_tree::get_entries(const pathname::string &name) {
+dir_tree::entry_list archive_tree::get_entries(const pathname::string &name) {
     return dir_tree::get_entries(m_subpath.append(name).canonicalize());
 }
 
+size_t archive_tree::memory_size() const {
+    // Estimated size of a node of the directory maps
+    const size_t node_size = 2 * sizeof(void *) + sizeof(dir_map::value_type);
+
+    size_t size = dir_tree::memory_size();
+
+    for (auto &dir : dirs) {
+        size += node_size + dir.first.path().size() + dir.second.bucket_count() * sizeof(void *);
+
+        for (auto &ent : dir.second) {
+            size += node_size + ent.first.size();
+        }
+    }
+
+    return size;
+}
+
 
 dir_entry *archive_tree::add_entry(dir_entry ent) {
     dir_entry * dir_ent = ent.type() == dir_entry::type_dir ?
@@ -100,13 +117,13 @@ dir_entry *archive_tree::add_components(const pathname &path, dir_entry &ent) {
 
 
 dir_entry * archive_tree::add_dir_entry(nuc::dir_entry ent) {
-    auto range = map.equal_range(ent.subpath());
+    dir_entry *dir_ent = map.find_if(ent.subpath().path(), [] (const dir_entry &existing) {
+        return existing.type() == dir_entry::type_dir;
+    });
 
-    for (auto it = range.first; it != range.second; ++it) {
-        if (it->second.type() == dir_entry::type_dir) {
-            it->second = std::move(ent);
-            return &it->second;
-        }
+    if (dir_ent) {
+        *dir_ent = std::move(ent);
+        return dir_ent;
     }
 
     return dir_tree::add_entry(std::move(ent));
@@ -126,19 +143,15 @@ bool archive_tree::add_to_map(file_map<dir_entry *> &map, const pathname::string
 }
 
 dir_entry &archive_tree::make_dir_ent(const pathname &path) {
-    auto range = map.equal_range(path);
+    dir_entry *dir_ent = map.find_if(path.path(), [] (const dir_entry &ent) {
+        return ent.ent_type() == dir_entry::type_dir;
+    });
 
-    for (auto it = range.first; it != range.second; ++it) {
-        dir_entry &ent = it->second;
-
-        if (ent.ent_type() == dir_entry::type_dir) {
-            return ent;
-        }
+    if (dir_ent) {
+        return *dir_ent;
     }
 
-    dir_entry &ent = map.emplace(path, dir_entry(path, dir_entry::type_dir))->second;
-
-    return ent;
+    return map.add(dir_entry(path, dir_entry::type_dir));
 }
 
 
@@ -68,7 +68,9 @@ namespace nuc {
         }
 
         virtual dir_entry *get_entry(const pathname::string &name);
-        virtual entry_range get_entries(const pathname::string &name);
+        virtual entry_list get_entries(const pathname::string &name);
+
+        virtual size_t memory_size() const;
 
     private:
         /**
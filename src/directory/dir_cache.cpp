@@ -0,0 +1,145 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dir_cache.h"
+
+#include <iterator>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "settings/app_settings.h"
+
+using namespace nuc;
+
+
+//// Stamps
+
+bool dir_cache::stamp::get(const pathname &path) {
+    struct stat st;
+
+    if (stat(path.path().c_str(), &st))
+        return false;
+
+    dev = st.st_dev;
+    ino = st.st_ino;
+    mtime = st.st_mtim;
+    ctime = st.st_ctim;
+
+    return true;
+}
+
+bool dir_cache::stamp::operator==(const stamp &other) const {
+    return dev == other.dev && ino == other.ino &&
+        mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec &&
+        ctime.tv_sec == other.ctime.tv_sec && ctime.tv_nsec == other.ctime.tv_nsec;
+}
+
+
+//// Caching Trees
+
+dir_cache &dir_cache::instance() {
+    static dir_cache cache;
+    return cache;
+}
+
+std::string dir_cache::key(const dir_type &type) {
+    if (type.is_dir())
+        return type.path().path();
+
+    return type.change_subpath("")->logical_path().path();
+}
+
+void dir_cache::store(const std::string &key, std::shared_ptr<dir_tree> tree, const stamp &st) {
+    size_t budget = app_settings::instance().dir_cache_size() * 1024 * 1024;
+    size_t size = tree->memory_size();
+
+    // Trees evicted from the cache are only destroyed after the
+    // mutex is released.
+    std::vector<std::shared_ptr<dir_tree>> evicted;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+
+    if (it != index.end()) {
+        evicted.push_back(it->second->tree);
+        remove(it->second);
+    }
+
+    if (!st.valid() || size > budget)
+        return;
+
+    while (!entries.empty() && total_size + size > budget) {
+        evicted.push_back(entries.back().tree);
+        remove(std::prev(entries.end()));
+    }
+
+    cache_entry ent;
+
+    ent.key = key;
+    ent.tree = std::move(tree);
+    ent.dir_stamp = st;
+    ent.size = size;
+
+    entries.push_front(std::move(ent));
+    index.emplace(key, entries.begin());
+
+    total_size += size;
+}
+
+std::shared_ptr<dir_tree> dir_cache::take(const std::string &key, const stamp &st) {
+    std::shared_ptr<dir_tree> tree;
+    bool valid;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = index.find(key);
+
+        if (it == index.end())
+            return nullptr;
+
+        tree = it->second->tree;
+        valid = it->second->dir_stamp == st;
+
+        remove(it->second);
+    }
+
+    // Stale trees are destroyed after the mutex is released.
+    return valid ? tree : nullptr;
+}
+
+bool dir_cache::contains(const std::string &key, const stamp &st) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = index.find(key);
+    return it != index.end() && it->second->dir_stamp == st;
+}
+
+void dir_cache::remove(std::list<cache_entry>::iterator it) {
+    total_size -= it->size;
+
+    index.erase(it->key);
+    entries.erase(it);
+}
+
+// Local Variables:
+// indent-tabs-mode: nil
+// End:
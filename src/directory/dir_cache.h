@@ -0,0 +1,188 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_DIRECTORY_DIR_CACHE_H
+#define NUC_DIRECTORY_DIR_CACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <time.h>
+#include <sys/types.h>
+
+#include "paths/pathname.h"
+
+#include "dir_type.h"
+#include "dir_tree.h"
+
+namespace nuc {
+    /**
+     * Cache of the directory trees of recently visited directories.
+     *
+     * Each tree is stored together with the modification stamp of
+     * the directory, or archive file, at the time it was read. A
+     * cached tree is only returned if the directory's current stamp
+     * is the same.
+     *
+     * The total estimated memory of the cached trees is kept within
+     * the dir-cache-size setting by evicting the least recently
+     * stored trees.
+     *
+     * The cache may be accessed from multiple threads.
+     */
+    class dir_cache {
+    public:
+        /**
+         * Modification stamp of a directory or file.
+         */
+        struct stamp {
+            /** Device and inode. */
+            dev_t dev = 0;
+            ino_t ino = 0;
+
+            /** Modification and status change times. */
+            struct timespec mtime = {0, 0};
+            struct timespec ctime = {0, 0};
+
+            /**
+             * Retrieves the stamp of the file at @a path.
+             *
+             * @param path Path to the file.
+             *
+             * @return True if the stamp was retrieved, false if the
+             *   file's stat attributes could not be retrieved.
+             */
+            bool get(const pathname &path);
+
+            /**
+             * @return True if the stamp has been retrieved.
+             */
+            bool valid() const {
+                return dev || ino;
+            }
+
+            bool operator==(const stamp &other) const;
+        };
+
+
+        /**
+         * Returns the singleton instance.
+         */
+        static dir_cache &instance();
+
+        /**
+         * Adds a tree to the cache, replacing the tree which was
+         * previously cached for the same directory, if any.
+         *
+         * The tree must no longer be in use, as it is handed out, as
+         * is, by take.
+         *
+         * @param key Key identifying the directory.
+         * @param tree The directory tree.
+         * @param st The stamp of the directory when the tree was read.
+         */
+        void store(const std::string &key, std::shared_ptr<dir_tree> tree, const stamp &st);
+
+        /**
+         * Removes the tree of a directory from the cache and returns
+         * it, if its stamp is the same as @a st.
+         *
+         * @param key Key identifying the directory.
+         * @param st The current stamp of the directory.
+         *
+         * @return The tree or nullptr if there is no tree cached for
+         *   the directory or the directory has changed since it was
+         *   cached.
+         */
+        std::shared_ptr<dir_tree> take(const std::string &key, const stamp &st);
+
+        /**
+         * Checks whether an up to date tree is cached for a
+         * directory.
+         *
+         * @param key Key identifying the directory.
+         * @param st The current stamp of the directory.
+         *
+         * @return True if a tree is cached for the directory and its
+         *   stamp is the same as @a st.
+         */
+        bool contains(const std::string &key, const stamp &st);
+
+        /**
+         * Returns the key identifying a directory in the cache.
+         *
+         * On-disk directories are identified by their path. Archives
+         * are identified by the logical path to the archive file, as
+         * the tree of an archive contains all its subdirectories.
+         *
+         * @param type The dir_type of the directory.
+         *
+         * @return The key.
+         */
+        static std::string key(const dir_type &type);
+
+    private:
+        /**
+         * Cached directory tree.
+         */
+        struct cache_entry {
+            /** Directory key */
+            std::string key;
+            /** The directory tree */
+            std::shared_ptr<dir_tree> tree;
+            /** Stamp of the directory */
+            stamp dir_stamp;
+            /** Estimated memory size of the tree */
+            size_t size;
+        };
+
+        std::mutex mutex;
+
+        /**
+         * Cached trees, most recently stored first.
+         */
+        std::list<cache_entry> entries;
+
+        /**
+         * Index of the cached trees by key.
+         */
+        std::unordered_map<std::string, std::list<cache_entry>::iterator> index;
+
+        /**
+         * Total estimated memory size of the cached trees.
+         */
+        size_t total_size = 0;
+
+        /**
+         * Removes a tree from the cache.
+         *
+         * @param it Iterator to the tree's cache entry.
+         */
+        void remove(std::list<cache_entry>::iterator it);
+    };
+}
+
+#endif // NUC_DIRECTORY_DIR_CACHE_H
+
+// Local Variables:
+// mode: c++
+// End:
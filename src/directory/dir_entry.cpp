@@ -23,46 +23,61 @@
 
 using namespace nuc;
 
+/**
+ * Returns the size of the memory allocated by a string, excluding
+ * the size of the string object itself.
+ *
+ * @param str The string.
+ *
+ * @return The size in bytes, 0 if the string is stored within the
+ *   string object.
+ */
+static size_t string_memory_size(const std::string &str);
+
 
 dir_entry::dir_entry(const pathname orig_name, uint8_t type) : dir_entry(orig_name, dt_to_entry_type(type)) {}
 
 // The default constructor call m_attr() is required to value
-// initialize all members of the stat struct to zero
+// initialize all members of the attributes struct to zero
 
-dir_entry::dir_entry(const pathname orig_name, entry_type type)
-    : m_orig_subpath(orig_name), m_subpath(orig_name.canonicalize()),
-      m_file_name(m_subpath.basename()), m_attr(), m_type(type) {}
+dir_entry::dir_entry(const pathname orig_name, entry_type type) : m_attr(), m_type(type) {
+    orig_subpath(orig_name);
+}
 
 
 dir_entry::dir_entry(const lister::entry &ent) : dir_entry(ent.name, ent.type) {}
 
 dir_entry::dir_entry(const lister::entry &ent, const struct stat &st) : dir_entry(ent.name, ent.type) {
-    m_attr = st;
+    attr(st);
 }
 
 dir_entry::dir_entry(pathname path, const struct stat &st) : dir_entry(std::move(path), IFTODT(st.st_mode & S_IFMT)) {
-    m_attr = st;
+    attr(st);
 }
 
 
 const pathname &dir_entry::orig_subpath() const {
-    return m_orig_subpath;
+    return m_orig_subpath.empty() ? m_subpath : m_orig_subpath;
 }
 void dir_entry::orig_subpath(nuc::pathname path) {
-    m_orig_subpath = path;
-    subpath(std::move(path).canonicalize());
+    pathname canonical = path.canonicalize();
+
+    m_orig_subpath = path.path() != canonical.path() ? std::move(path) : pathname();
+    subpath(canonical);
 }
 
 const pathname &dir_entry::subpath() const {
     return m_subpath;
 }
 void dir_entry::subpath(const pathname &path) {
+    pathname::string name = path.basename();
+
     m_subpath = path;
-    m_file_name = path.basename();
+    m_file_name = name != path.path() ? std::move(name) : pathname::string();
 }
 
 const pathname::string &dir_entry::file_name() const {
-    return m_file_name;
+    return m_file_name.empty() ? m_subpath.path() : m_file_name;
 }
 
 
@@ -78,7 +93,7 @@ void dir_entry::ent_type(uint8_t type) noexcept {
 
 
 dir_entry::entry_type dir_entry::type() const noexcept {
-    uint8_t type = IFTODT(m_attr.st_mode);
+    uint8_t type = IFTODT(m_attr.mode);
 
     return type != DT_UNKNOWN ? dt_to_entry_type(type) : m_type;
 }
@@ -114,9 +129,33 @@ dir_entry::entry_type dir_entry::dt_to_entry_type(uint8_t type) noexcept {
 }
 
 
-const struct stat &dir_entry::attr() const {
+const dir_entry::attributes &dir_entry::attr() const {
     return m_attr;
 }
 void dir_entry::attr(const struct stat &st) {
-    m_attr = st;
+    m_attr.size = st.st_size;
+    m_attr.mtime = st.st_mtime;
+    m_attr.mode = st.st_mode;
+}
+
+bool dir_entry::has_attr() const noexcept {
+    return m_attr.mode != 0;
+}
+
+
+size_t dir_entry::memory_size() const noexcept {
+    return sizeof(dir_entry) +
+        string_memory_size(m_orig_subpath.path()) +
+        string_memory_size(m_subpath.path()) +
+        string_memory_size(m_file_name);
+}
+
+size_t string_memory_size(const std::string &str) {
+    const char *obj = reinterpret_cast<const char *>(&str);
+
+    // Short strings are stored in the string object itself
+    if (str.data() >= obj && str.data() < obj + sizeof(str))
+        return 0;
+
+    return str.capacity() + 1;
 }
@@ -55,6 +55,28 @@ namespace nuc {
             type_parent
         };
 
+        /**
+         * Stat attributes of the underlying file which are used by
+         * the file list. Only these are stored, rather than the
+         * full stat struct, to keep entries compact.
+         */
+        struct attributes {
+            /**
+             * File size in bytes.
+             */
+            off_t size;
+
+            /**
+             * Last modification time.
+             */
+            time_t mtime;
+
+            /**
+             * File type and mode.
+             */
+            mode_t mode;
+        };
+
         /**
          * Stores context data. This field is not used by the vfs
          * class.
@@ -165,20 +187,40 @@ namespace nuc {
         /**
          * Returns the stat attributes.
          *
-         * @return Reference to stat struct
+         * @return Reference to the attributes.
          */
-        const struct stat &attr() const;
+        const attributes &attr() const;
 
         /**
          * Sets the stat attributes.
          *
-         * @param st The new stat attribute struct.
+         * @param st The stat struct from which to copy the
+         *    attributes.
          */
         void attr(const struct stat &st);
 
+        /**
+         * Returns true if the entry has stat attributes. Entries of
+         * on-disk directories are created without attributes, which
+         * are set once they are retrieved.
+         *
+         * @return True if the stat attributes have been set.
+         */
+        bool has_attr() const noexcept;
+
+
+        /**
+         * Returns an estimate of the memory occupied by the entry,
+         * including the memory allocated for its path strings.
+         *
+         * @return The size in bytes.
+         */
+        size_t memory_size() const noexcept;
+
     private:
         /**
-         * Original non-canonicalized subpath of the entry.
+         * Original non-canonicalized subpath of the entry. Empty if
+         * it is the same as the canonicalized subpath.
          */
         pathname m_orig_subpath;
         /**
@@ -187,14 +229,19 @@ namespace nuc {
         pathname m_subpath;
         /**
          * The file name of the entry, i.e. the basename of the
-         * canonicalized subpath of the entry.
+         * canonicalized subpath of the entry. Empty if it is the
+         * same as the canonicalized subpath.
+         *
+         * For entries of on-disk directories, the original subpath,
+         * canonicalized subpath and file name are all the same
+         * string, thus only a single copy of it is stored.
          */
         pathname::string m_file_name;
 
         /**
          * Stat attributes of the underlying file.
          */
-        struct stat m_attr;
+        attributes m_attr;
 
         /**
          * The type of the entry itself, not the underlying file.
@@ -0,0 +1,89 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dir_prefetcher.h"
+
+#include "errors/error.h"
+
+#include "dir_type.h"
+#include "dir_cache.h"
+
+using namespace nuc;
+
+dir_prefetcher &dir_prefetcher::instance() {
+    static dir_prefetcher prefetcher;
+    return prefetcher;
+}
+
+void dir_prefetcher::prefetch(const std::vector<pathname> &paths) {
+    queue->cancel();
+
+    for (const pathname &path : paths) {
+        queue->add([path] (cancel_state &state) {
+            read_dir(state, path);
+        });
+    }
+}
+
+void dir_prefetcher::cancel() {
+    queue->cancel();
+}
+
+void dir_prefetcher::read_dir(cancel_state &state, const pathname &path) {
+    try {
+        auto type = dir_type::get(path);
+
+        if (!type->is_dir())
+            return;
+
+        std::string key = dir_cache::key(*type);
+        dir_cache::stamp stamp;
+
+        if (!stamp.get(type->path()) || dir_cache::instance().contains(key, stamp))
+            return;
+
+        std::shared_ptr<dir_tree> tree(type->create_tree());
+        std::unique_ptr<lister> listr(type->create_lister());
+
+        lister::entry ent;
+        struct stat st;
+
+        while (listr->read_entry(ent)) {
+            state.test_cancel();
+
+            // Entries of which the attributes cannot be retrieved
+            // are still added, as they are when the directory is
+            // read in the foreground.
+
+            if (listr->entry_stat(st))
+                tree->add_entry(ent, st);
+            else
+                tree->add_entry(dir_entry(ent));
+        }
+
+        dir_cache::instance().store(key, std::move(tree), stamp);
+    }
+    catch (const error &) {
+        // Directories which cannot be read are simply not cached.
+    }
+}
+
+// Local Variables:
+// indent-tabs-mode: nil
+// End:
@@ -0,0 +1,86 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_DIRECTORY_DIR_PREFETCHER_H
+#define NUC_DIRECTORY_DIR_PREFETCHER_H
+
+#include <memory>
+#include <vector>
+
+#include "paths/pathname.h"
+
+#include "tasks/task_queue.h"
+
+namespace nuc {
+    /**
+     * Reads directories, which are likely to be visited next, into
+     * the directory cache in the background.
+     *
+     * Prefetching is performed on a separate task queue, shared by
+     * all file lists. It is cancelled as soon as a directory is read
+     * in the foreground, so that it does not compete with it for I/O.
+     *
+     * Only on-disk directories are prefetched, as the subdirectories
+     * of an archive are already contained in the archive's tree.
+     */
+    class dir_prefetcher {
+    public:
+        /**
+         * Returns the singleton instance.
+         */
+        static dir_prefetcher &instance();
+
+        /**
+         * Reads directories into the directory cache, replacing the
+         * directories which are currently queued.
+         *
+         * Directories which are already cached, and have not changed
+         * since, are not reread.
+         *
+         * @param paths Paths to the directories, in order of
+         *   priority.
+         */
+        void prefetch(const std::vector<pathname> &paths);
+
+        /**
+         * Cancels prefetching.
+         */
+        void cancel();
+
+    private:
+        /**
+         * Prefetching task queue.
+         */
+        std::shared_ptr<task_queue> queue = task_queue::create();
+
+        /**
+         * Reads a directory into the directory cache.
+         *
+         * @param state Cancellation state.
+         * @param path Path to the directory.
+         */
+        static void read_dir(cancel_state &state, const pathname &path);
+    };
+}
+
+#endif // NUC_DIRECTORY_DIR_PREFETCHER_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -26,26 +26,16 @@ dir_entry* dir_tree::add_entry(const lister::entry &ent, const struct stat &st)
 }
 
 dir_entry* dir_tree::add_entry(dir_entry ent) {
-    pathname::string key = ent.subpath();
-
-    dir_entry &dir_ent = map.emplace(key, std::move(ent))->second;
-
-    return &dir_ent;
+    return &map.add(std::move(ent));
 }
 
 
 dir_entry *dir_tree::get_entry(const pathname::string &name) {
-    auto it = map.find(name);
-
-    if (it != map.end()) {
-        return &it->second;
-    }
-
-    return nullptr;
+    return map.find(name);
 }
 
-dir_tree::entry_range dir_tree::get_entries(const pathname::string &name) {
-    return map.equal_range(name);
+dir_tree::entry_list dir_tree::get_entries(const pathname::string &name) {
+    return map.find_all(name);
 }
 
 // Local Variables:
@@ -23,6 +23,7 @@
 #include "types.h"
 #include "lister/lister.h"
 #include "dir_entry.h"
+#include "entry_index.h"
 
 namespace nuc {
     /**
@@ -40,24 +41,22 @@ namespace nuc {
     class dir_tree {
     protected:
         /**
-         * File index stored as an unordered multi-map where each key
-         * is the file subpath and the corresponding value is the
-         * 'dir_entry' object.
+         * File index storing the 'dir_entry' objects indexed by
+         * their subpaths.
          *
-         * A multi-map is used since certain virtual file systems,
-         * such as archives, may contain multiple files with the same
-         * name.
+         * Multiple entries may have the same subpath since certain
+         * virtual file systems, such as archives, may contain
+         * multiple files with the same name.
          */
-        file_map<dir_entry> map;
+        entry_index map;
 
     public:
 
         /**
-         * Iterator range type. A pair of iterators is returned by
-         * get_entries, which corresponds to all entries with a
-         * particular name.
+         * Entry list type. An array of pointers to all entries with
+         * a particular name is returned by get_entries.
          */
-        typedef std::pair<file_map<dir_entry>::iterator, file_map<dir_entry>::iterator> entry_range;
+        typedef std::vector<dir_entry *> entry_list;
 
         /**
          * Directory map type.
@@ -175,21 +174,27 @@ namespace nuc {
          *
          * @param name The name of the entry/ies.
          *
-         * @return A pair of iterators where the first iterator is the
-         *   iterator to the first entry and the second iterator is
-         *   the past the end iterator.
+         * @return Array of pointers to the entries.
          */
-        virtual entry_range get_entries(const pathname::string &name);
+        virtual entry_list get_entries(const pathname::string &name);
+
+        /**
+         * Returns an estimate of the memory occupied by the tree.
+         *
+         * @return The size in bytes.
+         */
+        virtual size_t memory_size() const {
+            return map.memory_size();
+        }
 
         /**
          * Returns the directory index.
          *
-         * The index is a map where the each key is the canonicalized
-         * subpath to an entry in the tree and the corresponding value
-         * is the dir_entry* object.
+         * The index contains all entries in the tree, indexed by
+         * their canonicalized subpaths.
          *
-         * @return A reference to the map (index) containing all
-         *    entries in the directory tree.
+         * @return A reference to the index containing all entries
+         *    in the directory tree.
          */
         auto index() -> decltype(map) & {
             return map;
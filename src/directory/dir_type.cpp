@@ -33,6 +33,8 @@
 #include "lister/sub_archive_lister.h"
 
 #include "archive_tree.h"
+#include "archive_index.h"
+#include "dir_cache.h"
 #include "plugins/archive_plugin_loader.h"
 
 #include "stream/reg_dir_writer.h"
@@ -417,10 +419,26 @@ std::pair<pathname, pathname> find_archive_file(std::shared_ptr<dir_type> dtype,
     // Longest subpath of dir that is actually in the archive.
     pathname subpath;
 
-    std::unique_ptr<lister> listr(dtype->create_lister());
-    lister::entry ent;
+    // The archive is only listed if it does not have an up to date
+    // index. The index is then saved, so that the archive is not
+    // listed again when it is read.
+    archive_index index(dir_cache::key(*dtype), dtype->path());
 
-    while (listr->read_entry(ent)) {
+    if (!index.load()) {
+        std::unique_ptr<lister> listr(dtype->create_lister());
+
+        lister::entry ent;
+        struct stat st;
+
+        while (listr->read_entry(ent)) {
+            if (listr->entry_stat(st))
+                index.add(ent, st);
+        }
+
+        index.save();
+    }
+
+    for (auto &ent : index.entries()) {
         pathname name = ent.name;
         name = name.canonicalize();
 
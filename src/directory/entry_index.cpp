@@ -0,0 +1,192 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "entry_index.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace nuc;
+
+/**
+ * Capacity of the first block of entries. The capacity of each
+ * following block is equal to the number of entries stored in the
+ * preceding blocks, up to max_block_size.
+ */
+static const size_t min_block_size = 16;
+
+/**
+ * Maximum capacity of a block of entries.
+ */
+static const size_t max_block_size = 4096;
+
+/**
+ * Minimum number of hash table slots.
+ */
+static const size_t min_slots = 16;
+
+const uint32_t entry_index::empty_slot;
+const uint32_t entry_index::removed_slot;
+
+
+//// Copying
+
+entry_index::entry_index(const entry_index &other) {
+    *this = other;
+}
+
+entry_index &entry_index::operator=(const entry_index &other) {
+    if (this == &other) return *this;
+
+    blocks.clear();
+    entries.clear();
+    slots.clear();
+
+    count = 0;
+    used = 0;
+
+    for (dir_entry &ent : other) {
+        add(ent);
+    }
+
+    return *this;
+}
+
+
+//// Adding and Removing Entries
+
+dir_entry &entry_index::add(dir_entry ent) {
+    if ((used + 1) * 4 > slots.size() * 3)
+        rehash();
+
+    dir_entry &new_ent = store(std::move(ent));
+
+    entries.push_back(&new_ent);
+    insert_slot(entries.size() - 1);
+
+    count++;
+
+    return new_ent;
+}
+
+size_t entry_index::erase(const pathname::string &subpath) {
+    if (slots.empty()) return 0;
+
+    size_t mask = slots.size() - 1;
+    size_t n = 0;
+
+    for (size_t i = first_slot(subpath); slots[i] != empty_slot; i = (i + 1) & mask) {
+        if (slots[i] != removed_slot) {
+            dir_entry *&ent = entries[slots[i] - 1];
+
+            if (ent->subpath().path() == subpath) {
+                ent = nullptr;
+                slots[i] = removed_slot;
+
+                n++;
+            }
+        }
+    }
+
+    count -= n;
+    return n;
+}
+
+
+//// Lookup
+
+std::vector<dir_entry *> entry_index::find_all(const pathname::string &subpath) const {
+    std::vector<dir_entry *> found;
+
+    find_if(subpath, [&] (dir_entry &ent) {
+        found.push_back(&ent);
+        return false;
+    });
+
+    return found;
+}
+
+
+//// Memory Usage
+
+size_t entry_index::memory_size() const {
+    size_t size = entries.capacity() * sizeof(dir_entry *) + slots.capacity() * sizeof(uint32_t);
+
+    for (auto &block : blocks) {
+        size += (block.capacity() - block.size()) * sizeof(dir_entry);
+
+        for (auto &ent : block) {
+            size += ent.memory_size();
+        }
+    }
+
+    return size;
+}
+
+
+//// Hash Table
+
+size_t entry_index::first_slot(const pathname::string &subpath) const {
+    return std::hash<pathname::string>()(subpath) & (slots.size() - 1);
+}
+
+void entry_index::insert_slot(size_t pos) {
+    size_t mask = slots.size() - 1;
+    size_t i = first_slot(entries[pos]->subpath().path());
+
+    while (slots[i] != empty_slot && slots[i] != removed_slot)
+        i = (i + 1) & mask;
+
+    if (slots[i] == empty_slot)
+        used++;
+
+    slots[i] = pos + 1;
+}
+
+void entry_index::rehash() {
+    size_t size = min_slots;
+
+    while (size * 3 < (count + 1) * 8)
+        size *= 2;
+
+    slots.assign(size, empty_slot);
+    used = 0;
+
+    for (size_t pos = 0; pos < entries.size(); pos++) {
+        if (entries[pos])
+            insert_slot(pos);
+    }
+}
+
+
+//// Entry Storage
+
+dir_entry &entry_index::store(dir_entry ent) {
+    if (blocks.empty() || blocks.back().size() == blocks.back().capacity()) {
+        blocks.emplace_back();
+        blocks.back().reserve(std::min(max_block_size, std::max(min_block_size, entries.size())));
+    }
+
+    blocks.back().push_back(std::move(ent));
+    return blocks.back().back();
+}
+
+// Local Variables:
+// indent-tabs-mode: nil
+// End:
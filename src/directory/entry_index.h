@@ -0,0 +1,304 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_DIRECTORY_ENTRY_INDEX_H
+#define NUC_DIRECTORY_ENTRY_INDEX_H
+
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <cstddef>
+
+#include <stdint.h>
+
+#include "dir_entry.h"
+
+namespace nuc {
+    /**
+     * Storage and index of the entries in a directory tree.
+     *
+     * Entries are stored in blocks of contiguous memory, which are
+     * never reallocated, thus pointers to entries remain valid for
+     * the lifetime of the index. Entries are indexed by canonicalized
+     * subpath in an open-addressing hash table, which stores only the
+     * positions of the entries, rather than a copy of the subpath.
+     *
+     * Multiple entries may have the same subpath.
+     */
+    class entry_index {
+    public:
+        /**
+         * Iterator over the entries in the index, in the order in
+         * which they were added.
+         */
+        class iterator {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef dir_entry value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef dir_entry *pointer;
+            typedef dir_entry &reference;
+
+            iterator(std::vector<dir_entry *>::const_iterator it, std::vector<dir_entry *>::const_iterator end)
+                : it(it), end(end) {
+                skip_removed();
+            }
+
+            dir_entry &operator*() const {
+                return **it;
+            }
+
+            dir_entry *operator->() const {
+                return *it;
+            }
+
+            iterator &operator++() {
+                ++it;
+                skip_removed();
+
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator copy = *this;
+                ++(*this);
+
+                return copy;
+            }
+
+            bool operator==(const iterator &other) const {
+                return it == other.it;
+            }
+
+            bool operator!=(const iterator &other) const {
+                return it != other.it;
+            }
+
+        private:
+            std::vector<dir_entry *>::const_iterator it, end;
+
+            /**
+             * Advances the iterator past the positions of removed
+             * entries.
+             */
+            void skip_removed() {
+                while (it != end && !*it) ++it;
+            }
+        };
+
+
+        entry_index() = default;
+
+        entry_index(entry_index &&) = default;
+        entry_index &operator=(entry_index &&) = default;
+
+        /**
+         * Copies the entries of @a other into a new index. Removed
+         * entries are not copied.
+         */
+        entry_index(const entry_index &other);
+        entry_index &operator=(const entry_index &other);
+
+
+        /**
+         * Adds an entry to the index.
+         *
+         * @param ent The entry to add.
+         *
+         * @return Reference to the entry within the index.
+         */
+        dir_entry &add(dir_entry ent);
+
+        /**
+         * Removes all entries with a given subpath.
+         *
+         * The memory occupied by the entries is only released when
+         * the index is destroyed, however they are no longer
+         * returned by lookups or visited when iterating.
+         *
+         * @param subpath The canonicalized subpath.
+         *
+         * @return The number of entries removed.
+         */
+        size_t erase(const pathname::string &subpath);
+
+
+        /**
+         * Returns the first entry with a given subpath for which the
+         * predicate @a pred returns true.
+         *
+         * @param subpath The canonicalized subpath.
+         *
+         * @param pred Predicate function, called on each entry with
+         *   subpath @a subpath.
+         *
+         * @return Pointer to the entry, nullptr if there is no such
+         *   entry.
+         */
+        template <typename F>
+        dir_entry *find_if(const pathname::string &subpath, F pred) const;
+
+        /**
+         * Returns the first entry with a given subpath.
+         *
+         * @param subpath The canonicalized subpath.
+         *
+         * @return Pointer to the entry, nullptr if there is no entry
+         *   with subpath @a subpath.
+         */
+        dir_entry *find(const pathname::string &subpath) const {
+            return find_if(subpath, [] (const dir_entry &) { return true; });
+        }
+
+        /**
+         * Returns all entries with a given subpath.
+         *
+         * @param subpath The canonicalized subpath.
+         *
+         * @return Array of pointers to the entries.
+         */
+        std::vector<dir_entry *> find_all(const pathname::string &subpath) const;
+
+
+        /**
+         * Returns an estimate of the memory occupied by the index
+         * and its entries.
+         *
+         * @return The size in bytes.
+         */
+        size_t memory_size() const;
+
+        /**
+         * @return The number of entries in the index.
+         */
+        size_t size() const {
+            return count;
+        }
+
+        iterator begin() const {
+            return iterator(entries.begin(), entries.end());
+        }
+
+        iterator end() const {
+            return iterator(entries.end(), entries.end());
+        }
+
+    private:
+        /**
+         * Slot value indicating an empty slot.
+         */
+        static const uint32_t empty_slot = 0;
+        /**
+         * Slot value indicating a slot, from which an entry has
+         * been removed.
+         */
+        static const uint32_t removed_slot = UINT32_MAX;
+
+        /**
+         * Blocks in which the entries are stored. The capacity of a
+         * block is reserved when it is created and the block is
+         * never grown beyond it.
+         */
+        std::vector<std::vector<dir_entry>> blocks;
+
+        /**
+         * Pointers to the entries indexed by position. The pointers
+         * of removed entries are null.
+         */
+        std::vector<dir_entry *> entries;
+
+        /**
+         * Hash table slots. Each slot stores the position, plus one,
+         * of an entry or one of empty_slot or removed_slot. The
+         * number of slots is always a power of two.
+         */
+        std::vector<uint32_t> slots;
+
+        /**
+         * Number of entries in the index.
+         */
+        size_t count = 0;
+
+        /**
+         * Number of slots which are not empty, including the slots
+         * of removed entries.
+         */
+        size_t used = 0;
+
+
+        /**
+         * Returns the slot at which the probe sequence for a subpath
+         * begins.
+         *
+         * @param subpath The subpath.
+         *
+         * @return The slot index.
+         */
+        size_t first_slot(const pathname::string &subpath) const;
+
+        /**
+         * Adds the entry at position @a pos to the hash table. There
+         * must be at least one empty slot.
+         *
+         * @param pos The position of the entry.
+         */
+        void insert_slot(size_t pos);
+
+        /**
+         * Rebuilds the hash table, with enough slots to add at least
+         * one more entry while keeping the load factor below 3/4.
+         */
+        void rehash();
+
+        /**
+         * Stores an entry in the last block, allocating a new block
+         * if it is full.
+         *
+         * @param ent The entry.
+         *
+         * @return Reference to the stored entry.
+         */
+        dir_entry &store(dir_entry ent);
+    };
+
+
+    template <typename F>
+    dir_entry *entry_index::find_if(const pathname::string &subpath, F pred) const {
+        if (slots.empty()) return nullptr;
+
+        size_t mask = slots.size() - 1;
+
+        for (size_t i = first_slot(subpath); slots[i] != empty_slot; i = (i + 1) & mask) {
+            if (slots[i] != removed_slot) {
+                dir_entry *ent = entries[slots[i] - 1];
+
+                if (ent->subpath().path() == subpath && pred(*ent))
+                    return ent;
+            }
+        }
+
+        return nullptr;
+    }
+}
+
+#endif // NUC_DIRECTORY_ENTRY_INDEX_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -24,23 +24,65 @@
 
 using namespace nuc;
 
+/**
+ * Maximum number of file names, of regular files, of which the icons
+ * are cached.
+ */
+static constexpr size_t max_file_icons = 4096;
+
+
 icon_loader & icon_loader::instance() {
     static icon_loader loader;
     return loader;
 }
 
 Glib::RefPtr<Gdk::Pixbuf> icon_loader::load_icon(const nuc::dir_entry &ent) {
-    auto theme = Gtk::IconTheme::get_default();
     auto type = ent.type();
 
+    if (type != dir_entry::type_reg)
+        return load_icon(type, name_for_type(type));
+
+    auto it = file_icons.find(ent.file_name());
+
+    if (it != file_icons.end())
+        return it->second;
+
+    // The cache is simply emptied when full, as it only needs to hold
+    // the names of the visible rows to avoid guessing their content
+    // types on every redraw.
+
+    if (file_icons.size() >= max_file_icons)
+        file_icons.clear();
+
+    auto icon = load_icon(type, content_type(ent.file_name()));
+    file_icons.emplace(ent.file_name(), icon);
+
+    return icon;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> icon_loader::load_icon(dir_entry::entry_type type, const std::string &key) {
+    auto it = icons.find(key);
+
+    if (it != icons.end())
+        return it->second;
+
+    auto icon = lookup_icon(type, key);
+    icons.emplace(key, icon);
+
+    return icon;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> icon_loader::lookup_icon(dir_entry::entry_type type, const std::string &key) {
+    auto theme = Gtk::IconTheme::get_default();
+
     Glib::RefPtr<Gdk::Pixbuf> icon;
 
     if (type != dir_entry::type_reg) {
-        auto info = theme->lookup_icon(name_for_type(type), 16, Gtk::ICON_LOOKUP_FORCE_SIZE);
+        auto info = theme->lookup_icon(key, 16, Gtk::ICON_LOOKUP_FORCE_SIZE);
         if (info) icon = info.load_icon();
     }
     else {
-        auto info = theme->lookup_icon(icon_from_name(ent.file_name()), 16, Gtk::ICON_LOOKUP_FORCE_SIZE);
+        auto info = theme->lookup_icon(Gio::content_type_get_icon(key), 16, Gtk::ICON_LOOKUP_FORCE_SIZE);
         if (info) icon = info.load_icon();
     }
 
@@ -77,9 +119,9 @@ std::string icon_loader::name_for_type(dir_entry::entry_type type) {
     }
 }
 
-Glib::RefPtr<Gio::Icon> icon_loader::icon_from_name(const std::string &name) {
+std::string icon_loader::content_type(const std::string &name) {
     bool uncertain;
-    return Gio::content_type_get_icon(Gio::content_type_guess(name, NULL, 0, uncertain));
+    return Gio::content_type_guess(name, NULL, 0, uncertain);
 }
 
 
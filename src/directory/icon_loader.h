@@ -21,6 +21,7 @@
 #define NUC_DIRECTORY_ICON_LOADER_H
 
 #include <string>
+#include <unordered_map>
 
 #include <gdkmm/pixbuf.h>
 #include <giomm/contenttype.h>
@@ -42,6 +43,15 @@ namespace nuc {
         /**
          * Loads the icon for the entry @ent.
          *
+         * Icons are cached by icon name, for entries which are not
+         * regular files, and by content type, for regular files,
+         * thus the icon theme is only queried once for each
+         * distinct icon. The icons of regular files are
+         * additionally cached by file name, in a cache of bounded
+         * size, so that the content type of a visible file is not
+         * guessed every time it is redrawn. This function should
+         * only be called on the main thread.
+         *
          * @param ent The entry.
          *
          * @return The icon of the entry or a null RefPtr if no icon
@@ -50,6 +60,43 @@ namespace nuc {
         Glib::RefPtr<Gdk::Pixbuf> load_icon(const dir_entry &ent);
 
     private:
+        /**
+         * Loaded icons indexed by icon name or content type.
+         */
+        std::unordered_map<std::string, Glib::RefPtr<Gdk::Pixbuf>> icons;
+
+        /**
+         * Icons of regular files indexed by file name.
+         */
+        std::unordered_map<std::string, Glib::RefPtr<Gdk::Pixbuf>> file_icons;
+
+        /**
+         * Loads the icon with key @a key, from the icon cache, or
+         * looks it up in the icon theme if it is not in the cache.
+         *
+         * @param type The file type of the entry.
+         *
+         * @param key The icon name, if @a type is not a regular
+         *    file, or the content type of the file if @a type is a
+         *    regular file.
+         *
+         * @return The icon or a null RefPtr if no icon was found.
+         */
+        Glib::RefPtr<Gdk::Pixbuf> load_icon(dir_entry::entry_type type, const std::string &key);
+
+        /**
+         * Looks up an icon in the default icon theme.
+         *
+         * @param type The file type of the entry.
+         *
+         * @param key The icon name, if @a type is not a regular
+         *    file, or the content type of the file if @a type is a
+         *    regular file.
+         *
+         * @return The icon or a null RefPtr if no icon was found.
+         */
+        Glib::RefPtr<Gdk::Pixbuf> lookup_icon(dir_entry::entry_type type, const std::string &key);
+
         /**
          * Returns the icon name for a file type.
          *
@@ -60,15 +107,14 @@ namespace nuc {
         std::string name_for_type(dir_entry::entry_type type);
 
         /**
-         * Returns the icon for the file, with name @a name, based on
-         * its mime-type guessed from its name.
+         * Returns the content type of the file, with name @a name,
+         * guessed from its name.
          *
          * @param name The file name.
          *
-         * @return The Gio::Icon corresponding to the mime-type of the
-         *    file.
+         * @return The content type.
          */
-        Glib::RefPtr<Gio::Icon> icon_from_name(const std::string &name);
+        std::string content_type(const std::string &name);
     };
 }
 
@@ -19,11 +19,76 @@
 
 #include "vfs.h"
 
+#include <algorithm>
+#include <deque>
+
 #include "tasks/async_task.h"
+#include "tasks/worker_pool.h"
 #include "operations/copy.h"
 
+#include "dir_prefetcher.h"
+#include "archive_index.h"
+
 using namespace nuc;
 
+/**
+ * Maximum number of threads retrieving the stat attributes of the
+ * entries of a directory being read.
+ */
+static constexpr size_t stat_workers = 8;
+
+/**
+ * Number of entries, of which the stat attributes are retrieved by a
+ * single job on a stat worker thread.
+ */
+static constexpr size_t stat_batch_size = 64;
+
+/**
+ * Maximum number of stat batches processed by a single read
+ * attributes task, before the attributes are applied to the entries.
+ */
+static constexpr size_t attrs_task_batches = 64;
+
+
+/**
+ * Batch of entries of which the stat attributes are retrieved by a
+ * single stat worker job.
+ */
+struct stat_batch {
+    /** Entry names. */
+    std::vector<pathname::string> names;
+    /** Entry types. */
+    std::vector<uint8_t> types;
+
+    /** Stat attributes of the entries. */
+    std::vector<struct stat> attrs;
+    /** Flags for whether the stat attributes were retrieved. */
+    std::vector<bool> has_attrs;
+
+    /** True once the stat attributes have been retrieved. */
+    bool done = false;
+
+    /**
+     * Adds an entry to the batch.
+     *
+     * @param ent The entry.
+     */
+    void add(const lister::entry &ent) {
+        names.emplace_back(ent.name);
+        types.push_back(ent.type);
+    }
+};
+
+/**
+ * Retrieves the stat attributes of the entries in a batch. Called on
+ * a stat worker thread.
+ *
+ * @param state Cancellation state, checked before each entry.
+ * @param listr The lister which read the entries.
+ * @param batch The batch.
+ */
+static void stat_entries(cancel_state &state, lister &listr, stat_batch &batch);
+
 
 //// Background Task State
 
@@ -134,6 +199,18 @@ struct vfs::read_dir_task : public vfs::background_task, std::enable_shared_from
     /** dir_tree into which directory is read */
     std::shared_ptr<dir_tree> tree;
 
+    /** Stamp of the directory before it was read */
+    dir_cache::stamp stamp;
+
+    /** Flag: Was the tree retrieved from the directory cache */
+    bool cached = false;
+
+    /**
+     * Task which retrieves the stat attributes of the entries which
+     * were read without them, nullptr if there are no such entries.
+     */
+    std::shared_ptr<read_attrs_task> attrs;
+
     /**
      * Constructor.
      *
@@ -164,6 +241,51 @@ struct vfs::read_dir_task : public vfs::background_task, std::enable_shared_from
      */
     void list_dir(cancel_state &state);
 
+    /**
+     * Retrieves the directory's tree from the directory cache, if
+     * the directory has not changed since it was cached, and calls
+     * the delegate's new_entry method on each of its entries.
+     *
+     * @param state The cancellation state.
+     *
+     * @return True if the tree was retrieved from the cache, false
+     *   if the directory should be read.
+     */
+    bool read_cached(cancel_state &state);
+
+    /**
+     * Reads the entries of the directory, with lister @a listr,
+     * retrieving their stat attributes on multiple threads. This
+     * hides the latency of stat calls on network file systems, thus
+     * is only used if the lister's slow_stat method returns true.
+     *
+     * The entries are added to the tree, in the order in which they
+     * were read, on the calling thread.
+     *
+     * @param state The cancellation state.
+     * @param listr The lister, which must support concurrent_stat.
+     */
+    void list_concurrent(cancel_state &state, lister &listr);
+
+    /**
+     * Reads the entries of the directory, with lister @a listr,
+     * without retrieving their stat attributes. Only the stat
+     * attributes of symbolic links, and entries of unknown type, are
+     * retrieved, as these are required to determine whether the
+     * entry is a directory.
+     *
+     * The attributes of the remaining entries are retrieved by a
+     * read_attrs_task, which is stored in 'attrs', on multiple
+     * threads if the lister's slow_stat method returns true.
+     *
+     * @param state The cancellation state.
+     *
+     * @param listr The lister, which must support
+     *   concurrent_stat. Ownership is passed to the read attributes
+     *   task.
+     */
+    void list_names(cancel_state &state, std::unique_ptr<lister> listr);
+
     /**
      * Read task finish callback function.
      *
@@ -182,10 +304,81 @@ struct vfs::read_dir_task : public vfs::background_task, std::enable_shared_from
      * @param st State attributes of the entry to add.
      */
     void add_entry(cancel_state &state, const lister::entry &ent, const struct stat &st);
+
+    /**
+     * Adds an entry, without stat attributes, to the directory tree.
+     *
+     * @param state Cancellation state.
+     * @param ent The entry to add.
+     */
+    void add_entry(cancel_state &state, const lister::entry &ent);
+
+private:
+    /**
+     * Adds the entries, of the batches at the front of the queue @a
+     * batches, to the tree, stopping at the first batch of which the
+     * stat attributes have not been retrieved yet.
+     *
+     * @param state Cancellation state.
+     * @param batches The batch queue.
+     */
+    void add_batches(cancel_state &state, std::deque<std::shared_ptr<stat_batch>> &batches);
 };
 
 
 
+//// Read Attributes Task
+
+/**
+ * Read Attributes Task State.
+ *
+ * Retrieves the stat attributes of the entries of the current
+ * directory, which were read without them, after the directory has
+ * been read. Each invocation of the task retrieves the attributes of
+ * up to attrs_task_batches batches, applies them to the entries on
+ * the main thread and queues the task again if there are entries
+ * remaining.
+ */
+struct vfs::read_attrs_task : public vfs::background_task, std::enable_shared_from_this<vfs::read_attrs_task> {
+    /** The lister which read the directory. */
+    std::unique_ptr<lister> listr;
+
+    /**
+     * Batches of the entries of which the stat attributes have not
+     * been retrieved.
+     */
+    std::deque<std::shared_ptr<stat_batch>> batches;
+
+    /**
+     * Constructor.
+     *
+     * @param tasks Background Task State.
+     */
+    read_attrs_task(std::weak_ptr<vfs::background_task_state> tasks)
+        : background_task(tasks) {}
+
+    /**
+     * Retrieves the stat attributes of the entries in the batches at
+     * the front of the queue, and queues the function which applies
+     * them on the main thread.
+     *
+     * @param state The cancellation state.
+     */
+    void read_attrs(cancel_state &state);
+
+    /**
+     * Applies the stat attributes, of the first @a n batches, to the
+     * entries of the current directory tree, and emits the
+     * attributes signal. Called on the main thread.
+     *
+     * @param self Pointer to the VFS object.
+     * @param n Number of batches.
+     */
+    void apply_attrs(vfs *self, size_t n);
+};
+
+
+
 //// Read Subdirectory Task
 
 /**
@@ -255,6 +448,11 @@ struct vfs::update_task : public vfs::background_task {
     /** Directory Tree which is updated */
     std::shared_ptr<dir_tree> tree;
 
+    /** Path to the directory file */
+    pathname path;
+    /** Stamp of the directory after the updates */
+    dir_cache::stamp stamp;
+
     /**
      * Constructor.
      *
@@ -279,6 +477,19 @@ struct vfs::update_task : public vfs::background_task {
  */
 static void call_begin(cancel_state &state, std::shared_ptr<vfs::delegate> delegate);
 
+/**
+ * Stores the tree of a directory, which is no longer displayed, in
+ * the directory cache.
+ *
+ * The context data of the tree's entries is cleared, as it refers
+ * to the delegate's state, which is no longer valid.
+ *
+ * @param type The dir_type of the directory.
+ * @param tree The directory's tree.
+ * @param st Stamp of the directory when the tree was read.
+ */
+static void cache_tree(const dir_type &type, std::shared_ptr<dir_tree> tree, const dir_cache::stamp &st);
+
 
 
 //// Initialization
@@ -302,6 +513,10 @@ vfs::deleted_signal vfs::signal_deleted() {
     return sig_deleted;
 }
 
+vfs::attrs_signal vfs::signal_attrs() {
+    return sig_attrs;
+}
+
 
 //// Queuing Background Tasks
 
@@ -346,6 +561,9 @@ void vfs::read(const pathname& path, std::shared_ptr<delegate> del) {
 }
 
 void vfs::add_read_task(const pathname &path, bool refresh, std::shared_ptr<delegate> del) {
+    // Prefetching yields to foreground reads
+    dir_prefetcher::instance().cancel();
+
     auto task = std::make_shared<read_dir_task>(refresh, tasks, del);
 
     tasks->queue->add([=] (cancel_state &state) {
@@ -356,6 +574,8 @@ void vfs::add_read_task(const pathname &path, bool refresh, std::shared_ptr<dele
 }
 
 void vfs::add_read_task(std::shared_ptr<dir_type> type, bool refresh,  std::shared_ptr<delegate> del) {
+    dir_prefetcher::instance().cancel();
+
     auto task = std::make_shared<read_dir_task>(refresh, tasks, del);
     task->type = type;
 
@@ -389,25 +609,180 @@ void vfs::read_dir_task::list_dir(nuc::cancel_state &state) {
 
     tree.reset(type->create_tree());
 
+    // The stamp is retrieved before reading, so that changes made
+    // while the directory is being read result in a stale stamp
+    // rather than a stale tree.
+    stamp.get(type->path());
+
+    if (!refresh && read_cached(state))
+        return;
+
     call_begin(state, m_delegate);
 
+    // The entries of archives are read from the archive's saved
+    // index, if it is up to date, otherwise the index is rebuilt.
+    std::unique_ptr<archive_index> index;
+
+    if (!type->is_dir()) {
+        index.reset(new archive_index(dir_cache::key(*type), type->path()));
+
+        if (index->load()) {
+            for (auto &ent : index->entries())
+                add_entry(state, ent.lister_entry(), ent.attributes());
+
+            return;
+        }
+    }
+
     try {
         std::unique_ptr<lister> listr(type->create_lister());
 
+        if (listr->concurrent_stat()) {
+            // When refreshing, the old entries are displayed until
+            // the read completes, thus the attributes are retrieved
+            // upfront, on multiple threads only if stat is slow.
+
+            if (!refresh) {
+                list_names(state, std::move(listr));
+                return;
+            }
+
+            if (listr->slow_stat()) {
+                list_concurrent(state, *listr);
+                return;
+            }
+        }
+
         lister::entry ent;
         struct stat st;
 
         while (listr->read_entry(ent)) {
             if (listr->entry_stat(st)) {
                 add_entry(state, ent, st);
+                if (index) index->add(ent, st);
             }
         }
+
+        if (index) index->save();
     }
     catch (const nuc::error &e) {
         error = e.code();
     }
 }
 
+bool vfs::read_dir_task::read_cached(cancel_state &state) {
+    auto cached_tree = dir_cache::instance().take(dir_cache::key(*type), stamp);
+
+    if (!cached_tree)
+        return false;
+
+    cached_tree->subpath(tree->subpath());
+    tree = cached_tree;
+    cached = true;
+
+    call_begin(state, m_delegate);
+
+    state.no_cancel([this] {
+        if (type->is_dir()) {
+            for (dir_entry &ent : tree->index())
+                m_delegate->new_entry(ent);
+        }
+        else if (auto dir = tree->subpath_dir(tree->subpath())) {
+            for (auto &ent : *dir)
+                m_delegate->new_entry(*ent.second);
+        }
+        else {
+            error = ENOENT;
+        }
+    });
+
+    return true;
+}
+
+void vfs::read_dir_task::list_concurrent(cancel_state &state, lister &listr) {
+    std::deque<std::shared_ptr<stat_batch>> batches;
+    std::shared_ptr<stat_batch> batch;
+
+    worker_pool pool(stat_workers);
+
+    lister::entry ent;
+    bool more;
+
+    do {
+        if ((more = listr.read_entry(ent))) {
+            if (!batch) batch = std::make_shared<stat_batch>();
+            batch->add(ent);
+        }
+
+        if (batch && (!more || batch->names.size() == stat_batch_size)) {
+            batches.push_back(batch);
+
+            pool.add([&state, &listr, batch] {
+                stat_entries(state, listr, *batch);
+            }, [this, &state, &batches, batch] {
+                batch->done = true;
+                add_batches(state, batches);
+            });
+
+            batch.reset();
+        }
+    } while (more);
+
+    pool.wait();
+}
+
+void vfs::read_dir_task::add_batches(cancel_state &state, std::deque<std::shared_ptr<stat_batch>> &batches) {
+    while (!batches.empty() && batches.front()->done) {
+        stat_batch &batch = *batches.front();
+
+        for (size_t i = 0; i < batch.names.size(); i++) {
+            if (batch.has_attrs[i]) {
+                lister::entry ent{batch.names[i].c_str(), batch.types[i]};
+                add_entry(state, ent, batch.attrs[i]);
+            }
+        }
+
+        batches.pop_front();
+    }
+}
+
+void vfs::read_dir_task::list_names(cancel_state &state, std::unique_ptr<lister> listr) {
+    auto task = std::make_shared<read_attrs_task>(vfs_tasks);
+    std::shared_ptr<stat_batch> batch;
+
+    lister::entry ent;
+    struct stat st;
+
+    while (listr->read_entry(ent)) {
+        switch (ent.type) {
+        case DT_UNKNOWN:
+        case DT_LNK:
+            if (listr->entry_stat(st)) {
+                add_entry(state, ent, st);
+            }
+            break;
+
+        default:
+            add_entry(state, ent);
+
+            if (!batch) batch = std::make_shared<stat_batch>();
+            batch->add(ent);
+
+            if (batch->names.size() == stat_batch_size) {
+                task->batches.push_back(batch);
+                batch.reset();
+            }
+        }
+    }
+
+    if (batch) task->batches.push_back(batch);
+
+    if (!task->batches.empty()) {
+        task->listr = std::move(listr);
+        attrs = task;
+    }
+}
+
 void vfs::read_dir_task::add_entry(nuc::cancel_state &state, const lister::entry &ent, const struct stat &st) {
     state.no_cancel([this, &ent, &st] {
         if (dir_entry *new_ent = tree->add_entry(ent, st)) {
@@ -416,22 +791,67 @@ void vfs::read_dir_task::add_entry(nuc::cancel_state &state, const lister::entry
     });
 }
 
+void vfs::read_dir_task::add_entry(nuc::cancel_state &state, const lister::entry &ent) {
+    state.no_cancel([this, &ent] {
+        if (dir_entry *new_ent = tree->add_entry(dir_entry(ent))) {
+            m_delegate->new_entry(*new_ent);
+        }
+    });
+}
+
+void stat_entries(cancel_state &state, lister &listr, stat_batch &batch) {
+    size_t n = batch.names.size();
+
+    batch.attrs.resize(n);
+    batch.has_attrs.resize(n);
+
+    for (size_t i = 0; i < n; i++) {
+        state.test_cancel();
+
+        lister::entry ent{batch.names[i].c_str(), batch.types[i]};
+        batch.has_attrs[i] = listr.stat_entry(ent, batch.attrs[i]);
+    }
+}
+
 void vfs::read_dir_task::finish_read(bool cancelled) {
     auto state = shared_from_this();
 
     queue_main_wait([state, cancelled] (vfs *self) {
+        bool success = !cancelled && !state->error;
+        std::shared_ptr<dir_type> old_type = self->dtype;
+
         // Swap new tree and old tree and set new directory type
-        if (!cancelled && !state->error) {
+        if (success) {
             self->cur_tree.swap(state->tree);
             self->dtype = state->type;
+
+            std::swap(self->cur_stamp, state->stamp);
         }
 
         // Call finish callback
         state->m_delegate->finish(cancelled, state->error);
 
+        // Cache the tree of the directory which was left. A refreshed
+        // tree is simply discarded.
+        if (success && !state->refresh && old_type && state->tree)
+            cache_tree(*old_type, std::move(state->tree), state->stamp);
+
         // Start new monitor or reset old monitor
         self->start_new_monitor(cancelled, state->error, state->refresh);
 
+        // Retrieve the remaining attributes of the new entries, or
+        // resume retrieving the attributes of the old entries.
+        if (!cancelled && !state->error) {
+            self->attrs_task = state->attrs;
+            if (self->attrs_task) self->add_read_attrs_task();
+        }
+        else if (!self->attrs_task && self->interrupted_attrs) {
+            self->attrs_task = self->interrupted_attrs;
+            self->add_read_attrs_task();
+        }
+
+        self->interrupted_attrs = nullptr;
+
         // Clear new_tree, new_type and flags
         self->clear_flags();
 
@@ -442,9 +862,91 @@ void vfs::read_dir_task::finish_read(bool cancelled) {
             // Check that the current tree's subpath still exists.
             self->refresh_subdir();
         }
+        else if (success && state->cached && self->dtype->is_dir()) {
+            // Changes to the files, within the directory, do not
+            // change the directory's stamp, thus the directory is
+            // reread in the background.
+            self->add_refresh_task();
+        }
+    });
+}
+
+
+void vfs::add_read_attrs_task() {
+    auto task = attrs_task;
+
+    tasks->queue->add([=] (cancel_state &state) {
+        task->read_attrs(state);
+    });
+}
+
+
+//// Read Attributes Task
+
+void vfs::read_attrs_task::read_attrs(cancel_state &state) {
+    size_t n = std::min(batches.size(), attrs_task_batches);
+
+    // Local file systems gain nothing from multiple stat threads.
+
+    if (!listr->slow_stat()) {
+        for (size_t i = 0; i < n; i++)
+            stat_entries(state, *listr, *batches[i]);
+    }
+    else {
+        worker_pool pool(stat_workers);
+
+        for (size_t i = 0; i < n; i++) {
+            auto batch = batches[i];
+
+            pool.add([this, &state, batch] {
+                stat_entries(state, *listr, *batch);
+            }, [] {});
+        }
+
+        pool.wait();
+    }
+
+    auto task = shared_from_this();
+
+    queue_main_wait([task, n] (vfs *self) {
+        task->apply_attrs(self, n);
+        self->tasks->queue->resume();
     });
 }
 
+void vfs::read_attrs_task::apply_attrs(vfs *self, size_t n) {
+    // The directory was changed, or reread, in the meantime.
+    if (self->attrs_task.get() != this)
+        return;
+
+    std::vector<dir_entry *> entries;
+
+    for (size_t i = 0; i < n; i++) {
+        stat_batch &batch = *batches.front();
+
+        for (size_t j = 0; j < batch.names.size(); j++) {
+            if (!batch.has_attrs[j]) continue;
+
+            // Entries are looked up by name, as the tree may have
+            // been replaced by an updated copy.
+
+            if (dir_entry *ent = self->cur_tree->get_entry(batch.names[j])) {
+                ent->attr(batch.attrs[j]);
+                entries.push_back(ent);
+            }
+        }
+
+        batches.pop_front();
+    }
+
+    self->sig_attrs.emit(entries);
+
+    if (batches.empty())
+        self->attrs_task = nullptr;
+    else
+        self->add_read_attrs_task();
+}
+
 
 void call_begin(cancel_state &state, std::shared_ptr<vfs::delegate> delegate) {
     state.no_cancel([=] {
@@ -452,6 +954,13 @@ void call_begin(cancel_state &state, std::shared_ptr<vfs::delegate> delegate) {
     });
 }
 
+void cache_tree(const dir_type &type, std::shared_ptr<dir_tree> tree, const dir_cache::stamp &st) {
+    for (dir_entry &ent : tree->index())
+        ent.context = dir_entry_context();
+
+    dir_cache::instance().store(dir_cache::key(type), std::move(tree), st);
+}
+
 
 //// Changing directory tree subdirectories
 
@@ -480,6 +989,22 @@ bool vfs::ascend(std::shared_ptr<delegate> del) {
     return false;
 }
 
+void vfs::prefetch(const dir_entry &ent) {
+    if (!dtype || !dtype->is_dir())
+        return;
+
+    pathname dir = dtype->path();
+    std::vector<pathname> paths;
+
+    if (ent.ent_type() != dir_entry::type_parent && ent.type() == dir_entry::type_dir)
+        paths.push_back(dir.append(ent.file_name()));
+
+    if (!dir.is_root())
+        paths.push_back(dir.remove_last_component());
+
+    dir_prefetcher::instance().prefetch(paths);
+}
+
 void vfs::add_read_subdir(const pathname &subpath, std::shared_ptr<delegate> del) {
     monitor.pause();
 
@@ -551,9 +1076,12 @@ void vfs::cancel_update() {
     // Prevent further update tasks from being queued
     monitor.pause();
 
-    // Cancel any ongoing update tasks
-    if (tasks->updating)
+    // Cancel any ongoing update, or read attributes, tasks
+    if (tasks->updating || attrs_task)
         tasks->queue->cancel();
+
+    if (attrs_task)
+        interrupted_attrs = std::move(attrs_task);
 }
 
 bool vfs::cancel() {
@@ -626,11 +1154,13 @@ static void begin_changes(cancel_state &state, std::shared_ptr<dir_tree> new_tre
 }
 
 void vfs::end_changes(cancel_state &state, std::shared_ptr<update_task> tstate) {
+    tstate->stamp.get(tstate->path);
+
     state.no_cancel([&] {
         tstate->m_delegate->begin();
 
         for (auto &ent : tstate->tree->index()) {
-            tstate->m_delegate->new_entry(ent.second);
+            tstate->m_delegate->new_entry(ent);
         }
 
         finish_updates(tstate);
@@ -640,6 +1170,7 @@ void vfs::end_changes(cancel_state &state, std::shared_ptr<update_task> tstate)
 void vfs::finish_updates(std::shared_ptr<update_task> state) {
     state->queue_main_wait([=] (vfs *self) {
         self->cur_tree.swap(state->tree);
+        self->cur_stamp = state->stamp;
 
         state->m_delegate->finish(false, 0);
 
@@ -738,12 +1269,17 @@ static void file_renamed(cancel_state &state, std::shared_ptr<dir_tree> tree, co
         if (ent) {
             exists = true;
 
-            ent->orig_subpath(dest_name);
+            // The entry is copied as the index locates entries by
+            // their subpaths, thus the subpath of an entry in the
+            // index cannot be changed.
 
-            remove_entry(dest_name, tree);
-            tree->add_entry(std::move(*ent));
+            dir_entry new_ent = *ent;
+            new_ent.orig_subpath(dest_name);
 
             remove_entry(src_name, tree);
+            remove_entry(dest_name, tree);
+
+            tree->add_entry(std::move(new_ent));
         }
     });
 
@@ -765,8 +1301,12 @@ void vfs::file_event(dir_monitor::event e) {
             break;
 
         case dir_monitor::EVENTS_END:
-            if (auto del = cb_changed())
-                tasks->queue->add(std::bind(&vfs::end_changes, _1, std::make_shared<update_task>(tasks, del, new_tree)));
+            if (auto del = cb_changed()) {
+                auto task = std::make_shared<update_task>(tasks, del, new_tree);
+                task->path = dtype->path();
+
+                tasks->queue->add(std::bind(&vfs::end_changes, _1, task));
+            }
             break;
 
         // File events
@@ -23,6 +23,7 @@
 #include <functional>
 #include <atomic>
 #include <memory>
+#include <vector>
 
 #include "paths/pathname.h"
 
@@ -30,6 +31,7 @@
 
 #include "dir_type.h"
 #include "dir_monitor.h"
+#include "dir_cache.h"
 
 namespace nuc {
     /**
@@ -93,6 +95,14 @@ namespace nuc {
          */
         typedef sigc::signal<void, pathname> deleted_signal;
 
+        /**
+         * Attributes signal type.
+         *
+         * The signal is passed the entries of which the stat
+         * attributes have been retrieved.
+         */
+        typedef sigc::signal<void, const std::vector<dir_entry *> &> attrs_signal;
+
 
         /** Constructor */
         vfs();
@@ -128,6 +138,17 @@ namespace nuc {
          */
         deleted_signal signal_deleted();
 
+        /**
+         * Returns the attributes signal.
+         *
+         * On-disk directories are read in two phases. First the
+         * entries are read, without their stat attributes, and the
+         * read operation completes. Then the attributes are
+         * retrieved in the background, and this signal is emitted,
+         * on the main thread, as they are applied to the entries.
+         */
+        attrs_signal signal_attrs();
+
         /**
          * Returns the logical path of the current directory in the
          * vfs.
@@ -187,6 +208,21 @@ namespace nuc {
          */
         bool ascend(std::shared_ptr<delegate> del);
 
+        /**
+         * Prefetches the directories which are likely to be visited
+         * next, from the current directory, into the directory
+         * cache. These are the directory of the entry @a ent, if it
+         * is a directory, and the parent directory.
+         *
+         * Does nothing if the current directory is not an on-disk
+         * directory.
+         *
+         * Should only be called on the main thread.
+         *
+         * @param ent The selected entry.
+         */
+        void prefetch(const dir_entry &ent);
+
         /**
          * Cancels the current background operation if any. The
          * operation is considered cancelled when the finish method,
@@ -228,11 +264,9 @@ namespace nuc {
          *
          * @param name The name of the entry/entries to return.
          *
-         * @return A pair of iterators, the first iterator points to
-         *    the first entry, the second iterator is the past the
-         *    end iterator.
+         * @return Array of pointers to the entries.
          */
-        dir_tree::entry_range get_entries(const pathname::string &path) {
+        dir_tree::entry_list get_entries(const pathname::string &path) {
             return cur_tree->get_entries(path);
         }
 
@@ -266,6 +300,11 @@ namespace nuc {
          */
         deleted_signal sig_deleted;
 
+        /**
+         * Attributes signal.
+         */
+        attrs_signal sig_attrs;
+
 
         /* Directory Type */
 
@@ -289,6 +328,16 @@ namespace nuc {
          */
         std::shared_ptr<dir_tree> cur_tree = nullptr;
 
+        /**
+         * Modification stamp of the directory, or archive file, at
+         * the time cur_tree was read. The tree is stored in the
+         * directory cache, with this stamp, when another directory is
+         * read.
+         *
+         * Should only be accessed from the main thread.
+         */
+        dir_cache::stamp cur_stamp;
+
         /**
          * A directory tree which contains a copy of cur_tree and is
          * modified in response to file system updates.
@@ -349,6 +398,31 @@ namespace nuc {
         void add_refresh_task();
 
 
+        /* Reading Attributes */
+
+        struct read_attrs_task;
+
+        /**
+         * Task retrieving the stat attributes of the entries, of the
+         * current directory tree, which were read without them.
+         *
+         * Should only be accessed from the main thread.
+         */
+        std::shared_ptr<read_attrs_task> attrs_task;
+
+        /**
+         * Read attributes task which was interrupted by a read
+         * operation. It is resumed if the read operation fails or is
+         * cancelled.
+         */
+        std::shared_ptr<read_attrs_task> interrupted_attrs;
+
+        /**
+         * Adds the task 'attrs_task' to the background task queue.
+         */
+        void add_read_attrs_task();
+
+
         /**
          * Cancels all tasks on the task queue and cancels the
          * directory monitor to prevent more update tasks from being
@@ -0,0 +1,98 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "error_forwarder.h"
+
+using namespace nuc;
+
+
+error_handler_fn error_forwarder::handler() {
+    return [this] (const error &e) {
+        // The handler is called from within the catch block of
+        // try_op, thus the current exception is the error, with its
+        // dynamic type.
+
+        std::exception_ptr err = std::current_exception();
+        if (!err) err = std::make_exception_ptr(e);
+
+        request req(err, restarts());
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        if (aborting)
+            throw aborted();
+
+        requests.push_back(&req);
+        cond.notify_all();
+
+        cond.wait(lock, [&req] { return req.handled; });
+
+        if (req.response)
+            std::rethrow_exception(req.response);
+    };
+}
+
+void error_forwarder::handle(std::unique_lock<std::mutex> &lock) {
+    request *req = requests.front();
+    requests.pop_front();
+
+    lock.unlock();
+
+    // Establish the worker's restarts for the duration of the
+    // handler. The error is rethrown so that the handler is called
+    // from within a catch block, as the "abort" restart rethrows the
+    // current exception.
+
+    std::swap(restarts(), req->restarts);
+
+    std::exception_ptr response;
+
+    try {
+        try {
+            std::rethrow_exception(req->error);
+        }
+        catch (const error &e) {
+            global_error_handler(e);
+        }
+    }
+    catch (...) {
+        response = std::current_exception();
+    }
+
+    std::swap(restarts(), req->restarts);
+
+    lock.lock();
+
+    req->response = response;
+    req->handled = true;
+
+    cond.notify_all();
+}
+
+void error_forwarder::abort() {
+    aborting = true;
+
+    for (request *req : requests) {
+        req->response = std::make_exception_ptr(aborted());
+        req->handled = true;
+    }
+
+    requests.clear();
+    cond.notify_all();
+}
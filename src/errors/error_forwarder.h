@@ -0,0 +1,183 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_ERRORS_ERROR_FORWARDER_H
+#define NUC_ERRORS_ERROR_FORWARDER_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "error.h"
+
+namespace nuc {
+    /**
+     * Forwards errors, raised on worker threads, to an owner thread.
+     *
+     * The error handler and restarts are thread-local, thus errors
+     * raised on a thread other than the one running the task, would
+     * otherwise not be presented to the user. The forwarded errors
+     * are handled by the owner thread's error handler, with the
+     * restarts established on the worker thread at the point the
+     * error was raised.
+     *
+     * If the error handler throws an exception, for example a
+     * skip_exception when the "skip" restart is chosen, the
+     * exception is rethrown on the worker thread, from the worker's
+     * error handler.
+     *
+     * The forwarder shares a mutex and condition variable with its
+     * owner, so that the owner can wait for forwarded errors and
+     * other events, such as the completion of work, at the same time.
+     */
+    class error_forwarder {
+    public:
+        /**
+         * Thrown on a worker thread, by its error handler, when the
+         * owner stops handling errors.
+         */
+        class aborted : public std::exception {};
+
+        /**
+         * Constructor.
+         *
+         * @param mutex Mutex protecting the forwarder's state.
+         *
+         * @param cond Condition variable which is signalled when an
+         *   error is forwarded or handled.
+         */
+        error_forwarder(std::mutex &mutex, std::condition_variable &cond)
+            : mutex(mutex), cond(cond) {}
+
+        /**
+         * Returns an error handler function which forwards errors to
+         * the owner and waits for them to be handled. The handler
+         * should be established, on the worker thread, with an
+         * error_handler object.
+         *
+         * The handler must be called with the mutex unlocked.
+         *
+         * @return The error handler function.
+         */
+        error_handler_fn handler();
+
+        /**
+         * Returns true if there are forwarded errors, which have not
+         * been handled yet. Should be called with the mutex locked.
+         *
+         * @return True if there are pending errors.
+         */
+        bool pending() const {
+            return !requests.empty();
+        }
+
+        /**
+         * Handles the first pending error, on the calling (owner)
+         * thread, using the global error handler. The mutex is
+         * unlocked while the error handler runs.
+         *
+         * @param lock Lock on the mutex.
+         */
+        void handle(std::unique_lock<std::mutex> &lock);
+
+        /**
+         * Aborts all pending and future errors, causing an aborted
+         * exception to be thrown on the worker threads. Should be
+         * called with the mutex locked.
+         */
+        void abort();
+
+    private:
+        /**
+         * Forwarded error.
+         */
+        struct request {
+            /** The error exception. */
+            std::exception_ptr error;
+
+            /** Restarts established on the worker thread. */
+            restart_map restarts;
+
+            /** Exception thrown by the error handler, if any. */
+            std::exception_ptr response;
+
+            /** Flag: true once the error has been handled. */
+            bool handled = false;
+
+            request(std::exception_ptr error, const restart_map &restarts)
+                : error(error), restarts(restarts) {}
+        };
+
+        std::mutex &mutex;
+        std::condition_variable &cond;
+
+        /**
+         * Queue of pending errors.
+         */
+        std::deque<request *> requests;
+
+        /**
+         * Flag: true if errors should no longer be forwarded.
+         */
+        bool aborting = false;
+    };
+
+    /**
+     * Establishes a copy of the restarts of another thread, as the
+     * restarts of the calling thread, for the lifetime of the
+     * object. The previous restarts are restored by the destructor.
+     *
+     * The restarts may refer to objects on the stack of the other
+     * thread, thus the other thread should wait for the calling
+     * thread, while the object is alive.
+     */
+    class inherited_restarts {
+        /**
+         * The restarts which are not currently established.
+         */
+        restart_map saved;
+
+    public:
+        inherited_restarts(const inherited_restarts &) = delete;
+        inherited_restarts &operator=(const inherited_restarts &) = delete;
+
+        /**
+         * Constructor.
+         *
+         * @param map The restarts to establish.
+         */
+        inherited_restarts(restart_map map) : saved(std::move(map)) {
+            std::swap(restarts(), saved);
+        }
+
+        /**
+         * Restores the previous restarts.
+         */
+        ~inherited_restarts() {
+            std::swap(restarts(), saved);
+        }
+    };
+}
+
+#endif // NUC_ERRORS_ERROR_FORWARDER_H
+
+// Local Variables:
+// mode: c++
+// End:
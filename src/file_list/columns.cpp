@@ -22,6 +22,8 @@
 #include "sort_func.h"
 #include "file_model_columns.h"
 
+#include "directory/icon_loader.h"
+
 #include <glib/gi18n.h>
 
 using namespace nuc;
@@ -29,6 +31,16 @@ using namespace nuc;
 
 //// Utility Function Prototypes
 
+/**
+ * Function which formats the text displayed in a column's cell,
+ * for a given entry.
+ *
+ * @param ent The entry.
+ *
+ * @return The text to display.
+ */
+typedef Glib::ustring (*format_fn)(const dir_entry &ent);
+
 /**
  * Creates a new tree view column.
  *
@@ -40,27 +52,37 @@ static Gtk::TreeView::Column *create_column(const Glib::ustring &title);
 
 /**
  * Adds a text cell to a tree view column, binds its
- * foreground_rgba attribute to the color model column, and
- * binds its text property to the tree model column @a data.
+ * foreground_rgba attribute to the color model column, and sets
+ * its text, when it is rendered, to the string returned by @a
+ * format called on the row's entry.
  *
  * @param col The Column.
  *
- * @param data The model column to bind to the text property
- *   of the cell.
+ * @param format Function which formats the text of the cell.
  *
  * @return The text cell.
  */
-static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col, Gtk::TreeModelColumn<Glib::ustring> data);
+static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col, format_fn format);
 
 /**
- * Adds a text cell to a tree view column, and binds its
- * foreground_rgba attribute to the color model column.
+ * Cell data function of text cells. Sets the text property of @a
+ * cell to the string returned by @a format called on the entry of
+ * the row at @a iter.
  *
- * @param col The Column.
+ * @param cell The cell renderer.
+ * @param iter Iterator to the row being rendered.
+ * @param format Function which formats the text of the cell.
+ */
+static void set_cell_text(Gtk::CellRenderer *cell, const Gtk::TreeModel::iterator &iter, format_fn format);
+
+/**
+ * Cell data function of the icon cell. Sets the pixbuf property
+ * of @a cell to the icon of the entry of the row at @a iter.
  *
- * @return The text cell.
+ * @param cell The cell renderer.
+ * @param iter Iterator to the row being rendered.
  */
-static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col);
+static void set_cell_icon(Gtk::CellRenderer *cell, const Gtk::TreeModel::iterator &iter);
 
 
 //// Column Descriptors for built-in columns
@@ -71,17 +93,10 @@ static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col);
 struct full_name_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return column.index();
-    }
 
-private:
-    Gtk::TreeModelColumn<Glib::ustring> column;
+    static Glib::ustring format(const dir_entry &ent);
 };
 
 /**
@@ -90,17 +105,10 @@ private:
 struct name_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return column.index();
-    }
 
-private:
-    Gtk::TreeModelColumn<Glib::ustring> column;
+    static Glib::ustring format(const dir_entry &ent);
 };
 
 /**
@@ -109,14 +117,8 @@ private:
 struct icon_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return file_model_columns::instance().icon.index();
-    }
 };
 
 /**
@@ -125,17 +127,10 @@ struct icon_column : public column_descriptor {
 struct size_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return column.index();
-    }
 
-private:
-    Gtk::TreeModelColumn<Glib::ustring> column;
+    static Glib::ustring format(const dir_entry &ent);
 };
 
 /**
@@ -144,17 +139,10 @@ private:
 struct date_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return column.index();
-    }
 
-private:
-    Gtk::TreeModelColumn<Glib::ustring> column;
+    static Glib::ustring format(const dir_entry &ent);
 };
 
 /**
@@ -163,19 +151,13 @@ private:
 struct extension_column : public column_descriptor {
     using column_descriptor::column_descriptor;
 
-    virtual void add_column(file_model_columns &columns);
     virtual Gtk::TreeView::Column * create();
     virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order);
-    virtual void set_data(Gtk::TreeRow row, const dir_entry &ent);
-
-    virtual int model_index() const {
-        return column.index();
-    }
 
-private:
-    Gtk::TreeModelColumn<Glib::ustring> column;
+    static Glib::ustring format(const dir_entry &ent);
 };
 
+
 
 //// Column Descriptor Map
 
@@ -250,6 +232,13 @@ column_descriptor * nuc::get_column(int id) {
     return column_descriptors()[id].get();
 }
 
+
+//// Column Descriptor Base Implementation
+
+void column_descriptor::add_column(file_model_columns &columns) {
+    columns.add(column);
+}
+
 
 /// Column and Cell Creation Functions
 
@@ -260,33 +249,38 @@ static Gtk::TreeView::Column *create_column(const Glib::ustring &title) {
     return col;
 }
 
-static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col, Gtk::TreeModelColumn<Glib::ustring> data) {
-    auto cell = add_text_cell(col);
+static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col, format_fn format) {
+    auto cell = Gtk::manage(new Gtk::CellRendererText());
 
-    col->add_attribute(cell->property_text(), data);
+    col->pack_start(*cell);
+    col->add_attribute(cell->property_foreground_rgba(), file_model_columns::instance().color);
+    col->set_cell_data_func(*cell, sigc::bind(&set_cell_text, format));
 
     return cell;
 }
 
-static Gtk::CellRendererText *add_text_cell(Gtk::TreeView::Column *col) {
-    auto cell = Gtk::manage(new Gtk::CellRendererText());
+static void set_cell_text(Gtk::CellRenderer *cell, const Gtk::TreeModel::iterator &iter, format_fn format) {
+    dir_entry *ent = (*iter)[file_model_columns::instance().ent];
 
-    col->pack_start(*cell);
-    col->add_attribute(cell->property_foreground_rgba(), file_model_columns::instance().color);
+    static_cast<Gtk::CellRendererText*>(cell)->property_text() = ent ? format(*ent) : "";
+}
 
-    return cell;
+static void set_cell_icon(Gtk::CellRenderer *cell, const Gtk::TreeModel::iterator &iter) {
+    dir_entry *ent = (*iter)[file_model_columns::instance().ent];
+    auto *icon_cell = static_cast<Gtk::CellRendererPixbuf*>(cell);
+
+    if (ent)
+        icon_cell->property_pixbuf() = icon_loader::instance().load_icon(*ent);
+    else
+        icon_cell->property_pixbuf() = Glib::RefPtr<Gdk::Pixbuf>();
 }
 
 
 //// Full Name Column Implementation
 
-void full_name_column::add_column(file_model_columns &columns) {
-    columns.add(column);
-}
-
 Gtk::TreeView::Column *full_name_column::create() {
     auto *column = create_column(title);
-    auto *cell = add_text_cell(column, this->column);
+    auto *cell = add_text_cell(column, &format);
 
     cell->property_ellipsize().set_value(Pango::ELLIPSIZE_END);
 
@@ -300,20 +294,16 @@ Gtk::TreeSortable::SlotCompare full_name_column::sort_func(Gtk::SortType order)
     return combine_sort(make_invariant_sort(sort_entry_type, order), sort_name);
 }
 
-void full_name_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
-    row[column] = ent.file_name();
+Glib::ustring full_name_column::format(const nuc::dir_entry &ent) {
+    return ent.file_name();
 }
 
 
 //// Name Column Implementation
 
-void name_column::add_column(file_model_columns &columns) {
-    columns.add(column);
-}
-
 Gtk::TreeView::Column *name_column::create() {
     auto *column = create_column(title);
-    auto *cell = add_text_cell(column, this->column);
+    auto *cell = add_text_cell(column, &format);
 
     cell->property_ellipsize().set_value(Pango::ELLIPSIZE_END);
 
@@ -327,22 +317,19 @@ Gtk::TreeSortable::SlotCompare name_column::sort_func(Gtk::SortType order) {
     return combine_sort(make_invariant_sort(sort_entry_type, order), sort_name);
 }
 
-void name_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
-    row[column] = ent.subpath().filename();
+Glib::ustring name_column::format(const nuc::dir_entry &ent) {
+    return ent.subpath().filename();
 }
 
 
 //// Icon Column Implementation
 
-void icon_column::add_column(file_model_columns &columns) {
-    columns.add(columns.icon);
-}
-
 Gtk::TreeView::Column *icon_column::create() {
-    auto &columns = file_model_columns::instance();
     auto *column = create_column(title);
+    auto *cell = Gtk::manage(new Gtk::CellRendererPixbuf());
 
-    column->pack_start(columns.icon, false);
+    column->pack_start(*cell, false);
+    column->set_cell_data_func(*cell, sigc::ptr_fun(&set_cell_icon));
     column->set_resizable(false);
 
     return column;
@@ -354,19 +341,12 @@ Gtk::TreeSortable::SlotCompare icon_column::sort_func(Gtk::SortType order) {
     return Gtk::TreeSortable::SlotCompare();
 }
 
-void icon_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
-}
-
 
 //// File Size Column Implementation
 
-void size_column::add_column(file_model_columns &columns) {
-    columns.add(column);
-}
-
 Gtk::TreeView::Column *size_column::create() {
     auto *column = create_column(title);
-    add_text_cell(column, this->column);
+    add_text_cell(column, &format);
 
     column->set_expand(false);
     column->set_sort_column(this->column.index());
@@ -378,12 +358,15 @@ Gtk::TreeSortable::SlotCompare size_column::sort_func(Gtk::SortType order) {
     return combine_sort(make_invariant_sort(sort_entry_type, order), sort_size, make_invariant_sort(sort_name, order));
 }
 
-void size_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
+Glib::ustring size_column::format(const nuc::dir_entry &ent) {
     switch (ent.type()) {
     case dir_entry::type_reg: {
+        if (!ent.has_attr())
+            return "";
+
         const char *unit = "";
 
-        size_t size = ent.attr().st_size;
+        size_t size = ent.attr().size;
         float frac = 0;
 
         if (size >= 1073741824) {
@@ -406,32 +389,26 @@ void size_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
         }
 
         if (int rem = (int)floorf(frac * 10)) {
-            row[column] = Glib::ustring::compose("%1.%2 %3", size, rem, unit);
+            return Glib::ustring::compose("%1.%2 %3", size, rem, unit);
         }
-        else {
-            row[column] = Glib::ustring::compose("%1 %2", size, unit);
-        }
-    } break;
+
+        return Glib::ustring::compose("%1 %2", size, unit);
+    }
 
     case dir_entry::type_dir:
-        row[column] = "<DIR>";
-        break;
+        return "<DIR>";
 
     default:
-        row[column] = "";
+        return "";
     }
 }
 
 
 //// Last Modified Date Column Implementation
 
-void date_column::add_column(file_model_columns &columns) {
-    columns.add(column);
-}
-
 Gtk::TreeView::Column *date_column::create() {
     auto *column = create_column(title);
-    add_text_cell(column, this->column);
+    add_text_cell(column, &format);
 
     column->set_expand(false);
     column->set_sort_column(this->column.index());
@@ -443,32 +420,27 @@ Gtk::TreeSortable::SlotCompare date_column::sort_func(Gtk::SortType order) {
     return combine_sort(make_invariant_sort(sort_entry_type, order), sort_mtime, make_invariant_sort(sort_name, order));
 }
 
-void date_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
-    if (ent.ent_type() != dir_entry::type_parent) {
+Glib::ustring date_column::format(const nuc::dir_entry &ent) {
+    if (ent.ent_type() != dir_entry::type_parent && ent.has_attr()) {
         // localtime is NOT THREAD SAFE
-        auto tm = localtime(&ent.attr().st_mtime);
+        auto tm = localtime(&ent.attr().mtime);
 
         const size_t buf_size = 17;
         char buf[buf_size]  = {0};
 
         strftime(buf, buf_size, "%d/%m/%Y %H:%M", tm);
-        row[column] = buf;
-    }
-    else {
-        row[column] = "";
+        return buf;
     }
+
+    return "";
 }
 
 
 //// Extension Column Implementation
 
-void extension_column::add_column(file_model_columns &columns) {
-    columns.add(column);
-}
-
 Gtk::TreeView::Column *extension_column::create() {
     auto *column = create_column(title);
-    auto *cell = add_text_cell(column, this->column);
+    auto *cell = add_text_cell(column, &format);
 
     column->set_expand(false);
     cell->property_ellipsize() = Pango::ELLIPSIZE_END;
@@ -481,6 +453,6 @@ Gtk::TreeSortable::SlotCompare extension_column::sort_func(Gtk::SortType order)
     return combine_sort(make_invariant_sort(sort_entry_type, order), sort_extension, make_invariant_sort(sort_name, order));
 }
 
-void extension_column::set_data(Gtk::TreeRow row, const nuc::dir_entry &ent) {
-    row[column] = ent.subpath().extension();
+Glib::ustring extension_column::format(const nuc::dir_entry &ent) {
+    return ent.subpath().extension();
 }
@@ -70,9 +70,14 @@ namespace nuc {
         /**
          * Adds the column to the column model.
          *
+         * The column added to the model only serves as the sort
+         * column identifier. No values are stored in it, the cells
+         * are formatted, from the row's entry, when they are
+         * rendered.
+         *
          * @param columns The model.
          */
-        virtual void add_column(file_model_columns &columns) = 0;
+        virtual void add_column(file_model_columns &columns);
 
         /**
          * Creates a new instance of the column.
@@ -90,21 +95,21 @@ namespace nuc {
          */
         virtual Gtk::TreeSortable::SlotCompare sort_func(Gtk::SortType order = Gtk::SortType::SORT_ASCENDING) = 0;
 
-        /**
-         * Sets the value of the column for the row @a row.
-         *
-         * @param row The row whose column value to set.
-         * @param ent The entry corresponding to the row.
-         */
-        virtual void set_data(Gtk::TreeRow row, const dir_entry &ent) = 0;
-
         /**
          * Returns the index of the column within the
          * TreeModelColumnRecord.
          *
          * @return The index.
          */
-        virtual int model_index() const = 0;
+        virtual int model_index() const {
+            return column.index();
+        }
+
+    protected:
+        /**
+         * Model column, which identifies the column when sorting.
+         */
+        Gtk::TreeModelColumn<bool> column;
     };
 
     /**
@@ -20,12 +20,12 @@
 #include "file_list_controller.h"
 
 #include <algorithm>
+#include <chrono>
 #include <time.h>
 
 #include "file_list/sort_func.h"
 
 #include "tasks/async_task.h"
-#include "directory/icon_loader.h"
 
 #include "operations/copy.h"
 
@@ -33,6 +33,24 @@
 
 using namespace nuc;
 
+/**
+ * Maximum amount of time, in microseconds, spent adding rows to the
+ * list in a single iteration of the main loop.
+ */
+static constexpr long row_insert_budget = 8000;
+
+/**
+ * Number of rows added between checks of the elapsed time.
+ */
+static constexpr size_t row_insert_batch = 64;
+
+/**
+ * Time, in milliseconds, for which the selection has to remain
+ * unchanged before the selected and parent directories are
+ * prefetched.
+ */
+static constexpr unsigned int prefetch_delay = 300;
+
 
 //// Private Functions
 
@@ -50,31 +68,21 @@ static void sort_changed(Gtk::ListStore *list_store);
 /// Creating Entries
 
 /**
- * Fills in the tree view row's columns with the details of
- * the entry 'ent'.
+ * Stores the entry 'ent' in the tree view row. The cells of the
+ * row are formatted, from the entry, when they are rendered.
  *
  * @param row The tree view row.
  * @param ent The entry.
  */
 static void create_row(Gtk::TreeRow row, dir_entry &ent);
 
-
-/// Icons
-
-/**
- * Loads the icons for all entries in @a new_list.
- *
- * @param new_list The list containing the icons to be loaded.
- */
-static void load_icons(Glib::RefPtr<Gtk::ListStore> new_list);
-
 /**
- * Loads the icon for the entry at row @a row, and stores the
- * entry in the icon column of the row.
+ * Changes the entry displayed in the row @a row to @a new_ent.
  *
- * @param row The row.
+ * @param row The tree view row.
+ * @param new_ent The new entry.
  */
-static void load_icon(Gtk::TreeRow row);
+static void update_row(Gtk::TreeRow row, dir_entry &new_ent);
 
 
 //// Initialization
@@ -148,6 +156,11 @@ void file_list_controller::init_vfs() {
         if (auto self = ptr.lock())
             self->vfs_dir_deleted(path);
     });
+
+    vfs.signal_attrs().connect([=] (const std::vector<dir_entry *> &entries) {
+        if (auto self = ptr.lock())
+            self->vfs_attrs_read(entries);
+    });
 }
 
 
@@ -160,11 +173,12 @@ struct file_list_controller::read_delegate : public vfs::delegate {
     std::weak_ptr<file_list_controller> flist;
 
     /**
-     * List store model into which the entries are read.
+     * Entries read. Rows are created for the entries, on the main
+     * thread, once the read operation completes.
      */
-    Glib::RefPtr<Gtk::ListStore> list;
+    std::vector<dir_entry *> entries;
 
-    read_delegate(std::weak_ptr<file_list_controller> flist);
+    read_delegate(std::weak_ptr<file_list_controller> flist) : flist(flist) {}
 
     virtual void begin();
     virtual void new_entry(dir_entry &ent);
@@ -172,14 +186,12 @@ struct file_list_controller::read_delegate : public vfs::delegate {
 };
 
 
-file_list_controller::read_delegate::read_delegate(std::weak_ptr<file_list_controller> flist) :
-    flist(flist), list(make_liststore()) {}
-
-void file_list_controller::read_delegate::begin() {}
+void file_list_controller::read_delegate::begin() {
+    entries.clear();
+}
 
 void file_list_controller::read_delegate::new_entry(dir_entry &ent) {
-    Gtk::TreeRow row = *list->append();
-    create_row(row, ent);
+    entries.push_back(&ent);
 }
 
 void create_row(Gtk::TreeRow row, dir_entry &ent) {
@@ -189,10 +201,11 @@ void create_row(Gtk::TreeRow row, dir_entry &ent) {
     row[columns.marked] = false;
 
     ent.context.row = row;
+}
 
-    for (auto *col : columns.columns) {
-        col->set_data(row, ent);
-    }
+void update_row(Gtk::TreeRow row, dir_entry &new_ent) {
+    row[file_model_columns::instance().ent] = &new_ent;
+    new_ent.context.row = row;
 }
 
 void file_list_controller::read_delegate::finish(bool cancelled, int error) {
@@ -201,7 +214,7 @@ void file_list_controller::read_delegate::finish(bool cancelled, int error) {
             ptr->reset_list();
         }
         else {
-            ptr->finish_read(list);
+            ptr->finish_read(std::move(entries));
         }
     }
 }
@@ -210,15 +223,30 @@ void file_list_controller::read_delegate::finish(bool cancelled, int error) {
 /// Update Delegate
 
 struct file_list_controller::update_delegate : public read_delegate {
+    /**
+     * The entries read, indexed by name.
+     */
+    entry_map entry_index;
+
     using read_delegate::read_delegate;
 
+    virtual void begin();
+    virtual void new_entry(dir_entry &ent);
     virtual void finish(bool cancelled, int error);
 };
 
+void file_list_controller::update_delegate::begin() {
+    entry_index.clear();
+}
+
+void file_list_controller::update_delegate::new_entry(dir_entry &ent) {
+    entry_index.emplace(ent.file_name(), &ent);
+}
+
 void file_list_controller::update_delegate::finish(bool cancelled, int error) {
     if (auto ptr = flist.lock()) {
         if (!error && !cancelled) {
-            ptr->set_updated_list(list);
+            ptr->set_updated_list(std::move(entry_index));
         }
     }
 }
@@ -242,7 +270,7 @@ void file_list_controller::move_up_delegate::finish(bool cancelled, int error) {
             ptr->read_parent_dir(path);
         }
         else {
-            ptr->finish_read(list);
+            ptr->finish_read(std::move(entries));
         }
     }
 }
@@ -259,6 +287,21 @@ void file_list_controller::vfs_dir_deleted(pathname new_path) {
         read_parent_dir(new_path.empty() ? cur_path : std::move(new_path));
 }
 
+void file_list_controller::vfs_attrs_read(const std::vector<dir_entry *> &entries) {
+    auto &columns = file_model_columns::instance();
+
+    for (dir_entry *ent : entries) {
+        Gtk::TreeRow row = ent->context.row;
+
+        // Storing the entry again emits the row changed signal,
+        // which redraws the row and moves it to its sorted
+        // position.
+
+        if (row)
+            row[columns.ent] = ent;
+    }
+}
+
 void file_list_controller::read_parent_dir(pathname path) {
     if (!path.is_root()) {
         path = path.remove_last_component();
@@ -286,25 +329,85 @@ void file_list_controller::reset_list() {
     move_to_old = false;
 }
 
-void file_list_controller::set_updated_list(Glib::RefPtr<Gtk::ListStore> new_list) {
+void file_list_controller::set_updated_list(entry_map entries) {
+    auto &columns = file_model_columns::instance();
+
     bool selection = false;
     pathname::string name;
     index_type index = 0;
 
     if (selected_row) {
         // Get name of selected row's entry
-        dir_entry *ent = selected_row[file_model_columns::instance().ent];
+        dir_entry *ent = selected_row[columns.ent];
         name = ent->file_name();
 
         selection = true;
         index = cur_list->get_path(selected_row)[0];
     }
 
-    set_new_list(new_list, false);
+    // The pending entries belong to the old tree. Those which still
+    // exist are in 'entries' and are added to the list below.
+    clear_pending_rows();
+
+    // Determine which rows are updated and which are removed before
+    // modifying the list, as updating a row moves it to its sorted
+    // position, which would cause rows to be skipped or visited
+    // twice. List store iterators remain valid when rows are
+    // reordered.
+
+    std::vector<std::pair<Gtk::TreeIter, dir_entry *>> changes;
+
+    auto rows = cur_list->children();
+
+    for (auto it = rows.begin(), end = rows.end(); it != end; ++it) {
+        Gtk::TreeRow row = *it;
+        dir_entry *ent = row[columns.ent];
+
+        if (ent->ent_type() == dir_entry::type_parent)
+            continue;
+
+        auto match = entries.find(ent->file_name());
+
+        if (match != entries.end()) {
+            changes.emplace_back(it, match->second);
+            entries.erase(match);
+        }
+        else {
+            changes.emplace_back(it, nullptr);
+        }
+    }
+
+    // Update the rows of the entries which still exist, and remove
+    // the rows of the entries which no longer exist.
+
+    bool selection_removed = false;
+
+    for (auto &change : changes) {
+        if (change.second) {
+            update_row(*change.first, *change.second);
+        }
+        else {
+            if (selection && change.first == selected_row)
+                selection_removed = true;
+
+            cur_list->erase(change.first);
+        }
+    }
+
+    // Add rows for the new entries
+
+    std::vector<dir_entry *> new_entries;
+    new_entries.reserve(entries.size());
+
+    for (auto &ent : entries) {
+        new_entries.push_back(ent.second);
+    }
+
+    add_rows(std::move(new_entries));
 
     update_marked_set();
 
-    if (selection)
+    if (selection_removed)
         select_named(name, index);
 }
 
@@ -314,12 +417,12 @@ void file_list_controller::update_marked_set() {
     while (it != end) {
         auto entries = vfs.get_entries(it->first);
 
-        if (std::distance(entries.first, entries.second) != 1) {
+        if (entries.size() != 1) {
             it = marked_set.erase(it);
             continue;
         }
         else {
-            mark_row(it->second = entries.first->second.context.row, true);
+            mark_row(it->second = entries.front()->context.row, true);
         }
 
         ++it;
@@ -327,10 +430,20 @@ void file_list_controller::update_marked_set() {
 }
 
 
-void file_list_controller::finish_read(Glib::RefPtr<Gtk::ListStore> new_list) {
+void file_list_controller::finish_read(std::vector<dir_entry *> entries) {
     reading = false;
 
-    set_new_list(new_list, true);
+    set_new_list(make_liststore(), true);
+
+    // Add the row of the entry, which is to be selected, first.
+    if (move_to_old) {
+        auto it = std::find(entries.begin(), entries.end(), vfs.get_entry(cur_path.basename()));
+
+        if (it != entries.end())
+            std::iter_swap(entries.begin(), it);
+    }
+
+    add_rows(std::move(entries));
     restore_selection();
 
     cur_path = vfs.path();
@@ -338,14 +451,15 @@ void file_list_controller::finish_read(Glib::RefPtr<Gtk::ListStore> new_list) {
 }
 
 void file_list_controller::set_new_list(Glib::RefPtr<Gtk::ListStore> new_list, bool clear_marked) {
+    // The pending entries belong to the old list
+    clear_pending_rows();
+
     // Clear marked set
     if (clear_marked)
         marked_set.clear();
 
     add_parent_entry(new_list, vfs.path());
 
-    load_icons(new_list);
-
     // Sort new_list using cur_list's sort order
     set_sort_column(new_list);
 
@@ -370,6 +484,68 @@ void file_list_controller::add_parent_entry(Glib::RefPtr<Gtk::ListStore> new_lis
         create_row(*new_list->append(), parent_entry);
 }
 
+
+//// Adding Rows Incrementally
+
+void file_list_controller::add_rows(std::vector<dir_entry *> entries) {
+    if (pending_index < pending_entries.size()) {
+        pending_entries.insert(pending_entries.end(), entries.begin(), entries.end());
+        return;
+    }
+
+    pending_entries = std::move(entries);
+    pending_index = 0;
+
+    // Add the first rows immediately, so that they are displayed
+    // in the first frame.
+
+    if (add_pending_rows()) {
+        auto ptr = std::weak_ptr<file_list_controller>(shared_from_this());
+
+        pending_conn = Glib::signal_idle().connect([ptr] {
+            if (auto self = ptr.lock())
+                return self->add_pending_rows();
+
+            return false;
+        });
+    }
+}
+
+bool file_list_controller::add_pending_rows() {
+    typedef std::chrono::steady_clock clock;
+
+    auto start = clock::now();
+
+    while (pending_index < pending_entries.size()) {
+        size_t end = std::min(pending_index + row_insert_batch, pending_entries.size());
+
+        for (; pending_index < end; pending_index++) {
+            add_row(*pending_entries[pending_index]);
+        }
+
+        if (std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count() >= row_insert_budget)
+            return pending_index < pending_entries.size();
+    }
+
+    pending_entries.clear();
+    pending_index = 0;
+
+    return false;
+}
+
+void file_list_controller::clear_pending_rows() {
+    pending_conn.disconnect();
+
+    pending_entries.clear();
+    pending_index = 0;
+}
+
+void file_list_controller::add_row(dir_entry &ent) {
+    Gtk::TreeRow row = *cur_list->append();
+
+    create_row(row, ent);
+}
+
 
 //// Sorting
 
@@ -426,6 +602,7 @@ void file_list_controller::select_row(index_type index) {
     selected_row = row;
 
     m_signal_select.emit(row);
+    schedule_prefetch();
 }
 
 
@@ -470,25 +647,27 @@ void file_list_controller::select_named(const pathname::string &name, index_type
 void file_list_controller::on_selection_changed(Gtk::TreeRow row) {
     if (!reading) {
         selected_row = row;
+        schedule_prefetch();
     }
 }
 
 
-//// Icons
-
-void load_icons(Glib::RefPtr<Gtk::ListStore> new_list) {
-    using namespace std::placeholders;
+//// Prefetching
 
-    auto children = new_list->children();
-
-    std::for_each(children.begin(), children.end(), std::bind(&load_icon, _1));
-}
+void file_list_controller::schedule_prefetch() {
+    auto ptr = std::weak_ptr<file_list_controller>(shared_from_this());
 
-void load_icon(Gtk::TreeRow row) {
-    auto &columns = file_model_columns::instance();
-    dir_entry &ent = *row[columns.ent];
+    prefetch_conn.disconnect();
+    prefetch_conn = Glib::signal_timeout().connect([ptr] {
+        if (auto self = ptr.lock()) {
+            if (!self->reading && self->selected_row) {
+                dir_entry *ent = self->selected_row[file_model_columns::instance().ent];
+                self->vfs.prefetch(*ent);
+            }
+        }
 
-    row[columns.icon] = icon_loader::instance().load_icon(ent);
+        return false;
+    }, prefetch_delay);
 }
 
 
@@ -536,6 +715,8 @@ void file_list_controller::prepare_read(bool move_to_old) {
     this->move_to_old = move_to_old;
     reading = true;
 
+    prefetch_conn.disconnect();
+
     clear_view();
 }
 
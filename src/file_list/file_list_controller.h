@@ -28,6 +28,7 @@
 
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
 #include "paths/pathname.h"
 
@@ -61,6 +62,11 @@ namespace nuc {
          */
         typedef std::unordered_multimap<std::string, Gtk::TreeRow> entry_set;
 
+        /**
+         * Map of entries indexed by name.
+         */
+        typedef std::unordered_multimap<pathname::string, dir_entry *> entry_map;
+
 
         /* Signal Types */
 
@@ -226,6 +232,37 @@ namespace nuc {
         Glib::RefPtr<Gtk::ListStore> empty_list;
 
 
+        /* Incremental Row Insertion */
+
+        /**
+         * Entries of which the rows are to be added to 'cur_list'.
+         *
+         * The rows are added in the idle handler, a limited number
+         * per iteration of the main loop, so that large directories
+         * are displayed while their rows are being added.
+         */
+        std::vector<dir_entry *> pending_entries;
+
+        /**
+         * Index of the first entry, in 'pending_entries', of which
+         * the row has not been added yet.
+         */
+        size_t pending_index = 0;
+
+        /**
+         * Idle handler connection.
+         */
+        sigc::connection pending_conn;
+
+
+        /* Prefetching */
+
+        /**
+         * Prefetch timeout connection.
+         */
+        sigc::connection prefetch_conn;
+
+
         /* Selection and Marked Entry State */
 
         /**
@@ -312,6 +349,13 @@ namespace nuc {
          */
         void vfs_dir_deleted(pathname new_path);
 
+        /**
+         * Attributes signal handler. Updates the rows of the entries
+         * @a entries, of which the stat attributes have been
+         * retrieved.
+         */
+        void vfs_attrs_read(const std::vector<dir_entry *> &entries);
+
 
         /* Reading new directories */
 
@@ -365,9 +409,10 @@ namespace nuc {
          * Emits 'model_changed', 'select_row' and 'path_changed'
          * signals.
          *
-         * @param new_list The new list to set.
+         * @param entries The entries of the directory. Their rows
+         *   are added incrementally.
          */
-        void finish_read(Glib::RefPtr<Gtk::ListStore> new_list);
+        void finish_read(std::vector<dir_entry *> entries);
 
         /**
          * Sets 'cur_list' to @a new_list.
@@ -404,17 +449,53 @@ namespace nuc {
          */
         void reset_list();
 
+
+        /* Adding Rows Incrementally */
+
+        /**
+         * Adds rows, for the entries @a entries, to 'cur_list'.
+         *
+         * The first rows are added immediately, the remaining rows
+         * are added by an idle handler.
+         *
+         * @param entries The entries.
+         */
+        void add_rows(std::vector<dir_entry *> entries);
+
         /**
-         * Sets the new 'refreshed' file list.
+         * Adds the rows of the pending entries, until the time
+         * budget of a single main loop iteration is exhausted.
          *
-         * Emits the 'model_changed' signal with the new list model
-         * and restores the previous selection if an entry with the
-         * same name, as the previously selected entry, still
-         * exits. Updates the marked set.
+         * @return True if there are pending entries remaining.
+         */
+        bool add_pending_rows();
+
+        /**
+         * Discards the pending entries, without adding their rows.
+         */
+        void clear_pending_rows();
+
+        /**
+         * Adds a row for an entry to 'cur_list'.
          *
-         * @param new_list The new list to set.
+         * @param ent The entry.
          */
-        void set_updated_list(Glib::RefPtr<Gtk::ListStore> new_list);
+        void add_row(dir_entry &ent);
+
+        /**
+         * Updates the current list with the entries of the refreshed
+         * directory.
+         *
+         * Rather than rebuilding the list, the rows of the entries,
+         * which still exist, are updated in place, the rows of the
+         * entries which no longer exist are removed and rows are
+         * added for the new entries. If the selected row is removed
+         * the row at the same index is selected. Updates the marked
+         * set.
+         *
+         * @param entries The entries of the refreshed directory.
+         */
+        void set_updated_list(entry_map entries);
 
         /**
          * Updates the marked set, after a directory refresh.
@@ -455,6 +536,16 @@ namespace nuc {
         void select_named(const pathname::string &name, index_type row = 0);
 
 
+        /* Prefetching */
+
+        /**
+         * Prefetches the directories which are likely to be visited
+         * next, once the selection has not changed for a short
+         * period of time.
+         */
+        void schedule_prefetch();
+
+
         /* Marking */
 
         /**
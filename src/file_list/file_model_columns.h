@@ -22,7 +22,6 @@
 
 #include <gtkmm/treemodelcolumn.h>
 #include <gdkmm/rgba.h>
-#include <gdkmm/pixbuf.h>
 
 #include "directory/dir_entry.h"
 #include "columns.h"
@@ -53,11 +52,6 @@ namespace nuc {
          */
         Gtk::TreeModelColumn<Gdk::RGBA> color;
 
-        /**
-         * File icon.
-         */
-        Gtk::TreeModelColumn<Glib::RefPtr<Gdk::Pixbuf>> icon;
-
         /**
          * Array of column descriptors of the columns which are
          * displayed.
@@ -62,8 +62,8 @@ int nuc::sort_size(const Gtk::TreeModel::iterator &a, const Gtk::TreeModel::iter
     dir_entry *ent1 = (*a)[columns.ent];
     dir_entry *ent2 = (*b)[columns.ent];
 
-    size_t sz1 = ent1->attr().st_size;
-    size_t sz2 = ent2->attr().st_size;
+    size_t sz1 = ent1->attr().size;
+    size_t sz2 = ent2->attr().size;
 
     return sz1 > sz2 ? 1 : (sz1 < sz2 ? -1 : 0);
 }
@@ -74,8 +74,8 @@ int nuc::sort_mtime(const Gtk::TreeModel::iterator &a, const Gtk::TreeModel::ite
     dir_entry *ent1 = (*a)[columns.ent];
     dir_entry *ent2 = (*b)[columns.ent];
 
-    auto tm1 = ent1->attr().st_mtime;
-    auto tm2 = ent2->attr().st_mtime;
+    auto tm1 = ent1->attr().mtime;
+    auto tm2 = ent2->attr().mtime;
 
     return tm1 > tm2 ? 1 : (tm1 < tm2 ? -1 : 0);
 }
@@ -113,14 +113,18 @@ void prefs_window::init_general(const Glib::RefPtr<Gtk::Builder> &builder) {
 
     refresh_timeout_entry->set_range(100, 10000);
     refresh_timeout_entry->set_increments(100, 1000);
+
+    builder->get_widget("preallocate_check", preallocate_check);
 }
 
 void prefs_window::get_general_settings() {
     refresh_timeout_entry->set_value(app_settings::instance().dir_refresh_timeout());
+    preallocate_check->set_active(app_settings::instance().preallocate_files());
 }
 
 void prefs_window::store_general_settings() {
     app_settings::instance().dir_refresh_timeout(refresh_timeout_entry->get_value_as_int());
+    app_settings::instance().preallocate_files(preallocate_check->get_active());
 }
 
 
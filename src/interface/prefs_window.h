@@ -26,6 +26,7 @@
 #include <gtkmm/treeview.h>
 #include <gtkmm/liststore.h>
 #include <gtkmm/spinbutton.h>
+#include <gtkmm/checkbutton.h>
 
 #include "paths/pathname.h"
 
@@ -64,6 +65,7 @@ namespace nuc {
         /* General Preferences */
 
         Gtk::SpinButton *refresh_timeout_entry;
+        Gtk::CheckButton *preallocate_check;
 
 
         /* Key Binding Preferences */
@@ -64,6 +64,37 @@ bool archive_lister::read_entry(lister::entry &ent) {
     return true;
 }
 
+bool archive_lister::can_seek() const {
+    return plugin->seek_entry;
+}
+
+bool archive_lister::seek_entry(const pathname &path, lister::entry &ent) {
+    int err = plugin->seek_entry(handle, path.path().c_str());
+
+    if (err == NUC_AP_EOF)
+        return false;
+
+    // If the plugin cannot locate the entry directly, in this
+    // archive, the entries are read sequentially.
+
+    if (err != NUC_AP_OK && errno == ENOTSUP) {
+        while (read_entry(ent)) {
+            if (path == pathname(ent.name).canonicalize())
+                return true;
+        }
+
+        return false;
+    }
+
+    if (err != NUC_AP_OK)
+        raise_error(errno);
+
+    ent.name = path.path().c_str();
+    ent.type = IFTODT(plugin->entry_stat(handle)->st_mode & S_IFMT);
+
+    return true;
+}
+
 bool archive_lister::entry_stat(struct stat& st) {
     const struct stat *s = plugin->entry_stat(handle);
 
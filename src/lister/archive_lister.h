@@ -68,6 +68,9 @@ namespace nuc {
         virtual bool read_entry(entry &ent);
         virtual bool entry_stat(struct stat &st);
 
+        virtual bool can_seek() const;
+        virtual bool seek_entry(const pathname &path, entry &ent);
+
         virtual instream *open_entry();
 
         /* Archive Lister Specific Methods */
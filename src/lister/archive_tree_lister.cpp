@@ -42,40 +42,50 @@ void archive_tree_lister::list_entries(const list_callback &fn) {
 
     add_list_callback(fn);
 
+    // All entries are read, even if only a single path is visited,
+    // as the path may be a directory, whose children are not known
+    // until the entire archive is read, and an archive may contain
+    // multiple entries with the same path, of which the last one
+    // takes precedence.
+
     while (listr->read_entry(ent)) {
-        pathname ent_path = pathname(ent.name).canonicalize();
+        visit_entry(ent, st);
+    }
+
+    for (auto it = visited_dirs.rbegin(), end = visited_dirs.rend(); it != end; ++it) {
+        ent.name = it->first.path().c_str();
+        ent.type = DT_DIR;
 
-        if (ent.type == DT_DIR)
-            ent_path = pathname(ent_path, true);
+        if (it->second.second)
+            list_fn(ent, &it->second.first, visit_postorder);
+    }
+}
 
-        size_t offset = path_offset(ent_path);
-        if (offset != pathname::string::npos) {
-            bool got_stat = listr->entry_stat(st);
+void archive_tree_lister::visit_entry(lister::entry &ent, struct stat &st) {
+    pathname ent_path = pathname(ent.name).canonicalize();
 
-            ent.name = ent_path.path().c_str() + offset;
+    if (ent.type == DT_DIR)
+        ent_path = pathname(ent_path, true);
 
-            if (ent.type == DT_DIR) {
-                if (!got_stat) {
-                    st.st_mode = S_IFDIR | S_IRWXU;
-                }
+    size_t offset = path_offset(ent_path);
+    if (offset != pathname::string::npos) {
+        bool got_stat = listr->entry_stat(st);
 
-                pathname::string name(ent.name);
+        ent.name = ent_path.path().c_str() + offset;
 
-                if (!add_dir_stat(name, &st)) {
-                    continue;
-                }
+        if (ent.type == DT_DIR) {
+            if (!got_stat) {
+                st.st_mode = S_IFDIR | S_IRWXU;
             }
 
-            list_fn(ent, got_stat ? &st : nullptr, visit_preorder);
-        }
-    }
+            pathname::string name(ent.name);
 
-    for (auto it = visited_dirs.rbegin(), end = visited_dirs.rend(); it != end; ++it) {
-        ent.name = it->first.path().c_str();
-        ent.type = DT_DIR;
+            if (!add_dir_stat(name, &st)) {
+                return;
+            }
+        }
 
-        if (it->second.second)
-            list_fn(ent, &it->second.first, visit_postorder);
+        list_fn(ent, got_stat ? &st : nullptr, visit_preorder);
     }
 }
 
@@ -89,6 +89,15 @@ namespace nuc {
          */
         std::unique_ptr<archive_lister> listr;
 
+        /**
+         * Visits the last entry read by the archive lister, if it
+         * should be visited, by calling the list callback.
+         *
+         * @param ent The entry.
+         * @param st Stat struct used to store the entry's attributes.
+         */
+        void visit_entry(lister::entry &ent, struct stat &st);
+
         /**
          * Checks whether the entry @a path should be visited,
          * i.e. whether it is a child of any entry in
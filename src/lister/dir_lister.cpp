@@ -25,71 +25,166 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #include <cstring>
 
 #include "stream/file_instream.h"
+#include "stream/fsutil.h"
+#include "stream/block_size.h"
 
 using namespace nuc;
 
+/**
+ * Returns true if @a name is the name of the "." or ".." entry.
+ */
+static bool is_dot_entry(const char *name);
+
+#ifdef __linux__
+
+/**
+ * Size of the buffer into which directory entries are read.
+ */
+static constexpr size_t dirent_buf_size = 256 * 1024;
+
+/**
+ * Directory entry record returned by getdents64.
+ */
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
 dir_lister::dir_lister(const pathname::string &path) {
-    if (!(dp = opendir(path.c_str()))) {
+    if ((fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
         raise_error(errno);
     }
+
+    buf.reset(new char[dirent_buf_size]);
 }
 
+void dir_lister::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
 
-dir_lister::~dir_lister() {
-    close();
+int dir_lister::dir_fd() const {
+    return fd;
 }
 
-void dir_lister::close() {
-    if (dp) closedir(dp);
-    dp = nullptr;
+bool dir_lister::next_ent() {
+    do {
+        if (buf_pos >= buf_len && !read_entries())
+            return false;
+
+        auto ent = reinterpret_cast<linux_dirent64 *>(buf.get() + buf_pos);
+        buf_pos += ent->d_reclen;
+
+        last_name = ent->d_name;
+        last_type = ent->d_type;
+    } while (is_dot_entry(last_name));
+
+    return true;
 }
 
+bool dir_lister::read_entries() {
+    ssize_t n;
 
-bool dir_lister::read_entry(lister::entry &ent) {
-    last_ent = next_ent();
+    while ((n = syscall(SYS_getdents64, fd, buf.get(), dirent_buf_size)) < 0) {
+        if (errno != EINTR) raise_error(errno);
+    }
 
-    if (!last_ent) {
-        return false;
+    buf_len = n;
+    buf_pos = 0;
+
+    return n > 0;
+}
+
+#else
+
+dir_lister::dir_lister(const pathname::string &path) {
+    if (!(dp = opendir(path.c_str()))) {
+        raise_error(errno);
     }
+}
 
-    ent.name = last_ent->d_name;
-    ent.type = last_ent->d_type;
+void dir_lister::close() {
+    if (dp) closedir(dp);
+    dp = nullptr;
+}
 
-    return true;
+int dir_lister::dir_fd() const {
+    return dirfd(dp);
 }
 
-struct dirent* dir_lister::next_ent() {
+bool dir_lister::next_ent() {
     struct dirent *ent;
 
     do {
         errno = 0;
         ent = readdir(dp);
-    } while (ent && (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")));
+    } while (ent && is_dot_entry(ent->d_name));
 
     if (!ent) {
         int err = errno;
 
         if (err) raise_error(err);
+        return false;
     }
 
-    return ent;
+    last_name = ent->d_name;
+    last_type = ent->d_type;
+
+    return true;
 }
 
+#endif
+
+dir_lister::~dir_lister() {
+    close();
+}
 
-bool dir_lister::entry_stat(struct stat &st) {
-    int fd = dirfd(dp);
 
-    if (fstatat(fd, last_ent->d_name, &st, 0)) {
-        return !fstatat(fd, last_ent->d_name, &st, AT_SYMLINK_NOFOLLOW);
+bool dir_lister::read_entry(lister::entry &ent) {
+    if (!next_ent()) {
+        return false;
     }
 
+    ent.name = last_name;
+    ent.type = last_type;
+
     return true;
 }
 
+bool is_dot_entry(const char *name) {
+    return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+
+bool dir_lister::entry_stat(struct stat &st) {
+    return fs::entry_stat(dir_fd(), last_name, last_type, st);
+}
+
+bool dir_lister::concurrent_stat() const {
+    return true;
+}
+
+bool dir_lister::stat_entry(const entry &ent, struct stat &st) {
+    return fs::entry_stat(dir_fd(), ent.name, ent.type, st);
+}
+
+bool dir_lister::slow_stat() const {
+    struct stat st;
+
+    return !fstat(dir_fd(), &st) && get_device_type(dir_fd(), st) == device_network;
+}
+
 
 instream * dir_lister::open_entry() {
-    return new file_instream(dirfd(dp), last_ent->d_name);
+    return new file_instream(dir_fd(), last_name);
 }
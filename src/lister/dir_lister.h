@@ -22,11 +22,22 @@
 
 #include "lister/lister.h"
 
+#include <memory>
+
 namespace nuc {
 
     /**
      * Implements the lister interface for reading regular on disk
      * directories.
+     *
+     * On Linux the directory entries are read in large batches
+     * directly with getdents64(2), rather than through readdir.
+     *
+     * entry_stat retrieves only the attributes which are displayed
+     * in the file list, see fs::entry_stat.
+     *
+     * Stat attributes are only considered slow to retrieve if the
+     * directory is on a network file system.
      */
     class dir_lister : public lister {
     public:
@@ -49,21 +60,58 @@ namespace nuc {
         virtual bool read_entry(entry &ent);
         virtual bool entry_stat(struct stat &st);
 
+        virtual bool concurrent_stat() const;
+        virtual bool stat_entry(const entry &ent, struct stat &st);
+        virtual bool slow_stat() const;
+
         virtual instream *open_entry();
 
     private:
+#ifdef __linux__
+        /** Directory file descriptor. */
+        int fd = -1;
+
+        /** Buffer into which the directory entries are read. */
+        std::unique_ptr<char[]> buf;
+
+        /** Number of bytes of entries in the buffer. */
+        size_t buf_len = 0;
+
+        /** Offset, within the buffer, of the next entry. */
+        size_t buf_pos = 0;
+
+        /**
+         * Reads the next batch of entries into the buffer.
+         *
+         * @return True if entries were read, false if there are no
+         *   more entries.
+         */
+        bool read_entries();
+#else
         /** Directory handle. */
         DIR *dp = nullptr;
+#endif
+
+        /** Name of the last entry read. */
+        const char *last_name;
+
+        /** Type of the last entry read. */
+        uint8_t last_type;
 
-        /** Last entry read. */
-        struct dirent *last_ent;
+        /**
+         * Reads the next entry, storing its name and type in
+         * last_name and last_type.
+         *
+         * @return True if an entry was read, false if there are no
+         *   more entries. If an error occurs, an 'error' exception is
+         *   thrown with the value of 'errno'.
+         */
+        bool next_ent();
 
         /**
-         * Returns the next entry or nullptr if there are no more
-         * entries. If an error occurs, an 'error' exception is thrown
-         * with the value of 'errno'.
+         * Returns the file descriptor of the directory.
          */
-        struct dirent *next_ent();
+        int dir_fd() const;
     };
 }
 
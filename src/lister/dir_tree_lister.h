@@ -56,6 +56,10 @@ namespace nuc {
 
         virtual instream * open_entry();
 
+        virtual bool concurrent_open() const {
+            return true;
+        }
+
     private:
         /**
          * FTS directory tree handle.
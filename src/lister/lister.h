@@ -74,6 +74,90 @@ namespace nuc {
          */
         virtual bool entry_stat(struct stat &st) = 0;
 
+        /**
+         * Returns true if the stat attributes of entries can be
+         * retrieved with stat_entry, concurrently from multiple
+         * threads, while the lister advances to the next entries.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if stat_entry is supported.
+         */
+        virtual bool concurrent_stat() const {
+            return false;
+        }
+
+        /**
+         * Retrieves the stat attributes of an entry previously read
+         * by read_entry. Only supported if concurrent_stat returns
+         * true, in which case it may be called from any thread.
+         *
+         * The default implementation returns false.
+         *
+         * @param ent The entry, the name of which should be a copy of
+         *   the name returned by read_entry.
+         *
+         * @param st The stat struct into which the attributes are
+         *   stored.
+         *
+         * @return True if the stat attributes were retrieved, false
+         *   otherwise.
+         */
+        virtual bool stat_entry(const entry &ent, struct stat &st) {
+            return false;
+        }
+
+        /**
+         * Returns true if retrieving the stat attributes of entries
+         * is slow, such as on network file systems, in which case
+         * they should be retrieved with stat_entry on multiple
+         * threads. Only meaningful if concurrent_stat returns true.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if the stat attributes should be retrieved
+         *   on multiple threads.
+         */
+        virtual bool slow_stat() const {
+            return false;
+        }
+
+        /**
+         * Returns true if the lister can be positioned directly at an
+         * entry, with seek_entry, without the preceding entries
+         * being read by the caller.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if seek_entry is supported.
+         */
+        virtual bool can_seek() const {
+            return false;
+        }
+
+        /**
+         * Positions the lister at the entry with subpath @a path, as
+         * if it were the last entry read by read_entry. Only
+         * supported if can_seek returns true, and only before any
+         * entry has been read.
+         *
+         * After this method is called, read_entry continues with the
+         * entries following the entry. If there are multiple entries
+         * with the same path, the lister is positioned at the first
+         * one.
+         *
+         * @param path Canonicalized subpath of the entry.
+         *
+         * @param ent The entry object into which the entry is read.
+         *   Its name refers to the string of @a path.
+         *
+         * @return True if the entry was found, false if there is no
+         *   such entry.
+         */
+        virtual bool seek_entry(const pathname &path, entry &ent) {
+            return false;
+        }
+
         /**
          * Opens the last entry read for reading.
          *
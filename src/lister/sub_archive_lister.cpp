@@ -39,6 +39,19 @@ sub_archive_lister::~sub_archive_lister() {
 void sub_archive_lister::find_archive_file(const pathname &subpath) {
     lister::entry ent;
 
+    // If the first entry with the path is not a regular file, the
+    // entries following it are searched sequentially.
+
+    if (parent_lister->can_seek()) {
+        if (!parent_lister->seek_entry(subpath, ent))
+            throw file_error(ENOENT, error::type_general, false, subpath);
+
+        if (ent.type == DT_REG) {
+            arch_stream = parent_lister->open_entry();
+            return;
+        }
+    }
+
     while (parent_lister->read_entry(ent)) {
         if (ent.type == DT_REG && subpath == pathname(ent.name).canonicalize()) {
             arch_stream = parent_lister->open_entry();
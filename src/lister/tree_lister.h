@@ -132,6 +132,20 @@ namespace nuc {
          */
         virtual instream * open_entry() = 0;
 
+        /**
+         * Returns true if the streams returned by open_entry remain
+         * valid after the lister advances to the next entry, and may
+         * be read on a thread other than the one calling
+         * list_entries.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if entries can be read concurrently.
+         */
+        virtual bool concurrent_open() const {
+            return false;
+        }
+
     protected:
         /**
          * Function which is called when each entry is visited.
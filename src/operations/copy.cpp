@@ -22,12 +22,22 @@
 #include <memory>
 #include <unordered_set>
 
+#include <sys/stat.h>
+#include <errno.h>
+
+#include "copy_pipeline.h"
+
 #include "errors/restarts.h"
+#include "settings/app_settings.h"
+#include "tasks/worker_pool.h"
 
 #include "lister/tree_lister.h"
 #include "stream/dir_writer.h"
 
+#include "stream/file_instream.h"
 #include "stream/file_outstream.h"
+#include "stream/fsutil.h"
+#include "stream/page_cache.h"
 
 using namespace nuc;
 
@@ -68,11 +78,100 @@ static pathname::string replace_initial_dir(size_t comp_len, const pathname::str
  * Copies the data from the input stream @a in, to the output stream
  * @a out. Closes both streams.
  *
+ * Files of at least pipeline_min_size bytes are copied with
+ * pipelined_copy, which reads and writes the data concurrently.
+ *
+ * @param state Cancellation state.
+ * @param in    Input stream to read data from.
+ * @param out   Output stream to write data to.
+ *
+ * @param file_size Size of the file, in bytes, if known, 0 otherwise.
+ */
+static void copy_file(cancel_state &state, instream &in, outstream &out, size_t file_size);
+
+/**
+ * Attempts to copy the data from the input stream @a in to the
+ * output stream @a out, within the kernel, if both are regular file
+ * streams.
+ *
+ * A reflink clone is attempted first, followed by copy_file_range
+ * and sendfile, which copy the file in chunks of kernel_copy_chunk
+ * bytes so that progress can be reported and the operation
+ * cancelled. Sparse files are only cloned, as the other mechanisms
+ * do not preserve holes.
+ *
+ * If the copy could not be completed in the kernel, the positions
+ * of both streams are left at the end of the data copied so far, and
+ * the remainder should be copied by reading and writing blocks.
+ *
  * @param state Cancellation state.
  * @param in    Input stream to read data from.
  * @param out   Output stream to write data to.
+ *
+ * @return True if the entire file was copied, false otherwise.
+ */
+static bool kernel_copy_file(cancel_state &state, instream &in, outstream &out);
+
+/**
+ * Allocates the space for the file being written to @a out, if
+ * enabled in the settings and @a out is a regular file stream. The
+ * stream is informed of the file's size in any case.
+ *
+ * The space for sparse source files is not allocated, so that holes
+ * remain holes.
+ *
+ * @param in  Input stream from which the data is read.
+ * @param out Output stream to which the data is written.
+ *
+ * @param file_size Size of the file, 0 if unknown.
+ */
+static void allocate_dest(instream &in, outstream &out, size_t file_size);
+
+/**
+ * Number of bytes copied by the kernel between successive progress
+ * events and cancellation points.
+ */
+static constexpr size_t kernel_copy_chunk = 8388608;
+
+/**
+ * Minimum size of a file, for its data to be read and written
+ * concurrently. For smaller files, the cost of starting the writer
+ * outweighs the gain.
  */
-static void copy_file(cancel_state &state, instream &in, outstream &out);
+static constexpr size_t pipeline_min_size = 4194304;
+
+/**
+ * Copies a regular file, which was read from the tree lister @a in,
+ * on a worker thread of the pool @a pool.
+ *
+ * The source file is opened on the calling thread, while the
+ * destination file is created, and the data copied, on the worker
+ * thread. The progress events for the file are emitted, on the
+ * calling thread, once the copy completes. Errors are handled with a
+ * "skip" restart which skips only this file.
+ *
+ * @param state Cancellation state.
+ * @param pool  The worker pool.
+ * @param in    Source directory tree lister.
+ * @param out   Destination directory writer.
+ *
+ * @param name Name of the source file.
+ * @param dest_name Name of the destination file.
+ * @param st Stat attributes of the source file.
+ */
+static void copy_concurrent(cancel_state &state, worker_pool &pool, tree_lister &in, dir_writer &out, const pathname &name, const pathname &dest_name, const struct stat &st);
+
+/**
+ * Maximum size of a file for it to be copied on a worker thread,
+ * concurrently with other files. Larger files are copied on the
+ * task thread, where progress is reported as the data is copied.
+ */
+static constexpr size_t concurrent_max_size = 1048576;
+
+/**
+ * Number of files which are copied concurrently.
+ */
+static constexpr size_t copy_workers = 8;
 
 /**
  * Copies the files read from the tree lister @a lst, to temporary
@@ -155,6 +254,13 @@ void nuc::copy(cancel_state &state, nuc::tree_lister &in, nuc::dir_writer &out,
     // Set of all directories created during the copy operation.
     std::unordered_set<file_id> created_dirs;
 
+    // Small files are copied concurrently, if the source streams and
+    // destination files are independent of each other.
+    std::unique_ptr<worker_pool> pool;
+
+    if (in.concurrent_open() && out.concurrent_create())
+        pool.reset(new worker_pool(copy_workers));
+
     in.list_entries([&] (const lister::entry &ent, const struct stat *st, tree_lister::visit_info info) {
         // Flag for whether the directory's contents should be copied
         // if the directory itself could not be copied.
@@ -189,18 +295,27 @@ void nuc::copy(cancel_state &state, nuc::tree_lister &in, nuc::dir_writer &out,
                     }
                 }
                 else if (info == nuc::tree_lister::visit_postorder) {
+                    // Files created in the directory change its
+                    // modification time.
+                    if (pool) pool->wait();
+
                     state.call_progress(progress_event(progress_event::type_exit_dir, ent.name));
                     out.set_attributes(ent_name, st);
                 }
                 break;
 
             case DT_REG:{
+                if (pool && st && (size_t)st->st_size < concurrent_max_size) {
+                    copy_concurrent(state, *pool, in, out, ent.name, ent_name, *st);
+                    break;
+                }
+
                 state.call_progress(progress_event(progress_event::type_enter_file, ent.name, st ? st->st_size : 0));
 
                 std::unique_ptr<instream> src(in.open_entry());
                 std::unique_ptr<outstream> dest(out.create(ent_name, st));
 
-                copy_file(state, *src, *dest);
+                copy_file(state, *src, *dest, st ? st->st_size : 0);
                 dest->close();
 
                 state.call_progress(progress_event(progress_event::type_exit_file, ent.name));
@@ -223,22 +338,162 @@ void nuc::copy(cancel_state &state, nuc::tree_lister &in, nuc::dir_writer &out,
         return true;
     });
 
+    if (pool) pool->wait();
+
     out.close();
 }
 
-static void copy_file(cancel_state &state, instream &in, outstream &out) {
+void copy_concurrent(cancel_state &state, worker_pool &pool, tree_lister &in, dir_writer &out, const pathname &name, const pathname &dest_name, const struct stat &st) {
+    std::shared_ptr<instream> src(in.open_entry());
+    std::shared_ptr<bool> skipped = std::make_shared<bool>(false);
+
+    pool.add([=, &state, &out] {
+        global_restart skip(skip_exception::restart);
+
+        try {
+            state.test_cancel();
+
+            // Progress is only reported on the task thread, thus the
+            // data is copied with a separate cancellation state.
+            // Cancellation takes effect once the file is copied.
+            cancel_state job_state;
+
+            std::unique_ptr<outstream> dest(out.create(dest_name, &st));
+
+            copy_file(job_state, *src, *dest, st.st_size);
+            dest->close();
+        }
+        catch (const skip_exception &) {
+            *skipped = true;
+        }
+    }, [=, &state] {
+        state.call_progress(progress_event(progress_event::type_enter_file, name, st.st_size));
+
+        if (!*skipped)
+            state.call_progress(progress_event(progress_event::type_process_data, st.st_size));
+
+        state.call_progress(progress_event(progress_event::type_exit_file, name));
+    });
+}
+
+static void copy_file(cancel_state &state, instream &in, outstream &out, size_t file_size) {
     size_t size;
     off_t offset;
 
+    if (kernel_copy_file(state, in, out))
+        return;
+
+    allocate_dest(in, out, file_size);
+
+    if (file_size >= pipeline_min_size) {
+        pipelined_copy(state, in, out);
+        return;
+    }
+
     while (const instream::byte *block = in.read_block(size, offset)) {
         state.test_cancel();
 
         out.write(block, size, offset);
 
-        state.call_progress(progress_event(progress_event::type_process_data, size));
+        // Holes are counted as processed data, so that the total
+        // matches the file size.
+        state.call_progress(progress_event(progress_event::type_process_data, size + offset));
+    }
+}
+
+static bool kernel_copy_file(cancel_state &state, instream &in, outstream &out) {
+    file_instream *src = dynamic_cast<file_instream *>(&in);
+    file_outstream *dest = dynamic_cast<file_outstream *>(&out);
+
+    if (!src || !dest) return false;
+
+    int in_fd = src->get_fd();
+    int out_fd = dest->get_fd();
+
+    // Files which report a size of zero, such as those in procfs,
+    // may still have data which copy_file_range does not copy.
+
+    struct stat st;
+
+    if (fstat(in_fd, &st) || !S_ISREG(st.st_mode) || !st.st_size)
+        return false;
+
+    state.test_cancel();
+
+    if (!fs::clone_file(in_fd, out_fd)) {
+        state.call_progress(progress_event(progress_event::type_process_data, st.st_size));
+        return true;
+    }
+
+    // sendfile fills holes with zeroes, thus sparse files are left to
+    // the block copy loop which preserves the holes.
+
+    if ((off_t)st.st_blocks * 512 < st.st_size)
+        return false;
+
+    allocate_dest(in, out, st.st_size);
+
+    // The data copied by the kernel passes through the page cache as
+    // well, thus large files are streamed.
+
+    std::unique_ptr<cache_dropper> in_cache, out_cache;
+
+    if (use_streaming(st.st_size)) {
+        in_cache.reset(new cache_dropper(in_fd, false, lseek(in_fd, 0, SEEK_CUR)));
+        out_cache.reset(new cache_dropper(out_fd, true, lseek(out_fd, 0, SEEK_CUR)));
+    }
+
+    fs::copy_method method = fs::copy_method_range;
+
+    while (true) {
+        state.test_cancel();
+
+        ssize_t n = fs::copy_range(in_fd, out_fd, kernel_copy_chunk, method);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0) {
+            if (in_cache) {
+                in_cache->finish();
+                out_cache->finish();
+            }
+
+            // On failure, leave the remaining data, and the reporting
+            // of the error, to the block copy loop.
+            return !n;
+        }
+
+        if (in_cache) {
+            in_cache->advance(n);
+            out_cache->advance(n);
+        }
+
+        state.call_progress(progress_event(progress_event::type_process_data, n));
     }
 }
 
+void allocate_dest(instream &in, outstream &out, size_t file_size) {
+    file_outstream *dest = dynamic_cast<file_outstream *>(&out);
+
+    if (!dest || !file_size)
+        return;
+
+    dest->expect_size(file_size);
+
+    if (!app_settings::instance().preallocate_files())
+        return;
+
+    if (file_instream *src = dynamic_cast<file_instream *>(&in)) {
+        struct stat st;
+
+        if (fstat(src->get_fd(), &st) || (off_t)st.st_blocks * 512 < st.st_size)
+            return;
+    }
+
+    dest->allocate(file_size);
+}
+
 
 /// Unpacking files from archives
 
@@ -260,7 +515,7 @@ void copy_to_temp(cancel_state &state, tree_lister &lst, const std::function<voi
             std::unique_ptr<instream> in(lst.open_entry());
             std::unique_ptr<outstream> out(new file_outstream(fd));
 
-            copy_file(state, *in, *out);
+            copy_file(state, *in, *out, st ? st->st_size : 0);
 
             state.no_cancel([&] {
                 callback(name);
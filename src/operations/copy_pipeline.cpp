@@ -0,0 +1,289 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "copy_pipeline.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "errors/error.h"
+#include "errors/error_forwarder.h"
+#include "tasks/async_task.h"
+
+using namespace nuc;
+
+
+/**
+ * Number of buffers in the ring.
+ */
+static constexpr size_t pipeline_depth = 4;
+
+
+/**
+ * Pipeline state shared between the reader (the thread which called
+ * pipelined_copy) and the writer thread.
+ */
+struct copy_pipeline {
+    /**
+     * Block of data read from the input stream.
+     */
+    struct block {
+        /** Block data. */
+        std::vector<instream::byte> data;
+
+        /** Number of bytes in the block. */
+        size_t size = 0;
+
+        /** Size of the gap preceding the block. */
+        off_t offset = 0;
+    };
+
+    /**
+     * Protects all the following members.
+     */
+    std::mutex mutex;
+
+    /**
+     * Signalled whenever the state of the pipeline changes.
+     */
+    std::condition_variable changed;
+
+    /**
+     * The ring of buffers.
+     */
+    std::vector<block> blocks = std::vector<block>(pipeline_depth);
+
+    /**
+     * Total number of blocks read and written.
+     */
+    size_t n_read = 0;
+    size_t n_written = 0;
+
+    /**
+     * Flag: true once the reader has read the last block.
+     */
+    bool eof = false;
+
+    /**
+     * Flag: true if the reader aborted the copy.
+     */
+    bool stop = false;
+
+    /**
+     * Flag: true once the writer thread has finished.
+     */
+    bool done = false;
+
+    /**
+     * Exception with which the writer thread was terminated.
+     */
+    std::exception_ptr write_error;
+
+    /**
+     * Forwards errors raised on the writer thread to the reader.
+     */
+    error_forwarder errors{mutex, changed};
+
+
+    /**
+     * Writer thread function. Writes the blocks to the output stream
+     * @a out, until the last block is written or the reader aborts
+     * the copy.
+     *
+     * Errors are forwarded to the reader, with the restarts @a
+     * reader_restarts, which were established on the reader thread.
+     *
+     * @param out The output stream.
+     * @param reader_restarts The reader thread's restarts.
+     */
+    void write(outstream &out, restart_map reader_restarts);
+
+    /**
+     * Waits, on the reader thread, until @a pred returns true, the
+     * writer finishes or an error is forwarded. Forwarded errors are
+     * handled and progress events are emitted for the blocks written
+     * in the meantime.
+     *
+     * @param state Cancellation state.
+     * @param lock  The lock on the mutex.
+     * @param pred  The predicate.
+     */
+    template <typename F>
+    void wait(cancel_state &state, std::unique_lock<std::mutex> &lock, F pred);
+
+    /**
+     * Emits progress events for the blocks which were written since
+     * the last call. Should only be called by the reader with the
+     * lock held.
+     *
+     * @param state Cancellation state.
+     */
+    void report_progress(cancel_state &state);
+
+    /**
+     * Number of blocks for which progress events were emitted.
+     */
+    size_t n_reported = 0;
+};
+
+
+//// Reader
+
+void nuc::pipelined_copy(cancel_state &state, instream &in, outstream &out) {
+    auto pipe = std::make_shared<copy_pipeline>();
+
+    restart_map rs = restarts();
+
+    dispatch_async([pipe, &out, rs] {
+        pipe->write(out, rs);
+    });
+
+    std::unique_lock<std::mutex> lock(pipe->mutex);
+
+    try {
+        while (true) {
+            pipe->wait(state, lock, [&] {
+                return pipe->n_read - pipe->n_written < pipeline_depth;
+            });
+
+            if (pipe->done) break;
+
+            copy_pipeline::block &blk = pipe->blocks[pipe->n_read % pipeline_depth];
+
+            lock.unlock();
+
+            state.test_cancel();
+
+            size_t size;
+            off_t offset;
+
+            const instream::byte *data = in.read_block(size, offset);
+
+            if (data) {
+                if (blk.data.size() < size)
+                    blk.data.resize(size);
+
+                memcpy(blk.data.data(), data, size);
+
+                blk.size = size;
+                blk.offset = offset;
+            }
+
+            lock.lock();
+
+            if (!data) {
+                pipe->eof = true;
+                pipe->changed.notify_all();
+                break;
+            }
+
+            pipe->n_read++;
+            pipe->changed.notify_all();
+        }
+
+        pipe->wait(state, lock, [&] {
+            return false;
+        });
+    }
+    catch (...) {
+        // Stop the writer and wait for it to finish before the output
+        // stream is destroyed by the caller.
+
+        if (!lock.owns_lock())
+            lock.lock();
+
+        pipe->stop = true;
+        pipe->errors.abort();
+
+        pipe->changed.notify_all();
+        pipe->changed.wait(lock, [&] { return pipe->done; });
+
+        throw;
+    }
+
+    if (pipe->write_error)
+        std::rethrow_exception(pipe->write_error);
+}
+
+template <typename F>
+void copy_pipeline::wait(cancel_state &state, std::unique_lock<std::mutex> &lock, F pred) {
+    while (true) {
+        while (errors.pending())
+            errors.handle(lock);
+
+        report_progress(state);
+
+        if (done || pred()) return;
+
+        changed.wait(lock);
+    }
+}
+
+void copy_pipeline::report_progress(cancel_state &state) {
+    for (; n_reported < n_written; ++n_reported) {
+        const block &blk = blocks[n_reported % pipeline_depth];
+
+        state.call_progress(progress_event(progress_event::type_process_data, blk.size + blk.offset));
+    }
+}
+
+
+//// Writer
+
+void copy_pipeline::write(outstream &out, restart_map reader_restarts) {
+    inherited_restarts rs(std::move(reader_restarts));
+    error_handler handler(errors.handler());
+
+    try {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            changed.wait(lock, [this] {
+                return stop || eof || n_written < n_read;
+            });
+
+            if (stop || n_written == n_read) break;
+
+            const block &blk = blocks[n_written % pipeline_depth];
+
+            lock.unlock();
+            out.write(blk.data.data(), blk.size, blk.offset);
+            lock.lock();
+
+            n_written++;
+            changed.notify_all();
+        }
+    }
+    catch (const error_forwarder::aborted &) {
+        // The reader stopped the copy
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        write_error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    done = true;
+    changed.notify_all();
+}
@@ -0,0 +1,54 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_OPERATIONS_COPY_PIPELINE_H
+#define NUC_OPERATIONS_COPY_PIPELINE_H
+
+#include "tasks/cancel_state.h"
+
+#include "stream/instream.h"
+#include "stream/outstream.h"
+
+namespace nuc {
+    /**
+     * Copies the data from the input stream @a in to the output
+     * stream @a out, with the data being read and written
+     * concurrently.
+     *
+     * The blocks are read, on the calling thread, into a ring of
+     * buffers from which they are written to @a out on a background
+     * thread. Once a block is written, a type_process_data progress
+     * event is emitted on the calling thread.
+     *
+     * Errors which occur while writing are handled by the error
+     * handler of the calling thread, with the restarts established
+     * on the calling thread.
+     *
+     * @param state Cancellation state.
+     * @param in    Input stream to read data from.
+     * @param out   Output stream to write data to.
+     */
+    void pipelined_copy(cancel_state &state, instream &in, outstream &out);
+}
+
+#endif // NUC_OPERATIONS_COPY_PIPELINE_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -21,16 +21,21 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include <archive.h>
 #include <archive_entry.h>
 
 #include "plugins/archive_plugin_api.h"
 
+#include "zip.h"
+
 #define EXPORT __attribute__((visibility("default")))
 
 /**
@@ -38,6 +43,219 @@
  */
 #define HOLE_BUF_SIZE 131072
 
+/**
+ * Minimum and maximum block sizes used when reading archive files.
+ */
+#define MIN_READ_BLOCK_SIZE 65536
+#define MAX_READ_BLOCK_SIZE 4194304
+
+/**
+ * Number, and size, of the blocks of decompressed data which are
+ * buffered by the read-ahead thread.
+ */
+#define READ_AHEAD_BLOCKS 4
+#define READ_AHEAD_BLOCK_SIZE 1048576
+
+/**
+ * Maximum size of the data, following the end-of-archive marker
+ * inclusive, of an archive which is appended to. This data is kept in
+ * memory in order to restore the archive if appending fails.
+ */
+#define MAX_APPEND_TAIL_SIZE 1048576
+
+/**
+ * Number of central directory entries, following the last entry
+ * matched, which are searched for the entry read by libarchive, when
+ * reading a zip archive which was positioned at an entry.
+ */
+#define ZIP_MATCH_WINDOW 64
+
+/**
+ * Size of the buffer in which the data written to a zip archive file,
+ * by a zip writer, is buffered.
+ */
+#define ZIP_WRITE_BUF_SIZE 262144
+
+/**
+ * Decompression read-ahead state.
+ *
+ * The archive file is decompressed, on a separate thread, into a ring
+ * of blocks, from which the archive's entries are parsed.
+ */
+typedef struct read_ahead {
+    /**
+     * Libarchive handle, reading the decompressed archive data with
+     * the raw format.
+     */
+    struct archive *ar;
+
+    /**
+     * Read-ahead thread, and the mutex and condition variable
+     * guarding the remaining fields.
+     */
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    /**
+     * Ring of decompressed data blocks and the number of bytes in
+     * each block.
+     */
+    char *blocks[READ_AHEAD_BLOCKS];
+    size_t sizes[READ_AHEAD_BLOCKS];
+
+    /**
+     * Index of the first filled block, and the number of filled
+     * blocks.
+     */
+    size_t head;
+    size_t count;
+    /**
+     * True if the block at head was returned to libarchive, in which
+     * case it is not reused until the next read.
+     */
+    int held;
+
+    /**
+     * True if the end of the data was reached, or an error occurred.
+     */
+    int eof;
+    /**
+     * Error code and description of the error which occurred while
+     * decompressing, 0 and NULL if no error occurred.
+     */
+    int error;
+    char *error_string;
+
+    /**
+     * True if the read-ahead thread should stop.
+     */
+    int stop;
+} read_ahead;
+
+/**
+ * State of a zip archive which is accessed using its central
+ * directory.
+ *
+ * If the archive was positioned at an entry, the entries, beginning
+ * at the entry's local header, are read by a libarchive handle
+ * supporting only the streamable zip format, from blocks read
+ * directly from the archive file.
+ */
+typedef struct zip_reader {
+    /**
+     * File descriptor of the archive file, and the offset at which
+     * the next block is read.
+     */
+    int fd;
+    off_t offset;
+
+    /**
+     * Block buffer and its size.
+     */
+    char *block;
+    size_t block_size;
+
+    /**
+     * Central directory of the archive.
+     */
+    zip_cd *cd;
+    /**
+     * Index of the central directory entry following the entry last
+     * read.
+     */
+    size_t next;
+    /**
+     * Central directory entry of the entry last read, NULL if it was
+     * not matched to a central directory entry.
+     */
+    const zip_entry *current;
+
+    /**
+     * True if the entries are read from the blocks read by the zip
+     * reader, false if the zip reader is only used to access the
+     * central directory and raw entry data.
+     */
+    int streaming;
+} zip_reader;
+
+/**
+ * Offset within the archive file, of the data written by libarchive
+ * following an entry copied by a zip writer.
+ */
+typedef struct zip_shift {
+    /**
+     * Number of bytes written by libarchive preceding the data.
+     */
+    uint64_t ar_offset;
+    /**
+     * Offset of the data within the archive file.
+     */
+    uint64_t offset;
+} zip_shift;
+
+/**
+ * State of a zip archive file which is written by libarchive, and
+ * into which entries are copied directly from another zip archive,
+ * without decompressing and recompressing their data.
+ *
+ * The data written by libarchive is interleaved with the copied
+ * entries, thus when the archive is closed, the offsets of the local
+ * headers in the central directory, written by libarchive, are
+ * adjusted and the records of the copied entries are added to it.
+ */
+typedef struct zip_writer {
+    /**
+     * File descriptor of the archive file.
+     */
+    int fd;
+
+    /**
+     * Buffer of data which has not been written to the file yet, and
+     * the number of bytes in it.
+     */
+    unsigned char *buf;
+    size_t buf_size;
+
+    /**
+     * Number of bytes written to the archive file, including the
+     * buffered bytes.
+     */
+    uint64_t offset;
+    /**
+     * Number of bytes written by libarchive.
+     */
+    uint64_t ar_offset;
+
+    /**
+     * Offsets of the data written by libarchive following copied
+     * entries, sorted by ar_offset.
+     */
+    zip_shift *shifts;
+    size_t num_shifts;
+    size_t max_shifts;
+
+    /**
+     * True if an entry was copied since libarchive last wrote data.
+     */
+    int shifted;
+
+    /**
+     * Central directory records of the copied entries, and their
+     * number.
+     */
+    zip_buf cd;
+    uint64_t count;
+
+    /**
+     * True if the archive is being closed, in which case the data
+     * written by libarchive, which is its central directory, is
+     * stored in tail rather than written to the file.
+     */
+    int closing;
+    zip_buf tail;
+} zip_writer;
+
 /**
  * Archive Handle.
  */
@@ -99,6 +317,60 @@ typedef struct nuc_arch_handle {
      * Context pointer argument for read, skip and write callbacks.
      */
     void *callback_ctx;
+
+    /**
+     * File descriptor of the archive file, if it was opened for
+     * appending, -1 otherwise.
+     */
+    int append_fd;
+    /**
+     * Offset of the end-of-archive marker, and size, of the archive
+     * file opened for appending, and the original contents of the
+     * file from the marker to its end. Used to restore the archive
+     * if appending fails.
+     */
+    off_t append_end;
+    off_t append_size;
+    char *append_tail;
+
+    /**
+     * Decompression read-ahead state, if the archive file is
+     * compressed and was opened with nuc_arch_open, NULL otherwise.
+     */
+    read_ahead *read_ahead;
+
+    /**
+     * Number of threads with which to compress the archive's data, 0
+     * if the filters' default should be used.
+     */
+    int threads;
+
+    /**
+     * Path to the archive file, if it was opened with nuc_arch_open
+     * for unpacking, NULL otherwise.
+     */
+    char *src_file;
+    /**
+     * True if at least one entry has been read.
+     */
+    int entry_read;
+    /**
+     * Zip reader state, if the archive was positioned at an entry with
+     * nuc_arch_seek_entry, or an entry was copied from it with
+     * nuc_arch_copy_last_entry_raw, NULL otherwise.
+     */
+    zip_reader *zip;
+    /**
+     * True if the zip reader could not be opened as the archive is
+     * not a supported zip archive.
+     */
+    int zip_unsupported;
+
+    /**
+     * Zip writer state, if the archive is a zip archive written to a
+     * file, NULL otherwise.
+     */
+    zip_writer *zip_out;
 } nuc_arch_handle;
 
 
@@ -132,6 +404,35 @@ static int open_unpack(const char *file, nuc_arch_handle *handle);
  *    if an error occurred.
  */
 static int open_pack(const char *file, nuc_arch_handle *handle);
+/**
+ * Open an existing archive for appending entries in place.
+ *
+ * Only uncompressed tar archives are supported. The end-of-archive
+ * marker is located by reading the entry headers, without reading
+ * the entry data, and new entries are written from its offset.
+ *
+ * @param file Path to the archive file to open.
+ * @param handle Pointer to the handle to initialize.
+ *
+ * @return Zero (NUC_AP_OK) if successful, a non-zero error constant
+ *    if an error occurred. If the archive cannot be appended to,
+ *    NUC_AP_FAILED is returned and errno is set to ENOTSUP.
+ */
+static int open_append(const char *file, nuc_arch_handle *handle);
+
+/**
+ * Determines the block size to use when reading an archive file.
+ *
+ * The block size is the preferred I/O block size of the file, which
+ * is large on network file systems, doubled until it is at least
+ * MIN_READ_BLOCK_SIZE or large enough to read the entire file in a
+ * single block. The block size is capped at MAX_READ_BLOCK_SIZE.
+ *
+ * @param file Path to the archive file.
+ *
+ * @return The block size in bytes.
+ */
+static size_t read_block_size(const char *file);
 
 /**
  * Close archive opened for unpacking.
@@ -152,6 +453,17 @@ static int close_unpack(nuc_arch_handle *);
  */
 static int close_pack(nuc_arch_handle *);
 
+/**
+ * Restores an archive opened for appending to its original state, by
+ * truncating it to its original size and rewriting the original data
+ * following the end-of-archive marker.
+ *
+ * @param handle The archive handle.
+ *
+ * @return NUC_AP_OK if successful, NUC_AP_FAILED otherwise.
+ */
+static int restore_append(nuc_arch_handle *handle);
+
 /**
  * Open callback function.
  *
@@ -237,70 +549,394 @@ static nuc_arch_prog_act call_callback(nuc_arch_handle *handle, nuc_arch_prog_ty
  */
 static int err_code(const nuc_arch_handle *handle, int err);
 
-
-//// Opening Archives
-
-static nuc_arch_handle *alloc_handle() {
-    return calloc(1, sizeof(nuc_arch_handle));
-}
+/**
+ * Canonicalizes an entry path, in the same way as
+ * pathname::canonicalize: empty and "." components are removed, ".."
+ * components remove the preceding component and trailing slashes are
+ * removed.
+ *
+ * @param name The entry path, which is not NULL-terminated.
+ * @param len Length of the entry path.
+ * @param buf Buffer, of at least @a len + 1 bytes, into which the
+ *   canonical path is written.
+ *
+ * @return Length of the canonical path.
+ */
+static size_t canonicalize_path(const char *name, size_t len, char *buf);
 
-EXPORT
-void *nuc_arch_open(const char *file, int mode, int *error) {
-    nuc_arch_handle *handle = alloc_handle();
+/**
+ * Opens a zip reader for an archive file, and reads its central
+ * directory.
+ *
+ * @param file Path to the archive file.
+ *
+ * @return The zip reader, or NULL if the file is not a zip archive,
+ *   in which case errno is set to ENOTSUP, or an error occurred.
+ */
+static zip_reader *open_zip_reader(const char *file);
 
-    if (!handle) {
-        *error = NUC_AP_FATAL;
-        return NULL;
-    }
+/**
+ * Closes the archive file of a zip reader and frees its state.
+ *
+ * @param zip The zip reader.
+ */
+static void close_zip_reader(zip_reader *zip);
 
-    handle->mode = mode;
+/**
+ * Finds the central directory entry of an entry read by libarchive,
+ * and advances the reader past it.
+ *
+ * The entries are read in the order of their local headers, in which
+ * the central directory entries are sorted, thus the entry is
+ * searched for, first, among the ZIP_MATCH_WINDOW entries following
+ * the last entry matched.
+ *
+ * @param zip The zip reader.
+ * @param name Path of the entry read by libarchive.
+ *
+ * @return The central directory entry, or NULL if it was not found.
+ */
+static const zip_entry *match_zip_entry(zip_reader *zip, const char *name);
 
-    switch (mode) {
-    case NUC_AP_MODE_UNPACK:
-        *error = open_unpack(file, handle);
-        break;
+/**
+ * Finds the central directory entry, with the lowest local header
+ * offset, with a given path.
+ *
+ * @param cd The central directory.
+ * @param path Canonical path of the entry.
+ *
+ * @return Index of the entry, or cd->count if there is no such entry.
+ */
+static size_t find_zip_entry(const zip_cd *cd, const char *path);
 
-    case NUC_AP_MODE_PACK:
-        *error = open_pack(file, handle);
-    }
+/**
+ * Sets the attributes of the entry last read from a zip archive,
+ * which are only stored in the central directory, and thus are not
+ * known to the streamable zip reader. These are the file mode and,
+ * if it is stored in a data descriptor, the size.
+ *
+ * The data of symbolic link entries, which is the link target, is
+ * read.
+ *
+ * @param handle Handle to the archive.
+ *
+ * @return NUC_AP_OK if successful, a NUC_AP_ error constant
+ *   otherwise.
+ */
+static int set_zip_entry_attributes(nuc_arch_handle *handle);
 
-    if (*error) {
-        free(handle);
-        return NULL;
-    }
+/**
+ * Read callback function of a zip reader, which reads the next block
+ * from the archive file.
+ *
+ * @param ar Archive handle.
+ * @param ctx The zip reader.
+ *
+ * @param buffer Pointer to pointer which is set to point to the block
+ *   of data.
+ *
+ * @return The number of bytes in the block, 0 on EOF or -1 on error.
+ */
+static ssize_t zip_read_callback(struct archive *ar, void *ctx, const void **buffer);
 
-    return handle;
-}
+/**
+ * Skip callback function of a zip reader.
+ *
+ * @param ar Archive handle.
+ * @param ctx The zip reader.
+ * @param request Number of bytes to skip.
+ *
+ * @return Number of bytes skipped.
+ */
+static int64_t zip_skip_callback(struct archive *ar, void *ctx, int64_t request);
 
-int open_unpack(const char *file, nuc_arch_handle *handle) {
-    int err;
+/**
+ * Opens a zip reader, used to copy entries, for an archive opened for
+ * unpacking, after entries have been read from it, and finds the
+ * central directory entry of the last entry read.
+ *
+ * @param handle Handle to the archive.
+ *
+ * @return NUC_AP_OK if successful, NUC_AP_FAILED otherwise. If the
+ *   archive is not a supported zip archive, or the entry is not
+ *   found, errno is set to ENOTSUP.
+ */
+static int open_copy_zip_reader(nuc_arch_handle *handle);
 
-    if (!(handle->ar = archive_read_new())) {
-        return NUC_AP_FATAL;
-    }
+/**
+ * Opens the archive file of a zip archive, opened for packing, for
+ * writing with a zip writer, and opens the libarchive handle with the
+ * zip writer's write callback.
+ *
+ * @param handle Handle to the archive.
+ *
+ * @return NUC_AP_OK if successful, a NUC_AP_ error constant
+ *   otherwise.
+ */
+static int open_zip_writer(nuc_arch_handle *handle);
 
-    if ((err = archive_read_support_filter_all(handle->ar)) != ARCHIVE_OK) {
-        goto cleanup;
-    }
+/**
+ * Writes the central directory, if the archive was written
+ * successfully, and closes the archive file of a zip writer.
+ *
+ * Should be called after the libarchive handle is closed.
+ *
+ * @param zip The zip writer, which is freed.
+ * @param write_cd True if the central directory should be written.
+ *
+ * @return NUC_AP_OK if successful, NUC_AP_FAILED otherwise.
+ */
+static int close_zip_writer(zip_writer *zip, int write_cd);
 
-    if ((err = archive_read_support_format_all(handle->ar)) != ARCHIVE_OK) {
-        goto cleanup;
-    }
+/**
+ * Write callback function of a zip writer.
+ *
+ * @param ar Archive handle.
+ * @param ctx The zip writer.
+ * @param buffer The data to write.
+ * @param length Size of the data.
+ *
+ * @return The number of bytes written or -1 on error.
+ */
+static ssize_t zip_write_callback(struct archive *ar, void *ctx, const void *buffer, size_t length);
 
-    if ((err = archive_read_open_filename(handle->ar, file, 10240)) != ARCHIVE_OK) {
-        goto cleanup;
-    }
+/**
+ * Writes data to the archive file of a zip writer, through its
+ * buffer.
+ *
+ * @param zip The zip writer.
+ * @param data The data.
+ * @param size Size of the data.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+static int zip_write(zip_writer *zip, const void *data, size_t size);
 
-    return NUC_AP_OK;
+/**
+ * Copies data from a file to the archive file of a zip writer,
+ * through its buffer.
+ *
+ * @param zip The zip writer.
+ * @param fd The file descriptor of the file.
+ * @param offset Offset, within the file, of the data.
+ * @param size Size of the data.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+static int zip_copy_data(zip_writer *zip, int fd, uint64_t offset, uint64_t size);
 
-cleanup:
-    err = err_code(handle, err);
-    archive_read_free(handle->ar);
+/**
+ * Writes the buffered data of a zip writer to its archive file.
+ *
+ * @param zip The zip writer.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+static int zip_flush(zip_writer *zip);
 
-    return err;
-}
+/**
+ * Returns the offset, within the archive file of a zip writer, of
+ * data written by libarchive.
+ *
+ * @param zip The zip writer.
+ * @param ar_offset Number of bytes written by libarchive preceding
+ *   the data.
+ *
+ * @return The offset.
+ */
+static uint64_t zip_file_offset(const zip_writer *zip, uint64_t ar_offset);
 
-int open_pack(const char *file, nuc_arch_handle *handle) {
+/**
+ * Writes data to a file, retrying until all of it is written.
+ *
+ * @param fd The file descriptor.
+ * @param data The data.
+ * @param size Size of the data.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+static int write_all(int fd, const void *data, size_t size);
+
+/**
+ * Adds a compression filter to an archive open for packing. If the
+ * archive should be compressed with multiple threads, and the filter
+ * is gzip, the parallel pigz program is used instead, if it is
+ * installed.
+ *
+ * @param handle Handle to the archive.
+ * @param code The libarchive filter code.
+ *
+ * @return NUC_AP_OK if the filter was added successfully, a NUC_AP_
+ *   error constant otherwise.
+ */
+static int add_filter(nuc_arch_handle *handle, int code);
+
+/**
+ * Sets the number of threads, used for compression, of each of the
+ * archive's filters which support multi-threaded compression.
+ *
+ * @param handle Handle to the archive.
+ *
+ * @return NUC_AP_OK if successful, a NUC_AP_ error constant
+ *   otherwise.
+ */
+static int set_filter_threads(nuc_arch_handle *handle);
+
+/**
+ * Checks whether an executable program is located in one of the
+ * directories in the PATH environment variable.
+ *
+ * @param name Name of the program.
+ *
+ * @return Non-zero if the program was found.
+ */
+static int program_in_path(const char *name);
+
+/**
+ * Opens a compressed archive file for decompression, on a separate
+ * thread, ahead of the data being parsed.
+ *
+ * @param file Path to the archive file.
+ *
+ * @return The read-ahead state, or NULL if the file is not
+ *   compressed or the read-ahead thread could not be started.
+ */
+static read_ahead *open_read_ahead(const char *file);
+
+/**
+ * Stops the read-ahead thread and frees the read-ahead state.
+ *
+ * @param ra The read-ahead state.
+ */
+static void close_read_ahead(read_ahead *ra);
+
+/**
+ * Read-ahead thread function, which decompresses the archive file
+ * into the free blocks of the ring.
+ *
+ * @param ctx The read-ahead state.
+ *
+ * @return NULL.
+ */
+static void *read_ahead_thread(void *ctx);
+
+/**
+ * Read callback function of an archive opened with read-ahead, which
+ * returns the next block of decompressed data.
+ *
+ * @param ar Archive handle.
+ * @param ctx The read-ahead state.
+ *
+ * @param buffer Pointer to pointer which is set to point to the block
+ *   of data.
+ *
+ * @return The number of bytes in the block, 0 on EOF or -1 on error.
+ */
+static ssize_t read_ahead_callback(struct archive *ar, void *ctx, const void **buffer);
+
+
+//// Opening Archives
+
+static nuc_arch_handle *alloc_handle() {
+    nuc_arch_handle *handle = calloc(1, sizeof(nuc_arch_handle));
+
+    if (handle) handle->append_fd = -1;
+
+    return handle;
+}
+
+EXPORT
+void *nuc_arch_open(const char *file, int mode, int *error) {
+    nuc_arch_handle *handle = alloc_handle();
+
+    if (!handle) {
+        *error = NUC_AP_FATAL;
+        return NULL;
+    }
+
+    handle->mode = mode;
+
+    switch (mode) {
+    case NUC_AP_MODE_UNPACK:
+        *error = open_unpack(file, handle);
+        break;
+
+    case NUC_AP_MODE_PACK:
+        *error = open_pack(file, handle);
+    }
+
+    if (*error) {
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+int open_unpack(const char *file, nuc_arch_handle *handle) {
+    int err;
+
+    if (!(handle->ar = archive_read_new())) {
+        return NUC_AP_FATAL;
+    }
+
+    if ((err = archive_read_support_filter_all(handle->ar)) != ARCHIVE_OK) {
+        goto cleanup;
+    }
+
+    if ((err = archive_read_support_format_all(handle->ar)) != ARCHIVE_OK) {
+        goto cleanup;
+    }
+
+    if ((handle->read_ahead = open_read_ahead(file))) {
+        err = archive_read_open(handle->ar, handle->read_ahead, NULL, read_ahead_callback, NULL);
+    }
+    else {
+        err = archive_read_open_filename(handle->ar, file, read_block_size(file));
+    }
+
+    if (err != ARCHIVE_OK) {
+        goto cleanup;
+    }
+
+    if (!(handle->src_file = strdup(file))) {
+        archive_read_free(handle->ar);
+
+        if (handle->read_ahead)
+            close_read_ahead(handle->read_ahead);
+
+        return NUC_AP_FATAL;
+    }
+
+    return NUC_AP_OK;
+
+cleanup:
+    err = err_code(handle, err);
+    archive_read_free(handle->ar);
+
+    if (handle->read_ahead) {
+        close_read_ahead(handle->read_ahead);
+    }
+
+    return err;
+}
+
+size_t read_block_size(const char *file) {
+    struct stat st;
+    size_t size;
+
+    if (stat(file, &st) || st.st_blksize <= 0)
+        return MIN_READ_BLOCK_SIZE;
+
+    size = st.st_blksize;
+
+    while (size < MIN_READ_BLOCK_SIZE && (off_t)size < st.st_size)
+        size *= 2;
+
+    return size < MAX_READ_BLOCK_SIZE ? size : MAX_READ_BLOCK_SIZE;
+}
+
+int open_pack(const char *file, nuc_arch_handle *handle) {
     if (!(handle->dest_file = strdup(file)))
         return NUC_AP_FATAL;
 
@@ -313,6 +949,342 @@ int open_pack(const char *file, nuc_arch_handle *handle) {
 }
 
 
+
+//// Decompression Read-Ahead
+
+read_ahead *open_read_ahead(const char *file) {
+    read_ahead *ra = calloc(1, sizeof(read_ahead));
+    struct archive_entry *ent;
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (!ra || ncpus < 2) goto free_mem;
+
+    if (!(ra->ar = archive_read_new())) goto free_mem;
+
+    if (archive_read_support_filter_all(ra->ar) != ARCHIVE_OK ||
+        archive_read_support_format_raw(ra->ar) != ARCHIVE_OK)
+        goto cleanup;
+
+    if (archive_read_open_filename(ra->ar, file, read_block_size(file)) != ARCHIVE_OK ||
+        archive_read_next_header(ra->ar, &ent) != ARCHIVE_OK)
+        goto cleanup;
+
+    // Uncompressed archives are read directly, in order to preserve
+    // the ability to skip over and seek to entries.
+
+    if (archive_filter_count(ra->ar) < 2)
+        goto cleanup;
+
+    for (int i = 0; i < READ_AHEAD_BLOCKS; i++) {
+        if (!(ra->blocks[i] = malloc(READ_AHEAD_BLOCK_SIZE)))
+            goto cleanup;
+    }
+
+    pthread_mutex_init(&ra->mutex, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+
+    if (pthread_create(&ra->thread, NULL, read_ahead_thread, ra)) {
+        pthread_cond_destroy(&ra->cond);
+        pthread_mutex_destroy(&ra->mutex);
+        goto cleanup;
+    }
+
+    return ra;
+
+cleanup:
+    archive_read_free(ra->ar);
+
+    for (int i = 0; i < READ_AHEAD_BLOCKS; i++)
+        free(ra->blocks[i]);
+
+free_mem:
+    free(ra);
+    return NULL;
+}
+
+void close_read_ahead(read_ahead *ra) {
+    pthread_mutex_lock(&ra->mutex);
+    ra->stop = 1;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+
+    pthread_join(ra->thread, NULL);
+
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->mutex);
+
+    archive_read_free(ra->ar);
+
+    for (int i = 0; i < READ_AHEAD_BLOCKS; i++)
+        free(ra->blocks[i]);
+
+    free(ra->error_string);
+    free(ra);
+}
+
+void *read_ahead_thread(void *ctx) {
+    read_ahead *ra = ctx;
+
+    pthread_mutex_lock(&ra->mutex);
+
+    while (!ra->stop) {
+        if (ra->count == READ_AHEAD_BLOCKS) {
+            pthread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+
+        // The block is not accessed by the parsing thread until count
+        // is incremented, thus it can be filled without the lock.
+
+        size_t index = (ra->head + ra->count) % READ_AHEAD_BLOCKS;
+        pthread_mutex_unlock(&ra->mutex);
+
+        ssize_t n = archive_read_data(ra->ar, ra->blocks[index], READ_AHEAD_BLOCK_SIZE);
+
+        pthread_mutex_lock(&ra->mutex);
+
+        if (n > 0) {
+            ra->sizes[index] = n;
+            ra->count++;
+        }
+        else {
+            if (n < 0) {
+                const char *msg = archive_error_string(ra->ar);
+
+                ra->error = archive_errno(ra->ar) ? archive_errno(ra->ar) : EIO;
+                ra->error_string = msg ? strdup(msg) : NULL;
+            }
+
+            ra->eof = 1;
+        }
+
+        pthread_cond_broadcast(&ra->cond);
+
+        if (ra->eof) break;
+    }
+
+    pthread_mutex_unlock(&ra->mutex);
+    return NULL;
+}
+
+ssize_t read_ahead_callback(struct archive *ar, void *ctx, const void **buffer) {
+    read_ahead *ra = ctx;
+    ssize_t size = 0;
+
+    pthread_mutex_lock(&ra->mutex);
+
+    // Release the block returned by the previous call
+
+    if (ra->held) {
+        ra->held = 0;
+        ra->head = (ra->head + 1) % READ_AHEAD_BLOCKS;
+        ra->count--;
+
+        pthread_cond_broadcast(&ra->cond);
+    }
+
+    while (!ra->count && !ra->eof)
+        pthread_cond_wait(&ra->cond, &ra->mutex);
+
+    if (ra->count) {
+        *buffer = ra->blocks[ra->head];
+        size = ra->sizes[ra->head];
+        ra->held = 1;
+    }
+    else if (ra->error) {
+        archive_set_error(ar, ra->error, "%s", ra->error_string ? ra->error_string : strerror(ra->error));
+        size = ARCHIVE_FATAL;
+    }
+
+    pthread_mutex_unlock(&ra->mutex);
+    return size;
+}
+
+
+//// Appending to Archives
+
+EXPORT
+void *nuc_arch_open_append(const char *file, int *error) {
+    nuc_arch_handle *handle = alloc_handle();
+
+    if (!handle) {
+        *error = NUC_AP_FATAL;
+        return NULL;
+    }
+
+    handle->mode = NUC_AP_MODE_PACK;
+
+    if ((*error = open_append(file, handle))) {
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+int open_append(const char *file, nuc_arch_handle *handle) {
+    struct archive *in;
+    struct archive_entry *ent;
+
+    int format, appendable, err;
+    off_t end;
+    struct stat st;
+
+    /* Determine the format and the offset of the end-of-archive marker */
+
+    if (!(in = archive_read_new()))
+        return NUC_AP_FATAL;
+
+    archive_read_support_filter_all(in);
+    archive_read_support_format_all(in);
+
+    if (archive_read_open_filename(in, file, read_block_size(file)) != ARCHIVE_OK) {
+        errno = archive_errno(in);
+        archive_read_free(in);
+
+        return NUC_AP_FAILED;
+    }
+
+    /* The format and filters are known once the first header is
+     * read. Archives which cannot be appended to are rejected before
+     * the remaining headers are read, which would require
+     * decompressing a compressed archive. */
+
+    err = archive_read_next_header(in, &ent);
+    format = archive_format(in);
+
+    appendable = (err == ARCHIVE_OK || err == ARCHIVE_EOF) &&
+        archive_filter_count(in) == 1 &&
+        archive_filter_code(in, 0) == ARCHIVE_FILTER_NONE &&
+        (format & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_TAR;
+
+    /* The data of each entry is skipped, by seeking, when the next
+     * header is read. */
+
+    if (appendable && err == ARCHIVE_OK) {
+        while ((err = archive_read_next_header(in, &ent)) == ARCHIVE_OK);
+        appendable = err == ARCHIVE_EOF;
+    }
+
+    /* After the end-of-archive marker is read, the header position
+     * is the offset of the marker. */
+    end = archive_read_header_position(in);
+
+    archive_read_free(in);
+
+    if (!appendable) {
+        errno = ENOTSUP;
+        return NUC_AP_FAILED;
+    }
+
+    /* Open archive file for writing from the end-of-archive marker */
+
+    if ((handle->append_fd = open(file, O_RDWR)) < 0)
+        return NUC_AP_FAILED;
+
+    /* Save the data following the end-of-archive marker, so that the
+     * archive can be restored if appending fails. */
+
+    if (fstat(handle->append_fd, &st))
+        goto cleanup;
+
+    if (st.st_size < end || st.st_size - end > MAX_APPEND_TAIL_SIZE) {
+        errno = ENOTSUP;
+        goto cleanup;
+    }
+
+    handle->append_end = end;
+    handle->append_size = st.st_size;
+
+    if (!(handle->append_tail = malloc(st.st_size - end + 1)))
+        goto cleanup;
+
+    errno = 0;
+
+    if (pread(handle->append_fd, handle->append_tail, st.st_size - end, end) != st.st_size - end) {
+        if (!errno) errno = EIO;
+        goto cleanup;
+    }
+
+    if (lseek(handle->append_fd, end, SEEK_SET) < 0)
+        goto cleanup;
+
+    if (!(handle->ar = archive_write_new())) {
+        free(handle->append_tail);
+        close(handle->append_fd);
+        return NUC_AP_FATAL;
+    }
+
+    /* The last block is not padded, as the remainder of the file,
+     * following the new end-of-archive marker, consists of zeros. */
+
+    if (archive_write_set_format(handle->ar, format) != ARCHIVE_OK ||
+        archive_write_add_filter_none(handle->ar) != ARCHIVE_OK ||
+        archive_write_set_bytes_in_last_block(handle->ar, 1) != ARCHIVE_OK ||
+        archive_write_open_fd(handle->ar, handle->append_fd) != ARCHIVE_OK) {
+        errno = archive_errno(handle->ar);
+        archive_write_free(handle->ar);
+
+        goto cleanup;
+    }
+
+    return NUC_AP_OK;
+
+cleanup:
+    err = errno;
+    free(handle->append_tail);
+    close(handle->append_fd);
+    errno = err;
+
+    return NUC_AP_FAILED;
+}
+
+EXPORT
+int nuc_arch_abort_append(void *ctx) {
+    nuc_arch_handle *handle = ctx;
+    int err;
+
+    /* Freeing the libarchive handle writes the buffered data and an
+     * end-of-archive marker, which are discarded when the archive is
+     * restored. */
+
+    archive_write_free(handle->ar);
+    handle->ar = NULL;
+
+    err = restore_append(handle);
+
+    if (close_pack(handle) && !err)
+        err = NUC_AP_FAILED;
+
+    free(handle);
+    return err;
+}
+
+int restore_append(nuc_arch_handle *handle) {
+    const char *tail = handle->append_tail;
+    size_t n = handle->append_size - handle->append_end;
+    off_t offset = handle->append_end;
+
+    if (ftruncate(handle->append_fd, handle->append_size))
+        return NUC_AP_FAILED;
+
+    while (n) {
+        ssize_t written = pwrite(handle->append_fd, tail, n, offset);
+
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return NUC_AP_FAILED;
+        }
+
+        tail += written;
+        offset += written;
+        n -= written;
+    }
+
+    return NUC_AP_OK;
+}
+
+
 //// Unpacking Raw Data
 
 EXPORT
@@ -418,7 +1390,7 @@ ssize_t unpack_write_callback(struct archive *ar, void *ctx, const void *buffer,
     ssize_t n = handle->write_fn(handle->callback_ctx, buffer, length);
 
     if (n < 0) {
-        /* TODO: Call archive_set_error */
+        archive_set_error(ar, errno ? errno : EIO, "Error writing archive data");
         return -1;
     }
 
@@ -447,68 +1419,374 @@ int nuc_arch_close(void *ctx) {
     return err;
 }
 
-int close_unpack(nuc_arch_handle *handle) {
-    int err = err_code(handle, archive_read_close(handle->ar));
-    archive_read_free(handle->ar);
+int close_unpack(nuc_arch_handle *handle) {
+    int err = err_code(handle, archive_read_close(handle->ar));
+    archive_read_free(handle->ar);
+
+    if (handle->read_ahead)
+        close_read_ahead(handle->read_ahead);
+
+    if (handle->zip)
+        close_zip_reader(handle->zip);
+
+    free(handle->src_file);
+
+    return err;
+}
+
+int close_pack(nuc_arch_handle *handle) {
+    int err = NUC_AP_OK;
+
+    // The data of the last entry is written before the central
+    // directory is captured.
+
+    if (handle->zip_out && handle->ar) {
+        err = err_code(handle, archive_write_finish_entry(handle->ar));
+        handle->zip_out->closing = 1;
+    }
+
+    if (handle->ar) {
+        int code = err_code(handle, archive_write_close(handle->ar));
+        archive_write_free(handle->ar);
+
+        if (!err) err = code;
+    }
+
+    if (handle->zip_out) {
+        int code = close_zip_writer(handle->zip_out, !err);
+        if (!err) err = code;
+    }
+
+    if (handle->dest_file) free(handle->dest_file);
+    if (handle->ent) archive_entry_free(handle->ent);
+    if (handle->tmp_file) fclose(handle->tmp_file);
+
+    if (handle->append_fd >= 0) {
+        /* If the new entries could not be written completely, the
+         * archive is restored to its original state. */
+
+        if (err) {
+            int code = errno;
+            restore_append(handle);
+            errno = code;
+        }
+
+        if (close(handle->append_fd) && !err)
+            err = NUC_AP_FAILED;
+
+        free(handle->append_tail);
+    }
+
+    return err;
+}
+
+
+//// Error Reporting
+
+EXPORT
+int nuc_arch_error_code(void *ctx) {
+    nuc_arch_handle *handle = ctx;
+    return archive_errno(handle->ar);
+}
+
+EXPORT
+const char * nuc_arch_error_string(void *ctx) {
+    nuc_arch_handle *handle = ctx;
+    return archive_error_string(handle->ar);
+}
+
+
+//// Set Callback
+
+EXPORT
+void nuc_arch_set_callback(void *plg_ctx, nuc_arch_progress_fn callback, void *cb_ctx) {
+    nuc_arch_handle *handle = plg_ctx;
+
+    handle->callback = callback;
+    handle->ctx = cb_ctx;
+}
+
+
+//// Reading and Unpacking Entries
+
+EXPORT
+int nuc_arch_next_entry(void *ctx, const char **path) {
+    int err;
+    nuc_arch_handle *handle = ctx;
+
+    err = err_code(handle, archive_read_next_header(handle->ar, &handle->ent));
+
+    if (err) return err;
+
+    handle->entry_read = 1;
+
+    if (handle->zip) {
+        handle->zip->current = match_zip_entry(handle->zip, archive_entry_pathname(handle->ent));
+
+        if (handle->zip->streaming && (err = set_zip_entry_attributes(handle)))
+            return err;
+    }
+
+    *path = archive_entry_pathname(handle->ent);
+
+    return NUC_AP_OK;
+}
+
+
+//// Seeking to Entries
+
+EXPORT
+int nuc_arch_seek_entry(void *ctx, const char *path) {
+    nuc_arch_handle *handle = ctx;
+    struct archive *ar;
+    zip_reader *zip;
+    size_t index;
+    const char *name;
+    int err;
+
+    /*
+     * Libarchive does not provide random access to entries, thus
+     * entries are located using the central directory of zip
+     * archives. Compressed archive files, and archives opened with
+     * nuc_arch_open_unpack, are not supported.
+     */
+
+    if (!handle->src_file || handle->read_ahead || handle->entry_read) {
+        errno = ENOTSUP;
+        return NUC_AP_FAILED;
+    }
+
+    if (!(zip = open_zip_reader(handle->src_file)))
+        return NUC_AP_FAILED;
+
+    if ((index = find_zip_entry(zip->cd, path)) == zip->cd->count) {
+        close_zip_reader(zip);
+        return NUC_AP_EOF;
+    }
+
+    zip->offset = zip->cd->entries[index].offset;
+    zip->next = index;
+    zip->streaming = 1;
+
+    if (!(ar = archive_read_new())) {
+        close_zip_reader(zip);
+        return NUC_AP_FATAL;
+    }
+
+    if (archive_read_support_format_zip_streamable(ar) != ARCHIVE_OK ||
+        archive_read_set_read_callback(ar, zip_read_callback) != ARCHIVE_OK ||
+        archive_read_set_skip_callback(ar, zip_skip_callback) != ARCHIVE_OK ||
+        archive_read_set_callback_data(ar, zip) != ARCHIVE_OK ||
+        archive_read_open1(ar) != ARCHIVE_OK) {
+        errno = archive_errno(ar) ? archive_errno(ar) : EIO;
+        archive_read_free(ar);
+        close_zip_reader(zip);
+
+        return NUC_AP_FAILED;
+    }
+
+    archive_read_free(handle->ar);
+
+    handle->ar = ar;
+    handle->zip = zip;
+
+    if ((err = nuc_arch_next_entry(handle, &name)) == NUC_AP_EOF) {
+        errno = EIO;
+        return NUC_AP_FAILED;
+    }
+
+    return err;
+}
+
+zip_reader *open_zip_reader(const char *file) {
+    zip_reader *zip = calloc(1, sizeof(zip_reader));
+    int err;
+
+    if (!zip) return NULL;
+
+    if ((zip->fd = open(file, O_RDONLY)) < 0) {
+        free(zip);
+        return NULL;
+    }
+
+    zip->block_size = read_block_size(file);
+
+    if (!(zip->block = malloc(zip->block_size)) || !(zip->cd = zip_read_cd(zip->fd))) {
+        err = errno;
+
+        close(zip->fd);
+        free(zip->block);
+        free(zip);
+
+        errno = err;
+        return NULL;
+    }
+
+    return zip;
+}
+
+void close_zip_reader(zip_reader *zip) {
+    close(zip->fd);
+    zip_free_cd(zip->cd);
+
+    free(zip->block);
+    free(zip);
+}
+
+size_t find_zip_entry(const zip_cd *cd, const char *path) {
+    size_t path_len = strlen(path);
+    char *buf = NULL;
+    size_t buf_size = 0;
+    size_t i;
+
+    for (i = 0; i < cd->count; i++) {
+        const zip_entry *ent = &cd->entries[i];
+
+        if (ent->name_len >= buf_size) {
+            char *new_buf = realloc(buf, ent->name_len + 1);
+
+            if (!new_buf) break;
+
+            buf = new_buf;
+            buf_size = ent->name_len + 1;
+        }
+
+        if (canonicalize_path(ent->name, ent->name_len, buf) == path_len && !memcmp(buf, path, path_len))
+            break;
+    }
+
+    free(buf);
+    return i;
+}
+
+size_t canonicalize_path(const char *name, size_t len, char *buf) {
+    const char *end = name + len;
+    size_t size = 0, num_comps = 0;
+
+    if (len && *name == '/') {
+        buf[size++] = '/';
+        num_comps++;
+    }
+
+    while (name < end) {
+        const char *comp = name;
+        size_t comp_len;
+
+        while (name < end && *name != '/') name++;
+
+        comp_len = name - comp;
+
+        if (name < end) name++;
+
+        if (!comp_len || (comp_len == 1 && comp[0] == '.'))
+            continue;
+
+        if (comp_len == 2 && comp[0] == '.' && comp[1] == '.' && num_comps) {
+            // Start of the last component
+
+            size_t last = size;
+            while (last && buf[last - 1] != '/') last--;
+
+            if (size - last != 2 || buf[last] != '.' || buf[last + 1] != '.') {
+                if (last == size) {
+                    // The last component is the root "/"
+                    size = 0;
+                }
+                else {
+                    size = last > 1 ? last - 1 : last;
+                }
+
+                num_comps--;
+                continue;
+            }
+        }
+
+        if (size && buf[size - 1] != '/')
+            buf[size++] = '/';
 
-    return err;
+        memcpy(buf + size, comp, comp_len);
+        size += comp_len;
+        num_comps++;
+    }
+
+    return size;
 }
 
-int close_pack(nuc_arch_handle *handle) {
-    int err = err_code(handle, archive_write_close(handle->ar));
+const zip_entry *match_zip_entry(zip_reader *zip, const char *name) {
+    size_t len = name ? strlen(name) : 0;
 
-    if (handle->dest_file) free(handle->dest_file);
-    if (handle->ent) archive_entry_free(handle->ent);
-    if (handle->tmp_file) fclose(handle->tmp_file);
+    // Entries which are not found are either entries of which the
+    // names were converted to a different character set, or entries
+    // which are not listed in the central directory.
 
-    archive_write_free(handle->ar);
+    for (size_t i = zip->next; i < zip->cd->count && i - zip->next < ZIP_MATCH_WINDOW; i++) {
+        const zip_entry *ent = &zip->cd->entries[i];
 
-    return err;
+        if (ent->name_len == len && !memcmp(ent->name, name, len)) {
+            zip->next = i + 1;
+            return ent;
+        }
+    }
+
+    return NULL;
 }
 
-
-//// Error Reporting
+int set_zip_entry_attributes(nuc_arch_handle *handle) {
+    const zip_entry *ent = handle->zip->current;
+    mode_t mode;
 
-EXPORT
-int nuc_arch_error_code(void *ctx) {
-    nuc_arch_handle *handle = ctx;
-    return archive_errno(handle->ar);
-}
+    if (!ent) return NUC_AP_OK;
 
-EXPORT
-const char * nuc_arch_error_string(void *ctx) {
-    nuc_arch_handle *handle = ctx;
-    return archive_error_string(handle->ar);
-}
+    if ((mode = zip_entry_mode(ent)) & AE_IFMT) {
+        archive_entry_set_mode(handle->ent, mode);
+    }
+    else if (mode) {
+        archive_entry_set_perm(handle->ent, mode);
+    }
 
-
-//// Set Callback
+    if (archive_entry_filetype(handle->ent) == AE_IFLNK) {
+        char target[PATH_MAX];
+        ssize_t n = archive_read_data(handle->ar, target, sizeof(target) - 1);
 
-EXPORT
-void nuc_arch_set_callback(void *plg_ctx, nuc_arch_progress_fn callback, void *cb_ctx) {
-    nuc_arch_handle *handle = plg_ctx;
+        if (n < 0) return err_code(handle, n);
 
-    handle->callback = callback;
-    handle->ctx = cb_ctx;
+        target[n] = 0;
+
+        archive_entry_set_symlink(handle->ent, target);
+        archive_entry_set_size(handle->ent, 0);
+    }
+    else if (!archive_entry_size_is_set(handle->ent)) {
+        archive_entry_set_size(handle->ent, ent->size);
+    }
+
+    return NUC_AP_OK;
 }
 
-
-//// Reading and Unpacking Entries
+ssize_t zip_read_callback(struct archive *ar, void *ctx, const void **buffer) {
+    zip_reader *zip = ctx;
+    ssize_t n;
 
-EXPORT
-int nuc_arch_next_entry(void *ctx, const char **path) {
-    int err;
-    nuc_arch_handle *handle = ctx;
+    while ((n = pread(zip->fd, zip->block, zip->block_size, zip->offset)) < 0) {
+        if (errno != EINTR) {
+            archive_set_error(ar, errno, "Error reading archive file");
+            return ARCHIVE_FATAL;
+        }
+    }
 
-    err = err_code(handle, archive_read_next_header(handle->ar, &handle->ent));
+    zip->offset += n;
+    *buffer = zip->block;
 
-    if (err) return err;
+    return n;
+}
 
-    *path = archive_entry_pathname(handle->ent);
+int64_t zip_skip_callback(struct archive *ar, void *ctx, int64_t request) {
+    zip_reader *zip = ctx;
 
-    return NUC_AP_OK;
+    zip->offset += request;
+    return request;
 }
 
+
 EXPORT
 const struct stat *nuc_arch_entry_stat(void *ctx) {
     nuc_arch_handle *handle = ctx;
@@ -549,22 +1827,114 @@ int nuc_arch_copy_archive_type(void *dest_handle, const void *src_handle) {
     int num_filters = archive_filter_count(src->ar);
     int err;
 
+    // If the archive was read with read-ahead, its compression
+    // filters are those of the read-ahead handle, which replace the
+    // final "none" filter of the archive handle.
+
+    if (src->read_ahead) num_filters--;
+
     for (int i = 0; i < num_filters; i++) {
-        err = err_code(dest, archive_write_add_filter(dest->ar, archive_filter_code(src->ar, i)));
-        if (err) return err;
+        if ((err = add_filter(dest, archive_filter_code(src->ar, i))))
+            return err;
+    }
+
+    if (src->read_ahead) {
+        struct archive *ar = src->read_ahead->ar;
+        num_filters = archive_filter_count(ar);
+
+        for (int i = 0; i < num_filters; i++) {
+            if ((err = add_filter(dest, archive_filter_code(ar, i))))
+                return err;
+        }
+    }
+
+    if (dest->threads > 1 && (err = set_filter_threads(dest))) {
+        return err;
     }
 
     if ((err = err_code(dest, archive_write_set_format(dest->ar, archive_format(src->ar))))) {
         return err;
     }
 
-    if (dest->dest_file)
+    // Entries of uncompressed zip archives may be copied without
+    // recompressing them, see nuc_arch_copy_last_entry_raw.
+
+    if (dest->dest_file && !src->read_ahead &&
+        archive_filter_count(src->ar) == 1 &&
+        (archive_format(src->ar) & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP)
+        return open_zip_writer(dest);
+    else if (dest->dest_file)
         return err_code(dest, archive_write_open_filename(dest->ar, dest->dest_file));
     else
         return err_code(dest, archive_write_open(dest->ar, dest, open_callback, unpack_write_callback, close_callback));
 }
 
 
+int add_filter(nuc_arch_handle *handle, int code) {
+    if (code == ARCHIVE_FILTER_GZIP && handle->threads > 1 && program_in_path("pigz")) {
+        char cmd[32];
+        snprintf(cmd, sizeof(cmd), "pigz -p %d", handle->threads);
+
+        return err_code(handle, archive_write_add_filter_program(handle->ar, cmd));
+    }
+
+    return err_code(handle, archive_write_add_filter(handle->ar, code));
+}
+
+int set_filter_threads(nuc_arch_handle *handle) {
+    char threads[16];
+    snprintf(threads, sizeof(threads), "%d", handle->threads);
+
+    // Filters which do not support the option, ignore it, in which
+    // case ARCHIVE_WARN is returned.
+
+    int err = archive_write_set_filter_option(handle->ar, NULL, "threads", threads);
+    return err == ARCHIVE_WARN ? NUC_AP_OK : err_code(handle, err);
+}
+
+int program_in_path(const char *name) {
+    const char *path = getenv("PATH");
+    char file[PATH_MAX];
+
+    while (path && *path) {
+        const char *end = strchr(path, ':');
+        size_t len = end ? (size_t)(end - path) : strlen(path);
+
+        if (len && snprintf(file, sizeof(file), "%.*s/%s", (int)len, path, name) < (int)sizeof(file) &&
+            !access(file, X_OK))
+            return 1;
+
+        path = end ? end + 1 : NULL;
+    }
+
+    return 0;
+}
+
+EXPORT
+int nuc_arch_set_threads(void *ctx, int threads) {
+    nuc_arch_handle *handle = ctx;
+
+    if (threads <= 0) {
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = ncpus > 0 ? ncpus : 1;
+    }
+
+    handle->threads = threads;
+    return NUC_AP_OK;
+}
+
+
+EXPORT
+int nuc_arch_streams_unknown_size(void *ctx) {
+    nuc_arch_handle *handle = ctx;
+
+    // The zip format stores the size of an entry, of which the size
+    // is not set, in a data descriptor following its data.
+
+    return (archive_format(handle->ar) & ARCHIVE_FORMAT_BASE_MASK) == ARCHIVE_FORMAT_ZIP;
+}
+
+
 EXPORT
 int nuc_arch_copy_last_entry_header(void *dest_handle, const void *src_handle) {
     const nuc_arch_handle *src = src_handle;
@@ -604,6 +1974,342 @@ int nuc_arch_copy_last_entry_data(void *dest_handle, void *src_handle) {
 }
 
 
+EXPORT
+int nuc_arch_copy_last_entry_raw(void *dest_handle, void *src_handle, const char *path) {
+    nuc_arch_handle *src = src_handle;
+    nuc_arch_handle *dest = dest_handle;
+    zip_writer *out = dest->zip_out;
+
+    const zip_entry *ent;
+    zip_entry copy;
+
+    char *name = NULL;
+    size_t name_len;
+
+    zip_buf extra = {0}, header = {0};
+    uint64_t offset, data_offset;
+    int err = NUC_AP_FAILED;
+
+    /* Entries can only be copied between zip archive files, of which
+     * the local headers are located using the central directory. */
+
+    if (!out || !src->src_file || src->read_ahead || !src->ent || src->zip_unsupported) {
+        errno = ENOTSUP;
+        return NUC_AP_FAILED;
+    }
+
+    if (!src->zip && (err = open_copy_zip_reader(src)))
+        return err;
+
+    /* The data descriptor is not copied, as the sizes and CRC-32 are
+     * stored in the local header. This is not possible for encrypted
+     * entries, as the encryption header depends on whether the entry
+     * has a data descriptor. */
+
+    if (!(ent = src->zip->current) ||
+        ((ent->flags & ZIP_FLAG_ENCRYPTED) && (ent->flags & ZIP_FLAG_DESCRIPTOR))) {
+        errno = ENOTSUP;
+        return NUC_AP_FAILED;
+    }
+
+    copy = *ent;
+    copy.flags &= ~ZIP_FLAG_DESCRIPTOR;
+
+    if (path) {
+        // Directory entry names end in a slash
+
+        int is_dir = ent->name_len && ent->name[ent->name_len - 1] == '/';
+        name_len = strlen(path);
+
+        if (!(name = malloc(name_len + 2)))
+            return NUC_AP_FATAL;
+
+        memcpy(name, path, name_len);
+
+        if (is_dir && (!name_len || path[name_len - 1] != '/'))
+            name[name_len++] = '/';
+    }
+
+    /* The entry previously written by libarchive is finished, so that
+     * its data precedes the copied entry. */
+
+    if ((err = err_code(dest, archive_write_finish_entry(dest->ar))))
+        goto cleanup;
+
+    err = NUC_AP_FAILED;
+    offset = out->offset;
+
+    if (zip_read_local_header(src->zip->fd, ent, &extra, &data_offset) ||
+        zip_make_local_header(&header, &copy, name ? name : ent->name, name ? name_len : ent->name_len, extra.data, extra.size) ||
+        zip_write(out, header.data, header.size) ||
+        zip_copy_data(out, src->zip->fd, data_offset, ent->compressed_size) ||
+        zip_make_record(&out->cd, &copy, name ? name : ent->name, name ? name_len : ent->name_len, offset))
+        goto cleanup;
+
+    out->count++;
+    out->shifted = 1;
+
+    err = NUC_AP_OK;
+
+cleanup:
+    free(name);
+    zip_buf_free(&extra);
+    zip_buf_free(&header);
+
+    return err;
+}
+
+
+int open_copy_zip_reader(nuc_arch_handle *handle) {
+    const char *name = archive_entry_pathname(handle->ent);
+    size_t len = name ? strlen(name) : 0;
+
+    zip_reader *zip;
+
+    if (!(zip = open_zip_reader(handle->src_file))) {
+        handle->zip_unsupported = errno == ENOTSUP;
+        return NUC_AP_FAILED;
+    }
+
+    // Entries may have been read before the reader was opened, thus
+    // the first entry with the same name is searched for in the
+    // entire central directory.
+
+    while (zip->next < zip->cd->count) {
+        const zip_entry *ent = &zip->cd->entries[zip->next];
+
+        if (ent->name_len == len && !memcmp(ent->name, name, len))
+            break;
+
+        zip->next++;
+    }
+
+    // If the entry is not found, the reader cannot be synchronized
+    // with libarchive.
+
+    if (!(zip->current = match_zip_entry(zip, name))) {
+        close_zip_reader(zip);
+
+        handle->zip_unsupported = 1;
+        errno = ENOTSUP;
+
+        return NUC_AP_FAILED;
+    }
+
+    handle->zip = zip;
+    return NUC_AP_OK;
+}
+
+
+//// Writing Zip Archives
+
+int open_zip_writer(nuc_arch_handle *handle) {
+    zip_writer *zip = calloc(1, sizeof(zip_writer));
+    int err;
+
+    if (!zip || !(zip->buf = malloc(ZIP_WRITE_BUF_SIZE))) {
+        free(zip);
+        return NUC_AP_FATAL;
+    }
+
+    if ((zip->fd = open(handle->dest_file, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+        err = errno;
+
+        free(zip->buf);
+        free(zip);
+
+        errno = err;
+        return NUC_AP_FAILED;
+    }
+
+    handle->zip_out = zip;
+
+    // Libarchive's output is not blocked, so that the number of bytes
+    // written by it is known exactly when an entry is copied.
+
+    if ((err = err_code(handle, archive_write_set_bytes_per_block(handle->ar, 0))))
+        return err;
+
+    return err_code(handle, archive_write_open(handle->ar, zip, NULL, zip_write_callback, NULL));
+}
+
+int close_zip_writer(zip_writer *zip, int write_cd) {
+    int err = NUC_AP_OK;
+
+    if (write_cd) {
+        const unsigned char *data = zip->tail.data;
+        size_t size = zip->tail.size;
+        uint64_t cd_offset = zip->offset, cd_size;
+        zip_entry ent;
+
+        // Records of the entries written by libarchive, which follow
+        // the copied entries' records.
+
+        while (zip_parse_record(data, size, &ent)) {
+            if (zip_make_record(&zip->cd, &ent, ent.name, ent.name_len, zip_file_offset(zip, ent.offset))) {
+                err = NUC_AP_FAILED;
+                break;
+            }
+
+            zip->count++;
+
+            data += ent.record_size;
+            size -= ent.record_size;
+        }
+
+        cd_size = zip->cd.size;
+
+        if (!err && (zip_make_end(&zip->cd, cd_offset, cd_size, zip->count) ||
+                     zip_write(zip, zip->cd.data, zip->cd.size) ||
+                     zip_flush(zip)))
+            err = NUC_AP_FAILED;
+    }
+
+    if (close(zip->fd) && !err)
+        err = NUC_AP_FAILED;
+
+    free(zip->buf);
+    free(zip->shifts);
+    zip_buf_free(&zip->cd);
+    zip_buf_free(&zip->tail);
+    free(zip);
+
+    return err;
+}
+
+ssize_t zip_write_callback(struct archive *ar, void *ctx, const void *buffer, size_t length) {
+    zip_writer *zip = ctx;
+
+    if (zip->closing) {
+        if (zip_buf_append(&zip->tail, buffer, length))
+            goto error;
+    }
+    else {
+        if (zip->shifted) {
+            if (zip->num_shifts == zip->max_shifts) {
+                size_t max = zip->max_shifts ? zip->max_shifts * 2 : 16;
+                zip_shift *shifts = realloc(zip->shifts, max * sizeof(zip_shift));
+
+                if (!shifts) goto error;
+
+                zip->shifts = shifts;
+                zip->max_shifts = max;
+            }
+
+            zip->shifts[zip->num_shifts].ar_offset = zip->ar_offset;
+            zip->shifts[zip->num_shifts].offset = zip->offset;
+            zip->num_shifts++;
+
+            zip->shifted = 0;
+        }
+
+        if (zip_write(zip, buffer, length))
+            goto error;
+    }
+
+    zip->ar_offset += length;
+    return length;
+
+error:
+    archive_set_error(ar, errno, "Error writing archive file");
+    return -1;
+}
+
+uint64_t zip_file_offset(const zip_writer *zip, uint64_t ar_offset) {
+    size_t low = 0, high = zip->num_shifts;
+
+    // Find the last shift preceding the offset
+
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+
+        if (zip->shifts[mid].ar_offset <= ar_offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (!low) return ar_offset;
+
+    return zip->shifts[low - 1].offset + (ar_offset - zip->shifts[low - 1].ar_offset);
+}
+
+int zip_write(zip_writer *zip, const void *data, size_t size) {
+    if (zip->buf_size + size > ZIP_WRITE_BUF_SIZE && zip_flush(zip))
+        return -1;
+
+    if (size >= ZIP_WRITE_BUF_SIZE) {
+        if (write_all(zip->fd, data, size))
+            return -1;
+    }
+    else {
+        memcpy(zip->buf + zip->buf_size, data, size);
+        zip->buf_size += size;
+    }
+
+    zip->offset += size;
+    return 0;
+}
+
+int zip_copy_data(zip_writer *zip, int fd, uint64_t offset, uint64_t size) {
+    while (size) {
+        size_t n = ZIP_WRITE_BUF_SIZE - zip->buf_size;
+        ssize_t nread;
+
+        if (!n) {
+            if (zip_flush(zip)) return -1;
+            n = ZIP_WRITE_BUF_SIZE;
+        }
+
+        if (n > size) n = size;
+
+        if ((nread = pread(fd, zip->buf + zip->buf_size, n, offset)) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        if (!nread) {
+            errno = EIO;
+            return -1;
+        }
+
+        zip->buf_size += nread;
+        zip->offset += nread;
+
+        offset += nread;
+        size -= nread;
+    }
+
+    return 0;
+}
+
+int zip_flush(zip_writer *zip) {
+    if (write_all(zip->fd, zip->buf, zip->buf_size))
+        return -1;
+
+    zip->buf_size = 0;
+    return 0;
+}
+
+int write_all(int fd, const void *data, size_t size) {
+    const char *p = data;
+
+    while (size) {
+        ssize_t n = write(fd, p, size);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        p += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
 EXPORT
 int nuc_arch_create_entry(void *ctx, const char *path, const struct stat *st) {
     nuc_arch_handle *handle = ctx;
@@ -653,9 +2359,16 @@ EXPORT
 int nuc_arch_write_entry_header(void *ctx) {
     nuc_arch_handle *handle = ctx;
 
-    // If size is unknown, create a temporary file to which the data
-    // will be written. The data will be written to the actual archive
-    // in nuc_arch_pack_finish.
+    // If size is unknown, and the format requires the size in the
+    // header, create a temporary file to which the data will be
+    // written. The data will be written to the actual archive in
+    // nuc_arch_pack_finish.
+
+    if (!archive_entry_size(handle->ent) && archive_entry_filetype(handle->ent) == AE_IFREG &&
+        nuc_arch_streams_unknown_size(handle)) {
+        archive_entry_unset_size(handle->ent);
+        return err_code(handle, archive_write_header(handle->ar, handle->ent));
+    }
 
     if (!archive_entry_size(handle->ent)) {
         char name[] = "/tmp/nucommander-tmpXXXXXX";
@@ -0,0 +1,747 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "zip.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Record signatures.
+ */
+#define ZIP_LOCAL_SIG 0x04034b50
+#define ZIP_CD_SIG 0x02014b50
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP64_EOCD_SIG 0x06064b50
+#define ZIP64_LOCATOR_SIG 0x07064b50
+
+/**
+ * Sizes of the fixed-size portions of the records.
+ */
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_CD_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_SIZE 56
+#define ZIP64_LOCATOR_SIZE 20
+
+/**
+ * Maximum size of the archive comment.
+ */
+#define ZIP_MAX_COMMENT 65535
+
+/**
+ * Maximum size of a central directory which is read into memory.
+ */
+#define ZIP_MAX_CD_SIZE 268435456
+
+/**
+ * Maximum value of 16-bit and 32-bit fields, which also indicates
+ * that the value is stored in a zip64 field.
+ */
+#define ZIP_MAX16 0xFFFF
+#define ZIP_MAX32 0xFFFFFFFF
+
+/**
+ * Extra field ids: zip64 extended information and Info-ZIP Unicode
+ * path.
+ */
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_UNICODE_PATH_ID 0x7075
+
+/**
+ * Version needed to extract entries with zip64 fields.
+ */
+#define ZIP64_VERSION 45
+
+/**
+ * General purpose flag: Name is UTF-8 encoded.
+ */
+#define ZIP_FLAG_UTF8 0x0800
+
+/**
+ * "Version made by" host system value of Unix.
+ */
+#define ZIP_HOST_UNIX 3
+
+
+//// Function Prototypes
+
+/**
+ * Read little-endian integers.
+ */
+static uint16_t get16(const unsigned char *p);
+static uint32_t get32(const unsigned char *p);
+static uint64_t get64(const unsigned char *p);
+
+/**
+ * Write little-endian integers.
+ */
+static void set16(unsigned char *p, uint16_t value);
+static void set32(unsigned char *p, uint32_t value);
+static void set64(unsigned char *p, uint64_t value);
+
+/**
+ * Ensures that a buffer can hold at least @a size more bytes.
+ *
+ * @param buf The buffer.
+ * @param size Number of bytes.
+ *
+ * @return Zero if successful, -1 if memory could not be allocated.
+ */
+static int reserve(zip_buf *buf, size_t size);
+
+/**
+ * Reads exactly @a size bytes at offset @a offset of a file.
+ *
+ * @param fd The file descriptor.
+ * @param buf Buffer into which to read the data.
+ * @param size Number of bytes to read.
+ * @param offset Offset at which to begin reading.
+ *
+ * @return Zero if successful, -1 otherwise. If the end of file is
+ *   reached before @a size bytes are read, errno is set to ENOTSUP.
+ */
+static int read_at(int fd, void *buf, size_t size, off_t offset);
+
+/**
+ * Locates the central directory of an archive.
+ *
+ * @param fd File descriptor of the archive file.
+ * @param offset Set to the offset of the central directory.
+ * @param size Set to the size of the central directory.
+ * @param count Set to the number of entries.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+static int find_cd(int fd, uint64_t *offset, uint64_t *size, uint64_t *count);
+
+/**
+ * Compares central directory entries by the offsets of their local
+ * headers.
+ */
+static int compare_offsets(const void *a, const void *b);
+
+/**
+ * Checks whether a name is equal to the original name of an entry.
+ *
+ * @param ent The entry.
+ * @param name The name and its length.
+ * @param name_len
+ *
+ * @return Non-zero if the names are equal.
+ */
+static int same_name(const zip_entry *ent, const char *name, size_t name_len);
+
+/**
+ * Returns the general purpose flags of an entry, which is copied
+ * under a new name.
+ *
+ * @param ent The entry.
+ * @param name The new name and its length.
+ * @param name_len
+ *
+ * @return The flags.
+ */
+static uint16_t entry_flags(const zip_entry *ent, const char *name, size_t name_len);
+
+/**
+ * Returns the version needed to extract an entry.
+ *
+ * @param ent The entry.
+ * @param zip64 True if the entry's headers contain zip64 fields.
+ *
+ * @return The version.
+ */
+static uint16_t version_needed(const zip_entry *ent, int zip64);
+
+/**
+ * Appends the fields of extra field data to a buffer, excluding the
+ * zip64 field, which is created separately, and the Unicode path
+ * field if the entry is renamed.
+ *
+ * @param buf The buffer.
+ * @param extra Extra field data and its size.
+ * @param extra_len
+ * @param renamed True if the entry is renamed.
+ *
+ * @return Zero if successful, -1 if memory could not be allocated.
+ */
+static int copy_extra(zip_buf *buf, const unsigned char *extra, size_t extra_len, int renamed);
+
+
+//// Reading the Central Directory
+
+zip_cd *zip_read_cd(int fd) {
+    uint64_t offset, size, count;
+    zip_cd *cd;
+
+    if (find_cd(fd, &offset, &size, &count))
+        return NULL;
+
+    // Each record is at least ZIP_CD_SIZE bytes, which bounds the
+    // number of entries in a valid central directory.
+
+    if (size > ZIP_MAX_CD_SIZE || count > size / ZIP_CD_SIZE) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    if (!(cd = calloc(1, sizeof(zip_cd))))
+        return NULL;
+
+    if (!(cd->data = malloc(size ? size : 1)) ||
+        !(cd->entries = calloc(count ? count : 1, sizeof(zip_entry))))
+        goto cleanup;
+
+    if (read_at(fd, cd->data, size, offset))
+        goto cleanup;
+
+    const unsigned char *p = cd->data;
+    size_t left = size;
+
+    for (cd->count = 0; cd->count < count; cd->count++) {
+        zip_entry *ent = &cd->entries[cd->count];
+
+        if (!zip_parse_record(p, left, ent) || ent->offset >= offset) {
+            errno = ENOTSUP;
+            goto cleanup;
+        }
+
+        p += ent->record_size;
+        left -= ent->record_size;
+    }
+
+    qsort(cd->entries, cd->count, sizeof(zip_entry), compare_offsets);
+
+    // Data preceding the first entry indicates that the offsets are
+    // relative to a different position than the start of the file.
+
+    if (cd->count && cd->entries[0].offset) {
+        errno = ENOTSUP;
+        goto cleanup;
+    }
+
+    return cd;
+
+cleanup:
+    zip_free_cd(cd);
+    return NULL;
+}
+
+int find_cd(int fd, uint64_t *offset, uint64_t *size, uint64_t *count) {
+    unsigned char *tail, *eocd = NULL;
+    size_t tail_size;
+    off_t eocd_pos;
+    struct stat st;
+
+    if (fstat(fd, &st))
+        return -1;
+
+    if (st.st_size < ZIP_EOCD_SIZE) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    // The end of central directory record is located at the end of
+    // the file, followed only by the archive comment.
+
+    tail_size = st.st_size < ZIP_EOCD_SIZE + ZIP_MAX_COMMENT ? st.st_size : ZIP_EOCD_SIZE + ZIP_MAX_COMMENT;
+
+    if (!(tail = malloc(tail_size)))
+        return -1;
+
+    if (read_at(fd, tail, tail_size, st.st_size - tail_size)) {
+        free(tail);
+        return -1;
+    }
+
+    for (size_t i = tail_size - ZIP_EOCD_SIZE + 1; i-- > 0;) {
+        if (get32(tail + i) == ZIP_EOCD_SIG && i + ZIP_EOCD_SIZE + get16(tail + i + 20) == tail_size) {
+            eocd = tail + i;
+            break;
+        }
+    }
+
+    if (!eocd || get16(eocd + 4) || get16(eocd + 6) || get16(eocd + 8) != get16(eocd + 10)) {
+        free(tail);
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    eocd_pos = st.st_size - tail_size + (eocd - tail);
+
+    *count = get16(eocd + 10);
+    *size = get32(eocd + 12);
+    *offset = get32(eocd + 16);
+
+    free(tail);
+
+    if (*count == 0xFFFF || *size == 0xFFFFFFFF || *offset == 0xFFFFFFFF) {
+        unsigned char locator[ZIP64_LOCATOR_SIZE], eocd64[ZIP64_EOCD_SIZE];
+        uint64_t eocd64_pos;
+
+        if (eocd_pos < ZIP64_LOCATOR_SIZE ||
+            read_at(fd, locator, ZIP64_LOCATOR_SIZE, eocd_pos - ZIP64_LOCATOR_SIZE))
+            goto not_supported;
+
+        eocd64_pos = get64(locator + 8);
+
+        if (get32(locator) != ZIP64_LOCATOR_SIG || get32(locator + 4) || get32(locator + 16) != 1 ||
+            eocd64_pos + ZIP64_EOCD_SIZE > (uint64_t)eocd_pos - ZIP64_LOCATOR_SIZE ||
+            read_at(fd, eocd64, ZIP64_EOCD_SIZE, eocd64_pos))
+            goto not_supported;
+
+        if (get32(eocd64) != ZIP64_EOCD_SIG || get32(eocd64 + 16) || get32(eocd64 + 20))
+            goto not_supported;
+
+        *count = get64(eocd64 + 32);
+        *size = get64(eocd64 + 40);
+        *offset = get64(eocd64 + 48);
+
+        eocd_pos = eocd64_pos;
+    }
+
+    // The central directory immediately precedes the end records
+
+    if (*offset > (uint64_t)eocd_pos || *size != eocd_pos - *offset)
+        goto not_supported;
+
+    return 0;
+
+not_supported:
+    errno = ENOTSUP;
+    return -1;
+}
+
+void zip_free_cd(zip_cd *cd) {
+    free(cd->data);
+    free(cd->entries);
+    free(cd);
+}
+
+int compare_offsets(const void *a, const void *b) {
+    uint64_t off1 = ((const zip_entry *)a)->offset;
+    uint64_t off2 = ((const zip_entry *)b)->offset;
+
+    return off1 < off2 ? -1 : off1 > off2;
+}
+
+
+//// Parsing Central Directory Records
+
+int zip_parse_record(const unsigned char *data, size_t size, zip_entry *ent) {
+    size_t name_len, extra_len, comment_len;
+
+    if (size < ZIP_CD_SIZE || get32(data) != ZIP_CD_SIG)
+        return 0;
+
+    name_len = get16(data + 28);
+    extra_len = get16(data + 30);
+    comment_len = get16(data + 32);
+
+    if (size < ZIP_CD_SIZE + name_len + extra_len + comment_len)
+        return 0;
+
+    ent->record = data;
+    ent->record_size = ZIP_CD_SIZE + name_len + extra_len + comment_len;
+
+    ent->name = (const char *)data + ZIP_CD_SIZE;
+    ent->name_len = name_len;
+    ent->extra = data + ZIP_CD_SIZE + name_len;
+    ent->extra_len = extra_len;
+    ent->comment = ent->extra + extra_len;
+    ent->comment_len = comment_len;
+
+    ent->flags = get16(data + 8);
+    ent->method = get16(data + 10);
+    ent->crc = get32(data + 16);
+    ent->compressed_size = get32(data + 20);
+    ent->size = get32(data + 24);
+    ent->external_attr = get32(data + 38);
+    ent->offset = get32(data + 42);
+
+    // Fields which do not fit in 32 bits are stored, in order, in
+    // the zip64 extra field, in which case they are set to 0xFFFFFFFF.
+
+    for (const unsigned char *p = ent->extra, *end = p + extra_len; end - p >= 4;) {
+        const unsigned char *field = p + 4, *field_end = field + get16(p + 2);
+
+        if (field_end > end) break;
+
+        if (get16(p) == ZIP64_EXTRA_ID) {
+            if (ent->size == 0xFFFFFFFF && field_end - field >= 8) {
+                ent->size = get64(field);
+                field += 8;
+            }
+            if (ent->compressed_size == 0xFFFFFFFF && field_end - field >= 8) {
+                ent->compressed_size = get64(field);
+                field += 8;
+            }
+            if (ent->offset == 0xFFFFFFFF && field_end - field >= 8) {
+                ent->offset = get64(field);
+            }
+
+            break;
+        }
+
+        p = field_end;
+    }
+
+    return 1;
+}
+
+mode_t zip_entry_mode(const zip_entry *ent) {
+    if ((get16(ent->record + 4) >> 8) == ZIP_HOST_UNIX)
+        return ent->external_attr >> 16;
+
+    return 0;
+}
+
+
+//// Copying Entries
+
+int zip_read_local_header(int fd, const zip_entry *ent, zip_buf *extra, uint64_t *data_offset) {
+    unsigned char header[ZIP_LOCAL_SIZE];
+    size_t name_len, extra_len;
+
+    if (read_at(fd, header, ZIP_LOCAL_SIZE, ent->offset))
+        return -1;
+
+    if (get32(header) != ZIP_LOCAL_SIG) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    name_len = get16(header + 26);
+    extra_len = get16(header + 28);
+
+    extra->size = 0;
+
+    if (reserve(extra, extra_len) ||
+        read_at(fd, extra->data, extra_len, ent->offset + ZIP_LOCAL_SIZE + name_len))
+        return -1;
+
+    extra->size = extra_len;
+    *data_offset = ent->offset + ZIP_LOCAL_SIZE + name_len + extra_len;
+
+    return 0;
+}
+
+int zip_make_local_header(zip_buf *buf, const zip_entry *ent, const char *name, size_t name_len, const unsigned char *extra, size_t extra_len) {
+    unsigned char header[ZIP_LOCAL_SIZE];
+    zip_buf fields = {0};
+    int zip64, err = -1;
+
+    if (copy_extra(&fields, extra, extra_len, !same_name(ent, name, name_len)))
+        goto cleanup;
+
+    // The local zip64 field contains both sizes, if either does not
+    // fit in 32 bits.
+
+    if ((zip64 = ent->size >= ZIP_MAX32 || ent->compressed_size >= ZIP_MAX32)) {
+        unsigned char field[20];
+
+        set16(field, ZIP64_EXTRA_ID);
+        set16(field + 2, 16);
+        set64(field + 4, ent->size);
+        set64(field + 12, ent->compressed_size);
+
+        if (zip_buf_append(&fields, field, sizeof(field)))
+            goto cleanup;
+    }
+
+    if (name_len > ZIP_MAX16 || fields.size > ZIP_MAX16) {
+        errno = ENOTSUP;
+        goto cleanup;
+    }
+
+    set32(header, ZIP_LOCAL_SIG);
+    set16(header + 4, version_needed(ent, zip64));
+    set16(header + 6, entry_flags(ent, name, name_len));
+    set16(header + 8, ent->method);
+    memcpy(header + 10, ent->record + 12, 4);
+    set32(header + 14, ent->crc);
+    set32(header + 18, zip64 ? ZIP_MAX32 : ent->compressed_size);
+    set32(header + 22, zip64 ? ZIP_MAX32 : ent->size);
+    set16(header + 26, name_len);
+    set16(header + 28, fields.size);
+
+    if (zip_buf_append(buf, header, ZIP_LOCAL_SIZE) ||
+        zip_buf_append(buf, name, name_len) ||
+        zip_buf_append(buf, fields.data, fields.size))
+        goto cleanup;
+
+    err = 0;
+
+cleanup:
+    zip_buf_free(&fields);
+    return err;
+}
+
+int zip_make_record(zip_buf *buf, const zip_entry *ent, const char *name, size_t name_len, uint64_t offset) {
+    unsigned char record[ZIP_CD_SIZE];
+    unsigned char field[28];
+    size_t field_len = 4;
+    zip_buf fields = {0};
+    int err = -1;
+
+    if (copy_extra(&fields, ent->extra, ent->extra_len, !same_name(ent, name, name_len)))
+        goto cleanup;
+
+    // The central directory zip64 field contains only the values
+    // which do not fit in 32 bits.
+
+    if (ent->size >= ZIP_MAX32) {
+        set64(field + field_len, ent->size);
+        field_len += 8;
+    }
+    if (ent->compressed_size >= ZIP_MAX32) {
+        set64(field + field_len, ent->compressed_size);
+        field_len += 8;
+    }
+    if (offset >= ZIP_MAX32) {
+        set64(field + field_len, offset);
+        field_len += 8;
+    }
+
+    if (field_len > 4) {
+        set16(field, ZIP64_EXTRA_ID);
+        set16(field + 2, field_len - 4);
+
+        if (zip_buf_append(&fields, field, field_len))
+            goto cleanup;
+    }
+
+    if (name_len > ZIP_MAX16 || fields.size > ZIP_MAX16) {
+        errno = ENOTSUP;
+        goto cleanup;
+    }
+
+    set32(record, ZIP_CD_SIG);
+    memcpy(record + 4, ent->record + 4, 2);
+    set16(record + 6, version_needed(ent, field_len > 4));
+    set16(record + 8, entry_flags(ent, name, name_len));
+    set16(record + 10, ent->method);
+    memcpy(record + 12, ent->record + 12, 4);
+    set32(record + 16, ent->crc);
+    set32(record + 20, ent->compressed_size >= ZIP_MAX32 ? ZIP_MAX32 : ent->compressed_size);
+    set32(record + 24, ent->size >= ZIP_MAX32 ? ZIP_MAX32 : ent->size);
+    set16(record + 28, name_len);
+    set16(record + 30, fields.size);
+    set16(record + 32, ent->comment_len);
+    set16(record + 34, 0);
+    memcpy(record + 36, ent->record + 36, 2);
+    set32(record + 38, ent->external_attr);
+    set32(record + 42, offset >= ZIP_MAX32 ? ZIP_MAX32 : offset);
+
+    if (zip_buf_append(buf, record, ZIP_CD_SIZE) ||
+        zip_buf_append(buf, name, name_len) ||
+        zip_buf_append(buf, fields.data, fields.size) ||
+        zip_buf_append(buf, ent->comment, ent->comment_len))
+        goto cleanup;
+
+    err = 0;
+
+cleanup:
+    zip_buf_free(&fields);
+    return err;
+}
+
+int zip_make_end(zip_buf *buf, uint64_t offset, uint64_t size, uint64_t count) {
+    unsigned char eocd[ZIP_EOCD_SIZE];
+
+    if (count >= ZIP_MAX16 || size >= ZIP_MAX32 || offset >= ZIP_MAX32) {
+        unsigned char eocd64[ZIP64_EOCD_SIZE], locator[ZIP64_LOCATOR_SIZE];
+
+        set32(eocd64, ZIP64_EOCD_SIG);
+        set64(eocd64 + 4, ZIP64_EOCD_SIZE - 12);
+        set16(eocd64 + 12, ZIP64_VERSION);
+        set16(eocd64 + 14, ZIP64_VERSION);
+        set32(eocd64 + 16, 0);
+        set32(eocd64 + 20, 0);
+        set64(eocd64 + 24, count);
+        set64(eocd64 + 32, count);
+        set64(eocd64 + 40, size);
+        set64(eocd64 + 48, offset);
+
+        set32(locator, ZIP64_LOCATOR_SIG);
+        set32(locator + 4, 0);
+        set64(locator + 8, offset + size);
+        set32(locator + 16, 1);
+
+        if (zip_buf_append(buf, eocd64, ZIP64_EOCD_SIZE) ||
+            zip_buf_append(buf, locator, ZIP64_LOCATOR_SIZE))
+            return -1;
+    }
+
+    set32(eocd, ZIP_EOCD_SIG);
+    set16(eocd + 4, 0);
+    set16(eocd + 6, 0);
+    set16(eocd + 8, count >= ZIP_MAX16 ? ZIP_MAX16 : count);
+    set16(eocd + 10, count >= ZIP_MAX16 ? ZIP_MAX16 : count);
+    set32(eocd + 12, size >= ZIP_MAX32 ? ZIP_MAX32 : size);
+    set32(eocd + 16, offset >= ZIP_MAX32 ? ZIP_MAX32 : offset);
+    set16(eocd + 20, 0);
+
+    return zip_buf_append(buf, eocd, ZIP_EOCD_SIZE);
+}
+
+int same_name(const zip_entry *ent, const char *name, size_t name_len) {
+    return ent->name_len == name_len && !memcmp(ent->name, name, name_len);
+}
+
+uint16_t entry_flags(const zip_entry *ent, const char *name, size_t name_len) {
+    if (same_name(ent, name, name_len))
+        return ent->flags;
+
+    for (size_t i = 0; i < name_len; i++) {
+        if ((unsigned char)name[i] >= 0x80)
+            return ent->flags | ZIP_FLAG_UTF8;
+    }
+
+    return ent->flags;
+}
+
+uint16_t version_needed(const zip_entry *ent, int zip64) {
+    uint16_t version = get16(ent->record + 6);
+
+    return zip64 && (version & 0xFF) < ZIP64_VERSION ? ZIP64_VERSION : version;
+}
+
+int copy_extra(zip_buf *buf, const unsigned char *extra, size_t extra_len, int renamed) {
+    for (const unsigned char *p = extra, *end = p + extra_len; end - p >= 4;) {
+        uint16_t id = get16(p);
+        size_t size = 4 + get16(p + 2);
+
+        // Truncated fields are dropped
+        if (size > (size_t)(end - p)) break;
+
+        if (id != ZIP64_EXTRA_ID && !(renamed && id == ZIP_UNICODE_PATH_ID)) {
+            if (zip_buf_append(buf, p, size))
+                return -1;
+        }
+
+        p += size;
+    }
+
+    return 0;
+}
+
+
+//// Buffers
+
+int zip_buf_append(zip_buf *buf, const void *data, size_t size) {
+    if (!size) return 0;
+
+    if (reserve(buf, size))
+        return -1;
+
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+
+    return 0;
+}
+
+int reserve(zip_buf *buf, size_t size) {
+    if (buf->capacity - buf->size < size) {
+        size_t capacity = buf->capacity ? buf->capacity : 256;
+        unsigned char *data;
+
+        while (capacity - buf->size < size)
+            capacity *= 2;
+
+        if (!(data = realloc(buf->data, capacity)))
+            return -1;
+
+        buf->data = data;
+        buf->capacity = capacity;
+    }
+
+    return 0;
+}
+
+void zip_buf_free(zip_buf *buf) {
+    free(buf->data);
+
+    buf->data = NULL;
+    buf->size = buf->capacity = 0;
+}
+
+
+//// Utility Functions
+
+uint16_t get16(const unsigned char *p) {
+    return p[0] | (uint16_t)p[1] << 8;
+}
+
+uint32_t get32(const unsigned char *p) {
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+uint64_t get64(const unsigned char *p) {
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+void set16(unsigned char *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+void set32(unsigned char *p, uint32_t value) {
+    set16(p, value & 0xFFFF);
+    set16(p + 2, value >> 16);
+}
+
+void set64(unsigned char *p, uint64_t value) {
+    set32(p, value & 0xFFFFFFFF);
+    set32(p + 4, value >> 32);
+}
+
+int read_at(int fd, void *buf, size_t size, off_t offset) {
+    char *data = buf;
+
+    while (size) {
+        ssize_t n = pread(fd, data, size, offset);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        if (!n) {
+            errno = ENOTSUP;
+            return -1;
+        }
+
+        data += n;
+        offset += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
+/* Local Variables: */
+/* indent-tabs-mode: nil */
+/* End: */
@@ -0,0 +1,268 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_PLUGINS_ARCHGENERIC_ZIP_H
+#define NUC_PLUGINS_ARCHGENERIC_ZIP_H
+
+/**
+ * Direct access to the central directory, and the raw entry data, of
+ * zip archives.
+ *
+ * Libarchive reads the central directory of a zip archive, however
+ * it does not expose the offsets of the entries, thus it cannot be
+ * used to position the archive at a particular entry. Neither does
+ * it provide access to the compressed data of an entry, thus it
+ * cannot be used to copy an entry without recompressing it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+/**
+ * General purpose flags: Entry is encrypted, and the CRC-32 and sizes
+ * are stored in a data descriptor following the entry's data.
+ */
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_FLAG_DESCRIPTOR 0x0008
+
+/**
+ * Central directory entry.
+ */
+typedef struct zip_entry {
+    /**
+     * The entry's record in the central directory, and its size.
+     */
+    const unsigned char *record;
+    size_t record_size;
+
+    /**
+     * Name of the entry, which is not NULL-terminated, and its
+     * length.
+     */
+    const char *name;
+    size_t name_len;
+
+    /**
+     * Extra field data and comment, and their sizes.
+     */
+    const unsigned char *extra;
+    size_t extra_len;
+
+    const unsigned char *comment;
+    size_t comment_len;
+
+    /**
+     * General purpose flags, compression method, CRC-32 and
+     * external attributes.
+     */
+    uint16_t flags;
+    uint16_t method;
+    uint32_t crc;
+    uint32_t external_attr;
+
+    /**
+     * Compressed and uncompressed size of the entry's data.
+     */
+    uint64_t compressed_size;
+    uint64_t size;
+
+    /**
+     * Offset of the entry's local header within the archive file.
+     */
+    uint64_t offset;
+} zip_entry;
+
+/**
+ * Central directory of a zip archive.
+ */
+typedef struct zip_cd {
+    /**
+     * Raw central directory data.
+     */
+    unsigned char *data;
+
+    /**
+     * Array of entries, sorted by the offsets of their local
+     * headers, and the number of entries.
+     */
+    zip_entry *entries;
+    size_t count;
+} zip_cd;
+
+
+/**
+ * Growable byte buffer.
+ */
+typedef struct zip_buf {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} zip_buf;
+
+
+/**
+ * Reads the central directory of a zip archive.
+ *
+ * Archives spanning multiple disks, and archives with data preceding
+ * the first entry, such as self-extracting archives, are not
+ * supported.
+ *
+ * @param fd File descriptor of the archive file.
+ *
+ * @return The central directory, which should be freed with
+ *   zip_free_cd, or NULL if it could not be read. If the file is not
+ *   a supported zip archive, errno is set to ENOTSUP.
+ */
+zip_cd *zip_read_cd(int fd);
+
+/**
+ * Frees a central directory read with zip_read_cd.
+ *
+ * @param cd The central directory.
+ */
+void zip_free_cd(zip_cd *cd);
+
+/**
+ * Parses a central directory record.
+ *
+ * @param data Pointer to the record.
+ * @param size Number of bytes available at @a data.
+ * @param ent The entry into which the record is parsed.
+ *
+ * @return Non-zero if the record was parsed, zero if @a data does
+ *   not contain a complete record.
+ */
+int zip_parse_record(const unsigned char *data, size_t size, zip_entry *ent);
+
+/**
+ * Returns the file mode of an entry, if it was stored by an archiver
+ * which stores Unix file modes.
+ *
+ * @param ent The entry.
+ *
+ * @return The mode or zero if the entry does not have a Unix mode.
+ */
+mode_t zip_entry_mode(const zip_entry *ent);
+
+/**
+ * Reads the local header of an entry.
+ *
+ * @param fd File descriptor of the archive file.
+ * @param ent The entry.
+ *
+ * @param extra Buffer into which the extra field data of the local
+ *   header is read. The buffer is cleared first.
+ *
+ * @param data_offset Set to the offset of the entry's data.
+ *
+ * @return Zero if successful, -1 otherwise. If the local header is
+ *   invalid errno is set to ENOTSUP.
+ */
+int zip_read_local_header(int fd, const zip_entry *ent, zip_buf *extra, uint64_t *data_offset);
+
+/**
+ * Creates a local header for an entry, which is to be copied with
+ * its data unmodified.
+ *
+ * The sizes and CRC-32 are always stored in the header, thus the
+ * data descriptor following the entry's data, if any, should not be
+ * copied and the ZIP_FLAG_DESCRIPTOR flag should be cleared in the
+ * entry's flags.
+ *
+ * If the name differs from the entry's original name, the Info-ZIP
+ * Unicode path field is removed, and if the name is not ASCII, it is
+ * flagged as being UTF-8 encoded.
+ *
+ * @param buf Buffer to which the header is appended.
+ *
+ * @param ent Central directory entry of the entry.
+ *
+ * @param name Name of the entry in the new archive and its length.
+ * @param name_len
+ *
+ * @param extra Extra field data of the entry's original local header
+ *   and its size.
+ * @param extra_len
+ *
+ * @return Zero if successful, -1 otherwise. If the name or extra
+ *   field is too long, errno is set to ENOTSUP.
+ */
+int zip_make_local_header(zip_buf *buf, const zip_entry *ent, const char *name, size_t name_len, const unsigned char *extra, size_t extra_len);
+
+/**
+ * Creates a central directory record for an entry, which is to be
+ * copied with its data unmodified, or of which the local header is
+ * moved to a different offset.
+ *
+ * The name is handled in the same way as by zip_make_local_header.
+ *
+ * @param buf Buffer to which the record is appended.
+ *
+ * @param ent Central directory entry of the entry.
+ *
+ * @param name Name of the entry in the new archive and its length.
+ * @param name_len
+ *
+ * @param offset Offset of the entry's local header in the new
+ *   archive.
+ *
+ * @return Zero if successful, -1 otherwise. If the name or extra
+ *   field is too long, errno is set to ENOTSUP.
+ */
+int zip_make_record(zip_buf *buf, const zip_entry *ent, const char *name, size_t name_len, uint64_t offset);
+
+/**
+ * Creates the end of central directory record, preceded by the zip64
+ * end of central directory record and locator if necessary.
+ *
+ * @param buf Buffer to which the records are appended.
+ *
+ * @param offset Offset of the central directory.
+ * @param size Size of the central directory.
+ * @param count Number of entries in the central directory.
+ *
+ * @return Zero if successful, -1 otherwise.
+ */
+int zip_make_end(zip_buf *buf, uint64_t offset, uint64_t size, uint64_t count);
+
+/**
+ * Appends data to a buffer.
+ *
+ * @param buf The buffer.
+ * @param data The data to append.
+ * @param size Size of the data.
+ *
+ * @return Zero if successful, -1 if memory could not be allocated.
+ */
+int zip_buf_append(zip_buf *buf, const void *data, size_t size);
+
+/**
+ * Frees the memory allocated for a buffer, and clears it.
+ *
+ * @param buf The buffer.
+ */
+void zip_buf_free(zip_buf *buf);
+
+#endif /* NUC_PLUGINS_ARCHGENERIC_ZIP_H */
+
+/* Local Variables: */
+/* mode: c */
+/* End: */
@@ -23,6 +23,7 @@
 
 
 #define LOAD_CHECK_FN(name) name = (name ## _fn)dlsym(dl_handle, "nuc_arch_"#name); check_error(error::api_incomplete);
+#define LOAD_OPTIONAL_FN(name) name = (name ## _fn)dlsym(dl_handle, "nuc_arch_"#name); dlerror();
 
 
 using namespace nuc;
@@ -46,19 +47,25 @@ void archive_plugin::load() {
 
         LOAD_CHECK_FN(open_unpack);
         LOAD_CHECK_FN(open_pack);
+        LOAD_OPTIONAL_FN(open_append);
+        LOAD_OPTIONAL_FN(abort_append);
 
         LOAD_CHECK_FN(error_code);
         LOAD_CHECK_FN(error_string);
 
         LOAD_CHECK_FN(next_entry);
+        LOAD_OPTIONAL_FN(seek_entry);
         LOAD_CHECK_FN(entry_stat);
         LOAD_CHECK_FN(entry_link_path);
         LOAD_CHECK_FN(entry_symlink_path);
         LOAD_CHECK_FN(unpack);
 
         LOAD_CHECK_FN(copy_archive_type);
+        LOAD_OPTIONAL_FN(set_threads);
+        LOAD_OPTIONAL_FN(streams_unknown_size);
         LOAD_CHECK_FN(copy_last_entry_header);
         LOAD_CHECK_FN(copy_last_entry_data);
+        LOAD_OPTIONAL_FN(copy_last_entry_raw);
 
         LOAD_CHECK_FN(create_entry);
         LOAD_CHECK_FN(entry_set_path);
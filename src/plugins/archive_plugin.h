@@ -47,11 +47,14 @@ namespace nuc {
 
         typedef void*(*open_unpack_fn)(nuc_arch_read_callback, nuc_arch_skip_callback, void *, int *);
         typedef void*(*open_pack_fn)(nuc_arch_write_callback, void *, int *);
+        typedef void*(*open_append_fn)(const char *, int *);
+        typedef int(*abort_append_fn)(void *);
 
         typedef int(*error_code_fn)(void *);
         typedef const char *(*error_string_fn)(void *);
 
         typedef int(*next_entry_fn)(void *, const char **);
+        typedef int(*seek_entry_fn)(void *, const char *);
         typedef const struct stat *(*entry_stat_fn)(void *);
         typedef const char *(*entry_link_path_fn)(void *);
         typedef const char *(*entry_symlink_path_fn)(void *);
@@ -59,8 +62,11 @@ namespace nuc {
         typedef int(*unpack_fn)(void *, const char **, size_t *, off_t *);
 
         typedef int(*copy_archive_type_fn)(void *, const void *);
+        typedef int(*set_threads_fn)(void *, int);
+        typedef int(*streams_unknown_size_fn)(void *);
         typedef int(*copy_last_entry_header_fn)(void *, const void *);
         typedef int(*copy_last_entry_data_fn)(void *, const void *);
+        typedef int(*copy_last_entry_raw_fn)(void *, void *, const char *);
 
         typedef int(*create_entry_fn)(void *, const char *, const struct stat *);
         typedef void(*entry_set_path_fn)(void *, const char *);
@@ -150,11 +156,17 @@ namespace nuc {
 
         open_unpack_fn open_unpack;
         open_pack_fn open_pack;
+        /** Optional, nullptr if not implemented by the plugin. */
+        open_append_fn open_append = nullptr;
+        /** Optional, nullptr if not implemented by the plugin. */
+        abort_append_fn abort_append = nullptr;
 
         error_code_fn error_code;
         error_string_fn error_string;
 
         next_entry_fn next_entry;
+        /** Optional, nullptr if not implemented by the plugin. */
+        seek_entry_fn seek_entry = nullptr;
         entry_stat_fn entry_stat;
         entry_link_path_fn entry_link_path;
         entry_symlink_path_fn entry_symlink_path;
@@ -162,8 +174,14 @@ namespace nuc {
         unpack_fn unpack;
 
         copy_archive_type_fn copy_archive_type;
+        /** Optional, nullptr if not implemented by the plugin. */
+        set_threads_fn set_threads = nullptr;
+        /** Optional, nullptr if not implemented by the plugin. */
+        streams_unknown_size_fn streams_unknown_size = nullptr;
         copy_last_entry_header_fn copy_last_entry_header;
         copy_last_entry_data_fn copy_last_entry_data;
+        /** Optional, nullptr if not implemented by the plugin. */
+        copy_last_entry_raw_fn copy_last_entry_raw = nullptr;
 
         create_entry_fn create_entry;
         entry_set_path_fn entry_set_path;
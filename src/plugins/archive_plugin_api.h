@@ -129,6 +129,38 @@ void *nuc_arch_open_unpack(nuc_arch_read_callback read_fn, nuc_arch_skip_callbac
  */
 int nuc_arch_next_entry(void *handle, const char ** path);
 
+/**
+ * Positions the archive at the entry with path @a path, so that it
+ * becomes the current entry as if it were returned by
+ * nuc_arch_next_entry.
+ *
+ * This function is optional. It should locate the entry using a
+ * central directory, or an index, without reading the preceding
+ * entries. If the entry cannot be located in this way, for a
+ * particular archive, the function should fail with errno set to
+ * ENOTSUP, without modifying the state of the handle, in which case
+ * the entries are read sequentially by the host.
+ *
+ * The function is only called on a handle from which no entries have
+ * been read. Entry paths are compared after canonicalization, see
+ * pathname::canonicalize. If there are multiple entries with the same
+ * path, the archive is positioned at the first one, in the order in
+ * which they would be returned by nuc_arch_next_entry. The entries
+ * following it can then be read with nuc_arch_next_entry.
+ *
+ * @param handle The handle to the archive.
+ *
+ * @param path Canonical path to the entry, relative to the archive
+ *   root.
+ *
+ * @return NUC_AP_OK (0) if successful, NUC_AP_EOF if there is no
+ *    entry with path @a path, otherwise a NUC_AP_ error constant
+ *    value if there was an error. In either of the latter cases no
+ *    further entries may be read from the archive, unless errno is
+ *    ENOTSUP.
+ */
+int nuc_arch_seek_entry(void *handle, const char *path);
+
 /**
  * Returns the stat attributes of the current entry, read using
  * nuch_arch_next_entry.
@@ -214,6 +246,53 @@ void nuc_arch_set_callback(void *handle, nuc_arch_progress_fn callback, void *ct
  */
 void *nuc_arch_open_pack(nuc_arch_write_callback write_fn, void *ctx, int *error);
 
+/**
+ * Opens an existing archive for appending entries to it in place,
+ * without rewriting the existing entries.
+ *
+ * Entries are added to the returned handle, as with a handle opened
+ * with NUC_AP_MODE_PACK, however the archive type is that of the
+ * existing archive and need not be set. Any trailing metadata, such
+ * as an end-of-archive marker or a central directory, is rewritten
+ * when the handle is closed.
+ *
+ * If closing the handle fails, the archive file is restored to its
+ * original state. To discard the appended entries, for example after
+ * an error, the handle should be closed with nuc_arch_abort_append
+ * instead.
+ *
+ * This function is optional, and should only be implemented together
+ * with nuc_arch_abort_append.
+ *
+ * @param file Path to the archive file.
+ *
+ * @param error Pointer to an integer which will store the error code
+ *   if any.
+ *
+ * @return Handle to the archive or NULL if the archive could not be
+ *   opened for appending, in which case an appropriate NUC_AP_ error
+ *   code is stored in the location pointed to by @a error. If the
+ *   archive's format does not support appending, errno is set to
+ *   ENOTSUP and the archive is not modified.
+ */
+void *nuc_arch_open_append(const char *file, int *error);
+
+/**
+ * Closes an archive handle, opened with nuc_arch_open_append, and
+ * discards the entries appended to it, restoring the archive file to
+ * the state in which it was before it was opened.
+ *
+ * This function is optional, and must be implemented if
+ * nuc_arch_open_append is implemented.
+ *
+ * @param handle Handle to the archive.
+ *
+ * @return NUC_AP_OK (0) if the archive file was restored. A NUC_AP_
+ *   error constant value is returned if there was an error, with a
+ *   more detailed error code stored in errno.
+ */
+int nuc_arch_abort_append(void *handle);
+
 /**
  * Copies the archive type of the open, for unpacking, archive @a
  * src_handle to the destination archive, open for packing, @a
@@ -234,6 +313,42 @@ void *nuc_arch_open_pack(nuc_arch_write_callback write_fn, void *ctx, int *error
  */
 int nuc_arch_copy_archive_type(void *dest_handle, const void *src_handle);
 
+/**
+ * Sets the number of threads used to compress the data written to an
+ * archive, open for packing.
+ *
+ * This function is optional, and must be called before the archive's
+ * type is set with nuc_arch_copy_archive_type. The plugin may use
+ * fewer threads than requested, or a single thread, if the archive
+ * type does not support parallel compression.
+ *
+ * @param handle The handle of the archive.
+ *
+ * @param threads Number of compression threads. If 0, a thread is
+ *    used for each available processor.
+ *
+ * @return NUC_AP_OK (0) if the thread count was set successfully. A
+ *    NUC_AP_ error constant value is returned if there was an error,
+ *    with a more detailed error code stored in errno.
+ */
+int nuc_arch_set_threads(void *handle, int threads);
+
+/**
+ * Checks whether the data of entries of unknown size, which are
+ * created with a size of 0, is written directly to an archive open
+ * for packing. Otherwise the data is buffered until the entry is
+ * finished, in order to determine its size.
+ *
+ * This function is optional, and should only be called after the
+ * archive's type is set.
+ *
+ * @param handle The handle of the archive.
+ *
+ * @return Non-zero if entries of unknown size are written directly,
+ *   zero otherwise.
+ */
+int nuc_arch_streams_unknown_size(void *handle);
+
 /**
  * Copies the header, i.e. the metadata, of the last entry read from
  * the archive with handle @a src_handle, into the archive handle @a
@@ -274,6 +389,35 @@ int nuc_arch_copy_last_entry_header(void *dest_handle, const void *src_handle);
  */
 int nuc_arch_copy_last_entry_data(void *dest_handle, void *src_handle);
 
+/**
+ * Copies the last entry, read from the archive with handle @a
+ * src_handle, into the archive with handle @a dest_handle, with its
+ * data copied verbatim in its compressed form, along with its
+ * checksum, rather than being decompressed and recompressed.
+ *
+ * This function is optional. It replaces the calls to
+ * nuc_arch_copy_last_entry_header, nuc_arch_write_entry_header and
+ * nuc_arch_copy_last_entry_data, and should only be implemented for
+ * formats in which each entry is compressed separately, such as zip
+ * and 7z.
+ *
+ * @param dest_handle Handle of the destination archive into which to
+ *   copy the entry.
+ *
+ * @param src_handle Handle of the source archive from which to copy
+ *   the entry.
+ *
+ * @param path The path under which the entry is created in the
+ *   destination archive, or NULL if its path should be the same.
+ *
+ * @return NUC_AP_OK (0) if the entry was copied successfully. If the
+ *    entry cannot be copied verbatim, NUC_AP_FAILED is returned with
+ *    errno set to ENOTSUP, and neither archive is modified. A
+ *    NUC_AP_ error constant value is returned if there was an error,
+ *    with a more detailed error code stored in errno.
+ */
+int nuc_arch_copy_last_entry_raw(void *dest_handle, void *src_handle, const char *path);
+
 
 /**
  * Creates a new entry, the attributes of which can be set using the
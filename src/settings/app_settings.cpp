@@ -28,6 +28,12 @@ app_settings &app_settings::instance() {
 
 app_settings::app_settings() : m_settings(Gio::Settings::create(settings_id)) {
     m_dir_refresh_timeout = m_settings->get_int("dir-refresh-timeout");
+    m_io_block_size = m_settings->get_int("io-block-size");
+    m_stream_threshold = m_settings->get_int("stream-threshold");
+    m_direct_io = m_settings->get_boolean("direct-io");
+    m_preallocate_files = m_settings->get_boolean("preallocate-files");
+    m_dir_cache_size = m_settings->get_int("dir-cache-size");
+    m_compression_threads = m_settings->get_int("compression-threads");
 }
 
 
@@ -41,6 +47,66 @@ void app_settings::dir_refresh_timeout(int timeout) {
 }
 
 
+size_t app_settings::io_block_size() const {
+    return m_io_block_size;
+}
+
+void app_settings::io_block_size(size_t size) {
+    m_settings->set_int("io-block-size", size);
+    m_io_block_size = size;
+}
+
+
+size_t app_settings::stream_threshold() const {
+    return m_stream_threshold;
+}
+
+void app_settings::stream_threshold(size_t size) {
+    m_settings->set_int("stream-threshold", size);
+    m_stream_threshold = size;
+}
+
+
+bool app_settings::direct_io() const {
+    return m_direct_io;
+}
+
+void app_settings::direct_io(bool flag) {
+    m_settings->set_boolean("direct-io", flag);
+    m_direct_io = flag;
+}
+
+
+bool app_settings::preallocate_files() const {
+    return m_preallocate_files;
+}
+
+void app_settings::preallocate_files(bool flag) {
+    m_settings->set_boolean("preallocate-files", flag);
+    m_preallocate_files = flag;
+}
+
+
+size_t app_settings::dir_cache_size() const {
+    return m_dir_cache_size;
+}
+
+void app_settings::dir_cache_size(size_t size) {
+    m_settings->set_int("dir-cache-size", size);
+    m_dir_cache_size = size;
+}
+
+
+int app_settings::compression_threads() const {
+    return m_compression_threads;
+}
+
+void app_settings::compression_threads(int threads) {
+    m_settings->set_int("compression-threads", threads);
+    m_compression_threads = threads;
+}
+
+
 std::vector<std::string> app_settings::columns() const {
     return m_settings->get_string_array("columns");
 }
@@ -20,6 +20,8 @@
 #ifndef NUC_SETTINGS_APP_SETTINGS_H
 #define NUC_SETTINGS_APP_SETTINGS_H
 
+#include <atomic>
+
 #include <giomm/settings.h>
 
 #if GLIBMM_MAJOR_VERSION == 2 && GLIBMM_MINOR_VERSION < 54
@@ -27,6 +29,14 @@
 #endif
 
 namespace nuc {
+    /**
+     * Application settings.
+     *
+     * The values of the settings which are read by background
+     * threads, such as the copy and stat worker threads, are cached
+     * in atomic variables, so that they can be read while they are
+     * changed on the main thread.
+     */
     class app_settings {
     public:
         app_settings();
@@ -90,6 +100,109 @@ namespace nuc {
         void default_sort_column(const std::string &column);
 
 
+        /**
+         * Returns the block size to use when reading files.
+         *
+         * @return The block size in bytes, 0 if the block size
+         *   should be determined automatically.
+         */
+        size_t io_block_size() const;
+
+        /**
+         * Sets the block size to use when reading files.
+         *
+         * @param size The block size in bytes, 0 to determine the
+         *   block size automatically.
+         */
+        void io_block_size(size_t size);
+
+
+        /**
+         * Returns the minimum size of files which are read and
+         * written without filling the page cache.
+         *
+         * @return The size in MiB, 0 if files should always be
+         *   cached.
+         */
+        size_t stream_threshold() const;
+
+        /**
+         * Sets the minimum size of files which are read and written
+         * without filling the page cache.
+         *
+         * @param size The size in MiB, 0 to always cache files.
+         */
+        void stream_threshold(size_t size);
+
+
+        /**
+         * Returns true if files, at least as large as the stream
+         * threshold, should be read with direct I/O.
+         *
+         * @return True if direct I/O should be used.
+         */
+        bool direct_io() const;
+
+        /**
+         * Sets whether files, at least as large as the stream
+         * threshold, should be read with direct I/O.
+         *
+         * @param flag True if direct I/O should be used.
+         */
+        void direct_io(bool flag);
+
+
+        /**
+         * Returns true if the space for files being copied should be
+         * preallocated.
+         *
+         * @return True if files should be preallocated.
+         */
+        bool preallocate_files() const;
+
+        /**
+         * Sets whether the space for files being copied should be
+         * preallocated.
+         *
+         * @param flag True if files should be preallocated.
+         */
+        void preallocate_files(bool flag);
+
+
+        /**
+         * Returns the maximum amount of memory occupied by the
+         * cached listings of previously visited directories.
+         *
+         * @return The size in MiB, 0 if listings are not cached.
+         */
+        size_t dir_cache_size() const;
+
+        /**
+         * Sets the maximum amount of memory occupied by the cached
+         * listings of previously visited directories.
+         *
+         * @param size The size in MiB, 0 to disable caching.
+         */
+        void dir_cache_size(size_t size);
+
+
+        /**
+         * Returns the number of threads used to compress archives.
+         *
+         * @return The number of threads, 0 if a thread is used for
+         *   each available processor.
+         */
+        int compression_threads() const;
+
+        /**
+         * Sets the number of threads used to compress archives.
+         *
+         * @param threads The number of threads, 0 to use a thread
+         *   for each available processor.
+         */
+        void compression_threads(int threads);
+
+
         /**
          * Returns the keybindings map.
          *
@@ -111,7 +224,37 @@ namespace nuc {
         /**
          * Cached value of the directory refresh timeout.
          */
-        int m_dir_refresh_timeout;
+        std::atomic<int> m_dir_refresh_timeout;
+
+        /**
+         * Cached value of the I/O block size.
+         */
+        std::atomic<size_t> m_io_block_size;
+
+        /**
+         * Cached value of the stream threshold.
+         */
+        std::atomic<size_t> m_stream_threshold;
+
+        /**
+         * Cached value of the direct I/O flag.
+         */
+        std::atomic<bool> m_direct_io;
+
+        /**
+         * Cached value of the preallocate files flag.
+         */
+        std::atomic<bool> m_preallocate_files;
+
+        /**
+         * Cached value of the directory cache size.
+         */
+        std::atomic<size_t> m_dir_cache_size;
+
+        /**
+         * Cached value of the number of compression threads.
+         */
+        std::atomic<int> m_compression_threads;
     };
 }
 
@@ -21,6 +21,8 @@
 
 #include "stream/archive_outstream.h"
 
+#include "settings/app_settings.h"
+
 #include "error_macros.h"
 
 using namespace nuc;
@@ -109,9 +111,22 @@ void archive_dir_writer::close_handles() {
 }
 
 void archive_dir_writer::close() {
+    if (!old_modified && plugin->open_append && plugin->abort_append && append_new_entries())
+        return;
+
     open_old();
     copy_old_entries();
+    close_out_handle();
+
+    // TODO: copy attributes of old archive file.
 
+    TRY_OP(::rename(tmp_path.c_str(), path.path().c_str()));
+
+    tmp_exists = false;
+}
+
+
+void archive_dir_writer::close_out_handle() {
     if (out_handle) {
         int err = plugin->close(out_handle);
         out_handle = nullptr;
@@ -119,15 +134,62 @@ void archive_dir_writer::close() {
         if (err)
             raise_error(errno, false);
     }
+}
 
-    // TODO: copy attributes of old archive file.
 
-    TRY_OP(::rename(tmp_path.c_str(), path.path().c_str()));
+bool archive_dir_writer::streams_unknown_size() const {
+    return out_handle && plugin->streams_unknown_size && plugin->streams_unknown_size(out_handle);
+}
+
+
+//// Appending new entries to old archive
+
+bool archive_dir_writer::append_new_entries() {
+    int err;
+    void *handle = plugin->open_append(path.path().c_str(), &err);
+
+    // The archive is rewritten if it cannot be appended to
+    if (!handle)
+        return false;
+
+    try {
+        close_out_handle();
+
+        archive_lister new_entries(plugin, tmp_path);
+        lister::entry ent;
+
+        while (new_entries.read_entry(ent)) {
+            TRY_OP_((err = plugin->copy_last_entry_header(handle, new_entries.arch_handle())),
+                    raise_error(errno, err));
 
+            TRY_OP_((err = plugin->write_entry_header(handle)),
+                    raise_plugin_error(handle, err));
+
+            TRY_OP_((err = plugin->copy_last_entry_data(handle, new_entries.arch_handle())),
+                    raise_error(errno, err));
+        }
+    }
+    catch (...) {
+        // Restore the archive to its original state, rather than
+        // leaving a partially written entry in place of the
+        // end-of-archive marker.
+
+        plugin->abort_append(handle);
+        throw;
+    }
+
+    // If closing fails, the archive is restored by the plugin
+
+    if ((err = plugin->close(handle)))
+        raise_error(errno, false);
+
+    unlink(tmp_path.c_str());
     tmp_exists = false;
+
+    return true;
 }
 
-
+
 //// Copying entries from old archive to new archive
 
 void archive_dir_writer::get_old_entries() {
@@ -172,6 +234,13 @@ bool archive_dir_writer::add_old_entry(const pathname &path, int type) {
 }
 
 void archive_dir_writer::copy_archive_type() {
+    if (plugin->set_threads) {
+        try_op([=] {
+            if (int err = plugin->set_threads(out_handle, app_settings::instance().compression_threads()))
+                raise_error(errno, err);
+        });
+    }
+
     try_op([=] {
         if (int err = plugin->copy_archive_type(out_handle, in_lister->arch_handle()))
             // TODO: Obtain error description
@@ -187,6 +256,9 @@ void archive_dir_writer::copy_old_entries() {
         auto it = old_entries.find(pathname(ent.name).canonicalize());
 
         if (it != old_entries.end()) {
+            if (copy_raw_entry(it->second.new_path.empty() ? nullptr : it->second.new_path.c_str()))
+                continue;
+
             // FIXME: Get proper error code and error description
 
             TRY_OP_((err = plugin->copy_last_entry_header(out_handle, in_lister->arch_handle())),
@@ -206,6 +278,23 @@ void archive_dir_writer::copy_old_entries() {
     }
 }
 
+bool archive_dir_writer::copy_raw_entry(const char *new_path) {
+    bool copied = false;
+
+    if (plugin->copy_last_entry_raw) {
+        try_op([&] {
+            int err = plugin->copy_last_entry_raw(out_handle, in_lister->arch_handle(), new_path);
+
+            if (!err)
+                copied = true;
+            else if (errno != ENOTSUP)
+                raise_error(errno, err);
+        });
+    }
+
+    return copied;
+}
+
 bool archive_dir_writer::next_entry(lister::entry &ent) {
     bool more = false;
 
@@ -307,6 +396,7 @@ void archive_dir_writer::remove_old_entry(pathname path) {
         bool is_dir = it->second.type == DT_DIR;
 
         it = old_entries.erase(it);
+        old_modified = true;
 
         if (is_dir) {
             path = pathname(path, true);
@@ -328,6 +418,7 @@ void archive_dir_writer::rename(const pathname &src, const pathname &dest) {
 
     if (it != old_entries.end()) {
         it->second.new_path = dest;
+        old_modified = true;
 
         if (it->second.type == DT_DIR) {
             size_t dir_len = src_path.path().length() + 1;
@@ -67,6 +67,10 @@ namespace nuc {
          * file over the old archive file, if its handle was closed
          * successfully.
          *
+         * If entries were only added to the archive, and the plugin
+         * supports appending to the archive, the new entries are
+         * instead appended to the old archive file in place.
+         *
          * This method should be called explicitly as it is not called
          * from the destructor.
          */
@@ -85,6 +89,8 @@ namespace nuc {
 
         virtual void remove(const pathname &path, bool relative);
 
+        virtual bool streams_unknown_size() const;
+
     protected:
         /**
          * Plugin for writing to the archive.
@@ -151,6 +157,13 @@ namespace nuc {
          */
         std::map<pathname, old_entry> old_entries;
 
+        /**
+         * Flag: True if any of the entries already in the archive
+         * were removed, replaced or renamed, in which case the
+         * archive has to be rewritten rather than appended to.
+         */
+        bool old_modified = false;
+
 
         /**
          * Constructs an archive_dir_writer without opening an archive
@@ -192,6 +205,11 @@ namespace nuc {
          */
         void close_handles();
 
+        /**
+         * Closes the handle of the new archive.
+         */
+        void close_out_handle();
+
 
         using dir_writer::raise_error;
 
@@ -233,6 +251,20 @@ namespace nuc {
          */
         void open_temp();
 
+        /**
+         * Appends the new entries, which were written to the
+         * temporary archive, to the old archive file in place.
+         *
+         * If an error occurs while appending, the old archive is
+         * restored to its original state before the error is
+         * rethrown.
+         *
+         * @return True if the entries were appended. False if the
+         *   plugin does not support appending to the archive, in
+         *   which case the old archive is not modified.
+         */
+        bool append_new_entries();
+
         /**
          * Adds the parent directory entries of the entry with subpath
          * @path to the old_entries map.
@@ -264,6 +296,19 @@ namespace nuc {
          */
         void copy_archive_type();
 
+        /**
+         * Copies the last entry read from the old archive to the new
+         * archive, with its data copied in its compressed form, if
+         * supported by the plugin.
+         *
+         * @param new_path The path under which to create the entry,
+         *   nullptr if the path is unchanged.
+         *
+         * @return True if the entry was copied, false if it should be
+         *   copied by decompressing and recompressing its data.
+         */
+        bool copy_raw_entry(const char *new_path);
+
         /**
          * Retrieve the metadata of the the next entry.
          *
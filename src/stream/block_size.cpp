@@ -0,0 +1,230 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "block_size.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef __APPLE__
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+
+#include "settings/app_settings.h"
+
+using namespace nuc;
+
+
+/**
+ * Block size used if the device type is unknown.
+ */
+static constexpr size_t default_block_size = 131072;
+
+/**
+ * Block size used for files on solid state drives.
+ */
+static constexpr size_t ssd_block_size = 262144;
+
+/**
+ * Block size used for files on rotational drives and network file
+ * systems, where the cost of each request is high.
+ */
+static constexpr size_t large_block_size = 1048576;
+
+/**
+ * Minimum and maximum block sizes which can be set in the
+ * application settings.
+ */
+static constexpr size_t min_block_size = 4096;
+static constexpr size_t max_block_size = 67108864;
+
+
+/**
+ * Determines the type of the device on which a file is stored,
+ * without consulting the cache.
+ *
+ * @param fd File descriptor of the file.
+ * @param st Stat attributes of the file.
+ *
+ * @return The device type.
+ */
+static device_type find_device_type(int fd, const struct stat &st);
+
+/**
+ * Rounds @a size up to the nearest multiple of @a unit.
+ *
+ * @param size The size to round.
+ * @param unit The unit, which must be non-zero.
+ *
+ * @return The rounded size.
+ */
+static size_t round_up(size_t size, size_t unit);
+
+
+//// Device Type
+
+device_type nuc::get_device_type(int fd, const struct stat &st) {
+    static std::mutex mutex;
+    static std::unordered_map<dev_t, device_type> types;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = types.find(st.st_dev);
+
+    if (it == types.end()) {
+        it = types.emplace(st.st_dev, find_device_type(fd, st)).first;
+    }
+
+    return it->second;
+}
+
+#ifdef __linux__
+
+/**
+ * Magic numbers, returned in the f_type field by statfs, of network
+ * file systems.
+ */
+static constexpr unsigned long network_fs_types[] = {
+    0x6969,                     // NFS
+    0x517B,                     // SMB
+    0xFF534D42,                 // CIFS
+    0xFE534D42,                 // SMB2
+    0x73757245,                 // Coda
+    0x5346414F,                 // AFS
+    0x01021997,                 // 9P
+    0x00C36400                  // Ceph
+};
+
+/**
+ * Reads the rotational flag of a block device from sysfs.
+ *
+ * @param dev The device number.
+ *
+ * @param rotational Reference to the variable in which the flag is
+ *   stored.
+ *
+ * @return True if the flag was read successfully.
+ */
+static bool read_rotational(dev_t dev, bool &rotational) {
+    std::string dir = "/sys/dev/block/" + std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+
+    // Partitions do not have a queue directory, the queue of the
+    // parent device is used instead.
+
+    for (const char *path : {"/queue/rotational", "/../queue/rotational"}) {
+        std::ifstream file(dir + path);
+        int flag;
+
+        if (file >> flag) {
+            rotational = flag;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+device_type find_device_type(int fd, const struct stat &st) {
+    struct statfs sfs;
+
+    if (!fstatfs(fd, &sfs)) {
+        for (unsigned long type : network_fs_types) {
+            if ((unsigned long)sfs.f_type == type)
+                return device_network;
+        }
+    }
+
+    bool rotational;
+
+    if (read_rotational(st.st_dev, rotational))
+        return rotational ? device_hdd : device_ssd;
+
+    return device_unknown;
+}
+
+#elif defined(__APPLE__)
+
+device_type find_device_type(int fd, const struct stat &st) {
+    struct statfs sfs;
+
+    if (!fstatfs(fd, &sfs) && !(sfs.f_flags & MNT_LOCAL))
+        return device_network;
+
+    return device_unknown;
+}
+
+#else
+
+device_type find_device_type(int fd, const struct stat &st) {
+    return device_unknown;
+}
+
+#endif
+
+
+//// Block Size
+
+size_t round_up(size_t size, size_t unit) {
+    return ((size + unit - 1) / unit) * unit;
+}
+
+size_t nuc::block_size_for(const struct stat &st, device_type type) {
+    size_t unit = st.st_blksize > 0 ? st.st_blksize : min_block_size;
+    size_t size;
+
+    switch (type) {
+    case device_ssd:
+        size = ssd_block_size;
+        break;
+
+    case device_hdd:
+    case device_network:
+        size = large_block_size;
+        break;
+
+    default:
+        size = default_block_size;
+        break;
+    }
+
+    // Regular files smaller than the block size are read in a
+    // single block which is no larger than the file.
+
+    if (S_ISREG(st.st_mode) && (off_t)size > st.st_size)
+        size = std::max<size_t>(st.st_size, 1);
+
+    return round_up(size, unit);
+}
+
+size_t nuc::io_block_size(int fd, const struct stat &st) {
+    if (size_t size = app_settings::instance().io_block_size()) {
+        return std::min(std::max(size, min_block_size), max_block_size);
+    }
+
+    return block_size_for(st, get_device_type(fd, st));
+}
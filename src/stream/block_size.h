@@ -0,0 +1,96 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_STREAM_BLOCK_SIZE_H
+#define NUC_STREAM_BLOCK_SIZE_H
+
+#include <stddef.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * Functions for determining the block size to use when reading and
+ * writing files.
+ */
+
+namespace nuc {
+    /**
+     * Type of the device on which a file is stored.
+     */
+    enum device_type {
+        /** The device type could not be determined. */
+        device_unknown,
+        /** Non-rotational storage, such as a solid state drive. */
+        device_ssd,
+        /** Rotational storage. */
+        device_hdd,
+        /** Network file system. */
+        device_network
+    };
+
+    /**
+     * Determines the type of the device on which a file is stored.
+     *
+     * The result is cached per device, thus the device type is only
+     * determined once for all files on the same device.
+     *
+     * @param fd File descriptor of an open file.
+     * @param st Stat attributes of the file.
+     *
+     * @return The device type.
+     */
+    device_type get_device_type(int fd, const struct stat &st);
+
+    /**
+     * Returns the block size which should be used for reading a
+     * file, stored on a device of type @a type.
+     *
+     * The block size is a multiple of the preferred I/O block size
+     * of the file (st_blksize) and is no larger than necessary to
+     * read the entire file in a single block.
+     *
+     * @param st Stat attributes of the file.
+     * @param type Type of the device on which the file is stored.
+     *
+     * @return The block size in bytes.
+     */
+    size_t block_size_for(const struct stat &st, device_type type);
+
+    /**
+     * Returns the block size which should be used for reading the
+     * file with descriptor @a fd.
+     *
+     * If the block size is set in the application settings, that
+     * block size is returned, otherwise the block size is determined
+     * by block_size_for.
+     *
+     * @param fd File descriptor of the file.
+     * @param st Stat attributes of the file.
+     *
+     * @return The block size in bytes.
+     */
+    size_t io_block_size(int fd, const struct stat &st);
+}
+
+#endif // NUC_STREAM_BLOCK_SIZE_H
+
+// Local Variables:
+// mode: c++
+// End:
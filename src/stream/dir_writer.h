@@ -143,6 +143,34 @@ namespace nuc {
             return file_id();
         }
 
+        /**
+         * Returns true if create may be called, and the streams it
+         * returns written, concurrently from multiple threads, while
+         * the other methods are called on the thread which created
+         * the writer.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if files can be created concurrently.
+         */
+        virtual bool concurrent_create() const {
+            return false;
+        }
+
+        /**
+         * Returns true if the data of files of unknown size, which
+         * are created with an st_size of 0, is written directly to
+         * the destination, rather than being buffered first in order
+         * to determine the file's size.
+         *
+         * The default implementation returns false.
+         *
+         * @return True if files of unknown size are streamed.
+         */
+        virtual bool streams_unknown_size() const {
+            return false;
+        }
+
     protected:
         /**
          * Throws an error exception.
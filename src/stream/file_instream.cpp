@@ -19,41 +19,105 @@
 
 #include "file_instream.h"
 
+#include <algorithm>
+#include <new>
+
+#include <stdlib.h>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include "error_macros.h"
+#include "block_size.h"
 
 using namespace nuc;
 
 
 file_instream::file_instream(const char *path, size_t buf_size) : path(path), buf_size(buf_size) {
-    alloc_buf();
-
     TRY_OP((fd = ::open(path, O_CLOEXEC | O_RDONLY)) < 0)
-}
 
-file_instream::file_instream(int dirfd, const char *file, size_t buf_size) : path(file), buf_size(buf_size) {
     alloc_buf();
+}
 
+file_instream::file_instream(int dirfd, const char *file, size_t buf_size) : path(file), buf_size(buf_size) {
     TRY_OP((fd = openat(dirfd, file, O_CLOEXEC | O_RDONLY)) < 0)
+
+    alloc_buf();
 }
 
 void file_instream::alloc_buf() {
-    if (buf_size)
-        buf = new byte[buf_size];
+    struct stat st;
+
+    if (!fstat(fd, &st)) {
+        check_sparse(st);
+
+        if (!buf_size)
+            buf_size = io_block_size(fd, st);
+
+        // Sparse files are read synchronously, as the holes are
+        // skipped using lseek.
+
+        use_ring = !seek_holes && S_ISREG(st.st_mode) &&
+            st.st_size >= ring_min_blocks * (off_t)buf_size;
+
+        streaming = S_ISREG(st.st_mode) && use_streaming(st.st_size);
+
+        // Direct I/O requires reads of whole aligned blocks into
+        // aligned buffers, which is not the case when skipping holes
+        // or with the io_uring reader's buffers.
+
+        if (streaming && !seek_holes && use_direct_io()) {
+            try_direct = true;
+            use_ring = false;
+
+            buf_size = (buf_size + direct_io_align - 1) & ~(direct_io_align - 1);
+        }
+    }
+    else if (!buf_size) {
+        buf_size = default_buf_size;
+    }
+
+    if (posix_memalign((void **)&buf, direct_io_align, buf_size))
+        throw std::bad_alloc();
+}
+
+bool file_instream::set_direct(bool flag) {
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags >= 0 && !fcntl(fd, F_SETFL, flag ? flags | O_DIRECT : flags & ~O_DIRECT)) {
+        direct = flag;
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+void file_instream::check_sparse(const struct stat &st) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    // Only files with fewer allocated blocks than their size can
+    // contain holes, thus fully allocated files are read without the
+    // additional lseek calls.
+
+    seek_holes = S_ISREG(st.st_mode) && (off_t)st.st_blocks * 512 < st.st_size;
+#endif
 }
 
 
 file_instream::~file_instream() {
     close();
 
-    if (buf) delete [] buf;
+    free(buf);
 }
 
 void file_instream::close() {
+    ring.reset();
+    cache.reset();
+
     if (fd >= 0) {
         ::close(fd);
         fd = -1;
@@ -68,11 +132,41 @@ size_t file_instream::read(byte *buf, size_t n) {
         try_op([&] {
             n_read = ::read(fd, buf, n);
 
+            // Direct I/O fails if the file position is not aligned,
+            // for example following a partial kernel copy, in which
+            // case the rest of the file is read through the cache.
+
+            if (n_read < 0 && errno == EINVAL && direct && set_direct(false))
+                n_read = ::read(fd, buf, n);
+
+            if (n_read < 0)
+                raise_error(errno);
+
+            n -= n_read;
+            buf += n_read;
+
+            total_read += n_read;
+        });
+
+    } while (n_read && n);
+
+    return total_read;
+}
+
+size_t file_instream::read_at(byte *buf, size_t n, off_t offset) {
+    size_t total_read = 0;
+    ssize_t n_read = 0;
+
+    do {
+        try_op([&] {
+            n_read = ::pread(fd, buf, n, offset);
+
             if (n_read < 0)
                 raise_error(errno);
 
             n -= n_read;
             buf += n_read;
+            offset += n_read;
 
             total_read += n_read;
         });
@@ -83,8 +177,103 @@ size_t file_instream::read(byte *buf, size_t n) {
 }
 
 const instream::byte *file_instream::read_block(size_t &size, off_t &offset) {
-    size = read(buf, buf_size);
-    offset = 0;
+    const byte *block = next_block(size, offset);
+
+    if (cache) {
+        if (block)
+            cache->advance(offset + size);
+        else
+            cache->finish();
+    }
+
+    return block;
+}
+
+const instream::byte *file_instream::next_block(size_t &size, off_t &offset) {
+    if (streaming) {
+        // Direct I/O is only enabled once the file is read in user
+        // space, as it is not supported by all kernel copy
+        // mechanisms.
+
+        off_t start = lseek(fd, 0, SEEK_CUR);
+
+        streaming = false;
+        cache.reset(new cache_dropper(fd, false, start));
+
+        if (try_direct && !(start % direct_io_align))
+            set_direct(true);
+    }
+
+    if (use_ring) {
+        // The reader begins at the current file position, which may
+        // have been advanced by a kernel copy.
+
+        using namespace std::placeholders;
+
+        use_ring = false;
+        ring.reset(uring_reader::create(fd, lseek(fd, 0, SEEK_CUR), buf_size, std::bind(&file_instream::read_at, this, _1, _2, _3)));
+    }
+
+    if (ring) {
+        offset = 0;
+        return ring->read(size);
+    }
+
+    offset = skip_hole();
+
+    if (!seek_holes) {
+        size = read(buf, buf_size);
+        return size ? buf : nullptr;
+    }
+
+    size = read(buf, std::min((off_t)buf_size, data_end - pos));
+    pos += size;
+
+    // A hole at the end of the file is returned as an empty block
+    // following the hole.
+
+    return size || offset ? buf : nullptr;
+}
+
+off_t file_instream::skip_hole() {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    if (!seek_holes || (data_end >= 0 && pos < data_end))
+        return 0;
+
+    if (data_end < 0)
+        pos = lseek(fd, 0, SEEK_CUR);
+
+    off_t data = lseek(fd, pos, SEEK_DATA);
+    off_t end;
+
+    if (data < 0) {
+        // ENXIO indicates that there is no more data past 'pos',
+        // thus the rest of the file is a hole.
+
+        if (errno != ENXIO || (data = lseek(fd, 0, SEEK_END)) < 0) {
+            seek_holes = false;
+            lseek(fd, pos, SEEK_SET);
+
+            return 0;
+        }
+
+        end = data;
+    }
+    else if ((end = lseek(fd, data, SEEK_HOLE)) < 0 ||
+             lseek(fd, data, SEEK_SET) < 0) {
+        seek_holes = false;
+        lseek(fd, pos, SEEK_SET);
+
+        return 0;
+    }
+
+    off_t gap = data - pos;
+
+    pos = data;
+    data_end = end;
 
-    return size ? buf : nullptr;
+    return gap;
+#else
+    return 0;
+#endif
 }
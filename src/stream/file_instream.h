@@ -20,7 +20,14 @@
 #ifndef NUC_STREAM_FILE_INSTREAM_H
 #define NUC_STREAM_FILE_INSTREAM_H
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <memory>
+
 #include "instream.h"
+#include "uring_io.h"
+#include "page_cache.h"
 
 #include "paths/pathname.h"
 
@@ -38,9 +45,11 @@ namespace nuc {
          * reading.
          *
          * @param path Path to the file.
-         * @param buf_size Block buffer size to use.
+         *
+         * @param buf_size Block buffer size to use. If 0 the block
+         *    size is determined by io_block_size.
          */
-        file_instream(const char *path, size_t buf_size = default_buf_size);
+        file_instream(const char *path, size_t buf_size = 0);
         /**
          * Creates an input stream for the file at @a path, which is
          * relative to the directory with file descriptor @a dirfd.
@@ -50,9 +59,10 @@ namespace nuc {
          *
          * @param path Path to the file, relative to the directory.
          *
-         * @param buf_size Block buffer size to use.
+         * @param buf_size Block buffer size to use. If 0 the block
+         *    size is determined by io_block_size.
          */
-        file_instream(int dirfd, const char *path, size_t buf_size = default_buf_size);
+        file_instream(int dirfd, const char *path, size_t buf_size = 0);
 
         /**
          * Closes the stream.
@@ -65,6 +75,15 @@ namespace nuc {
 
         virtual const byte *read_block(size_t &size, off_t &offset);
 
+        /**
+         * Returns the file descriptor of the file.
+         *
+         * @return The file descriptor.
+         */
+        int get_fd() const {
+            return fd;
+        }
+
     protected:
         void raise_error(int code, bool can_retry = true) {
             throw file_error(code, error::type_read_file, can_retry, path);
@@ -82,14 +101,15 @@ namespace nuc {
         pathname::string path;
 
         /**
-         * Default buffer size (size of the blocks).
+         * Default buffer size (size of the blocks), used if the file
+         * attributes cannot be retrieved.
          */
         static constexpr size_t default_buf_size = 131072;
 
         /**
          * Size of allocated buffer;
          */
-        size_t buf_size = default_buf_size;
+        size_t buf_size = 0;
 
         /**
          * Buffer into which the block is read.
@@ -97,10 +117,112 @@ namespace nuc {
         byte * buf = nullptr;
 
         /**
-         * Allocates the buffer.
+         * Flag: true if the file may contain holes, which should be
+         * skipped using SEEK_DATA/SEEK_HOLE.
+         */
+        bool seek_holes = false;
+
+        /**
+         * Current position within the file. Only maintained when
+         * seek_holes is true.
+         */
+        off_t pos = 0;
+
+        /**
+         * Offset of the end of the data region containing 'pos'. A
+         * negative value indicates that it has not been determined
+         * yet.
+         */
+        off_t data_end = -1;
+
+        /**
+         * Flag: true if the file should be read using an io_uring
+         * reader, which is created on the first call to read_block.
+         */
+        bool use_ring = false;
+
+        /**
+         * Asynchronous reader. NULL if the file is read
+         * synchronously.
+         */
+        std::unique_ptr<uring_reader> ring;
+
+        /**
+         * Minimum number of blocks in a file, for it to be read using
+         * an io_uring reader.
+         */
+        static constexpr off_t ring_min_blocks = 8;
+
+        /**
+         * Flag: true if the file should be streamed, with the pages
+         * read being dropped from the page cache. The cache_dropper
+         * is created on the first call to read_block.
+         */
+        bool streaming = false;
+
+        /**
+         * Drops the pages read from the page cache. NULL if the file
+         * is not streamed.
+         */
+        std::unique_ptr<cache_dropper> cache;
+
+        /**
+         * Flag: true if direct I/O should be enabled on the first call
+         * to read_block.
+         */
+        bool try_direct = false;
+
+        /**
+         * Flag: true if the file is being read with direct I/O.
+         */
+        bool direct = false;
+
+        /**
+         * Determines the block size, if it was not given, and
+         * allocates the buffer. Called after the file is opened.
          */
         void alloc_buf();
 
+        /**
+         * Reads the next block, as described by read_block.
+         *
+         * @param size Set to the size of the block.
+         * @param offset Set to the size of the gap preceding the block.
+         *
+         * @return Pointer to the block, NULL if the end of the file
+         *   was reached.
+         */
+        const byte *next_block(size_t &size, off_t &offset);
+
+        /**
+         * Enables or disables direct I/O on the file.
+         *
+         * @param flag True to enable direct I/O.
+         *
+         * @return True if successful.
+         */
+        bool set_direct(bool flag);
+
+        /**
+         * Determines whether the file may contain holes and sets the
+         * seek_holes flag.
+         *
+         * @param st Stat attributes of the file.
+         */
+        void check_sparse(const struct stat &st);
+
+        /**
+         * If the current position is at the end of a data region,
+         * seeks to the start of the next data region.
+         *
+         * Disables hole skipping, by clearing seek_holes, if it is
+         * not supported by the file system.
+         *
+         * @return The number of bytes skipped, i.e. the size of the
+         *    hole preceding the data region.
+         */
+        off_t skip_hole();
+
         /**
          * Reads @a n bytes into the buffer.
          *
@@ -111,6 +233,19 @@ namespace nuc {
          *    than @a n then the end of file was reached.
          */
         size_t read(byte *buf, size_t n);
+
+        /**
+         * Reads @a n bytes, at @a offset, into a buffer, without
+         * changing the file position.
+         *
+         * @param buf The buffer into which to read the data.
+         * @param n   Number of bytes to read.
+         * @param offset Offset within the file.
+         *
+         * @return The number of bytes actually read. If this is less
+         *    than @a n then the end of file was reached.
+         */
+        size_t read_at(byte *buf, size_t n, off_t offset);
     };
 }
 
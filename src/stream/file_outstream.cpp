@@ -19,6 +19,8 @@
 
 #include "file_outstream.h"
 
+#include <algorithm>
+
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -65,6 +67,18 @@ void file_outstream::times(fs::time_type atim, fs::time_type mtim) {
 
 
 void file_outstream::close() {
+    if (ring) {
+        ring->flush();
+        ring.reset();
+    }
+
+    if (cache) {
+        cache->finish();
+        cache.reset();
+    }
+
+    TRY_OP(error::type_write_file, release_unused())
+
     if (set_times)
         update_times();
 
@@ -95,28 +109,123 @@ void file_outstream::update_times() {
 }
 
 
+void file_outstream::allocate(off_t size) {
+    expect_size(size);
+
+    if (size <= allocated) return;
+
+    // The file may be extended, even if the allocation fails part
+    // way through, thus it is always truncated when closed.
+    allocated = size;
+
+    try_op([&] {
+        // Other errors mean preallocation is not supported, in which
+        // case the space is allocated as the data is written.
+
+        if (fs::preallocate(fd, size) && errno == ENOSPC)
+            raise_error(errno, error::type_write_file);
+    });
+}
+
 void file_outstream::write(const byte *buf, size_t n, off_t offset) {
-    seek(offset);
+    if (pos < 0) {
+        TRY_OP(error::type_write_file, (pos = lseek(fd, 0, SEEK_CUR)) < 0)
+    }
 
-    while(n) {
-        try_op([&] {
-            ssize_t bytes_written = ::write(fd, (const char *)buf, n);
+    // Large files are written asynchronously, if possible. Files of
+    // unknown size are written asynchronously once they grow past
+    // the same size.
+
+    if (!ring_started && (expected_size >= ring_min_size || pos >= ring_min_size)) {
+        ring_started = true;
+        start_ring();
+    }
+
+    if (offset > 0)
+        skip(offset);
+
+    if (n) {
+        if (ring)
+            ring->write(buf, n, pos);
+        else
+            write_at(buf, n, pos, 0);
+
+        pos += n;
+
+        // Files are streamed once they grow past the threshold, with
+        // everything written up to that point being dropped from the
+        // page cache.
+
+        if (cache) {
+            cache->advance((offset > 0 ? offset : 0) + n);
+        }
+        else if (use_streaming(pos)) {
+            cache.reset(new cache_dropper(fd, true, 0));
+            cache->advance(pos);
+        }
+    }
+    else if (offset > 0) {
+        // An empty block following a gap marks a hole at the end of
+        // the file, which only becomes part of the file once its
+        // size is extended past it.
+
+        if (ring) ring->flush();
+
+        TRY_OP(error::type_write_file, ftruncate(fd, pos))
+    }
+}
+
+void file_outstream::start_ring() {
+    using namespace std::placeholders;
+
+    ring.reset(uring_writer::create(fd, ring_buf_size, std::bind(&file_outstream::write_at, this, _1, _2, _3, _4)));
+}
+
+void file_outstream::write_at(const byte *buf, size_t n, off_t offset, int err) {
+    try_op([&] {
+        if (err) {
+            int code = err;
+            err = 0;
+
+            raise_error(code, error::type_write_file);
+        }
+
+        while (n) {
+            ssize_t bytes_written = ::pwrite(fd, (const char *)buf, n, offset);
 
             if (bytes_written < 0) raise_error(errno, error::type_write_file);
 
             n -= bytes_written;
             buf += bytes_written;
-        });
-    };
+            offset += bytes_written;
+        }
+    });
+}
+
+void file_outstream::skip(off_t n) {
+    // Skipping past EOF results in "gaps" in the file which are
+    // filled with zeroes, provided that data is written past the gap
+    // or the file is extended past it (see write).
+
+    if (pos < allocated)
+        fs::deallocate(fd, pos, std::min(n, allocated - pos));
+
+    pos += n;
 }
 
-void file_outstream::seek(off_t offset) {
-    // Seeking past EOF results in "gaps" in the file which are filled
-    // with zeroes, provided that data is written past the
-    // gap. Currently it is assumed that if offset is non-zero then
-    // the size of the block is non-zero.
+int file_outstream::release_unused() {
+    if (fd < 0 || !allocated) return 0;
+
+    // If no blocks were written, the data, if any, was copied by the
+    // kernel up to the file position.
+    off_t end = pos >= 0 ? pos : lseek(fd, 0, SEEK_CUR);
+
+    if (end >= 0 && end < allocated) {
+        if (ftruncate(fd, end))
+            return -1;
 
-    if (offset) {
-        TRY_OP(error::type_write_file, lseek(fd, offset, SEEK_CUR))
+        allocated = 0;
     }
+
+    return 0;
 }
@@ -23,8 +23,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <memory>
+
 #include "fsutil.h"
 #include "outstream.h"
+#include "uring_io.h"
+#include "page_cache.h"
 
 namespace nuc {
     /**
@@ -65,8 +70,21 @@ namespace nuc {
 
         /**
          * Closes the output stream.
+         *
+         * Pending asynchronous writes are waited for, in the same
+         * order as in close, so that they do not extend the file
+         * after it is truncated. Unlike close, writes which failed
+         * are not retried.
          */
         ~file_outstream() {
+            ring.reset();
+
+            if (cache) {
+                cache->finish();
+                cache.reset();
+            }
+
+            release_unused();
             close_fd();
         }
 
@@ -85,6 +103,37 @@ namespace nuc {
             return fd;
         }
 
+        /**
+         * Allocates disk space for a file of @a size bytes, if
+         * supported by the file system, so that the file is not
+         * extended block by block as data is written.
+         *
+         * Should be called before the first block is written. The
+         * file is extended to @a size bytes immediately. Space for
+         * holes is released as they are skipped, and the file is
+         * truncated to the end of the data written, when the stream
+         * is closed or destroyed.
+         *
+         * An error is raised if there is not enough space on the
+         * device. Other errors are ignored, as they indicate that
+         * preallocation is not supported.
+         *
+         * @param size Expected size of the file.
+         */
+        void allocate(off_t size);
+
+        /**
+         * Informs the stream of the expected size of the file, which
+         * determines whether the file is written asynchronously.
+         *
+         * Should be called before the first block is written.
+         *
+         * @param size Expected size of the file.
+         */
+        void expect_size(off_t size) {
+            expected_size = std::max(expected_size, size);
+        }
+
 
         /* Modification and Access Times */
 
@@ -133,13 +182,92 @@ namespace nuc {
         fs::time_type atime;
 
         /**
-         * Seeks to the position @a offset bytes from the current
-         * position in the file.
+         * Expected size of the file, 0 if unknown.
+         */
+        off_t expected_size = 0;
+
+        /**
+         * Flag: true if the creation of the asynchronous writer was
+         * attempted.
+         */
+        bool ring_started = false;
+
+        /**
+         * Asynchronous writer. NULL if data is written synchronously.
+         */
+        std::unique_ptr<uring_writer> ring;
+
+        /**
+         * Position, within the file, at which the next block is
+         * written. Blocks are written at absolute offsets, thus the
+         * file position is not changed.
+         *
+         * Initialized to the file position when the first block is
+         * written, as data may have been copied to the file, by the
+         * kernel, prior to that.
+         */
+        off_t pos = -1;
+
+        /**
+         * Number of bytes, from the start of the file, for which
+         * space was allocated by allocate.
+         */
+        off_t allocated = 0;
+
+        /**
+         * Drops the pages written from the page cache. NULL until the
+         * file grows past the stream threshold.
+         */
+        std::unique_ptr<cache_dropper> cache;
+
+        /**
+         * Size of the asynchronous writer's buffers.
+         */
+        static constexpr size_t ring_buf_size = 1048576;
+
+        /**
+         * Minimum size of a file, either expected or written so far,
+         * for it to be written using the asynchronous writer.
+         */
+        static constexpr off_t ring_min_size = 8 * ring_buf_size;
+
+        /**
+         * Creates the asynchronous writer, beginning at the current
+         * file position. Does nothing if io_uring is not available.
+         */
+        void start_ring();
+
+        /**
+         * Skips a gap, of @a n bytes, preceding a block. The space
+         * allocated for the gap, if any, is released so that it
+         * remains a hole.
+         *
+         * @param n Size of the gap.
+         */
+        void skip(off_t n);
+
+        /**
+         * Truncates the file to the end of the data written, if it
+         * was extended past it by allocate.
+         *
+         * @return 0 if successful, non-zero on error.
+         */
+        int release_unused();
+
+        /**
+         * Writes @a n bytes at @a offset, without changing the file
+         * position. Also called by the asynchronous writer for data
+         * which could not be written asynchronously.
+         *
+         * @param buf The data to write.
+         * @param n Number of bytes to write.
+         * @param offset Offset within the file.
          *
-         * @param offset The offset, to seek to, from the current file
-         *   position.
+         * @param err If non-zero, the error with which the
+         *   asynchronous write failed, which is reported before the
+         *   write is retried.
          */
-        void seek(off_t offset);
+        void write_at(const byte *buf, size_t n, off_t offset, int err);
 
         /**
          * Closes the file descriptor.
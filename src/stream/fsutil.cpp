@@ -22,11 +22,66 @@
 #include <string>
 
 #include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <atomic>
+#include <cstring>
 
 #ifdef __APPLE__
 #include <sys/param.h>
 #endif
 
+#ifdef __linux__
+#include <linux/falloc.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#include <sys/sysmacros.h>
+#endif
+
+
+/**
+ * Returns true if the error code @a code indicates that a kernel
+ * copy mechanism is not supported for a particular pair of files.
+ *
+ * @param code The error code.
+ *
+ * @return True if the mechanism is not supported.
+ */
+static bool copy_unsupported(int code);
+
+/**
+ * Retrieves the attributes of the file @a name, in the directory @a
+ * dir_fd, with fstatat or statx.
+ *
+ * @param dir_fd Directory file descriptor.
+ * @param name Name of the file.
+ * @param flags fstatat flags.
+ * @param st The stat struct into which the attributes are stored.
+ *
+ * @return 0 if successful, -1 on failure.
+ */
+static int stat_at(int dir_fd, const char *name, int flags, struct stat &st);
+
+/**
+ * Retrieves the file mode creation mask, by setting it and restoring
+ * it to its previous value.
+ *
+ * Called during static initialization, before any threads, which
+ * might create files while the mask is changed, are started.
+ *
+ * @return The umask.
+ */
+static mode_t read_umask();
+
+/**
+ * The file mode creation mask of the process.
+ */
+static const mode_t process_umask = read_umask();
+
+
 void nuc::fs::stat_times(const struct stat *st, time_type times[]) {
 #ifdef __APPLE__
     TIMESPEC_TO_TIMEVAL(times, &st->st_atimespec);
@@ -65,3 +120,178 @@ int nuc::fs::set_ftimeat(int fd, const char *path, const time_type *times) {
     return utimensat(fd, path, times, AT_SYMLINK_NOFOLLOW);
 #endif
 }
+
+
+mode_t nuc::fs::file_umask() {
+    return process_umask;
+}
+
+mode_t read_umask() {
+    mode_t mask = umask(0);
+    umask(mask);
+
+    return mask;
+}
+
+gid_t nuc::fs::new_file_gid(const struct stat &dir) {
+#ifdef __linux__
+    // Files are given the group of the directory only if it has the
+    // set-group-ID bit.
+    return dir.st_mode & S_ISGID ? dir.st_gid : getegid();
+#else
+    // BSD semantics: files are always given the group of the
+    // directory.
+    return dir.st_gid;
+#endif
+}
+
+
+int nuc::fs::preallocate(int fd, off_t size) {
+#if defined(__linux__)
+    return fallocate(fd, 0, 0, size);
+
+#elif defined(__APPLE__)
+    fstore_t store = {F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, size, 0};
+
+    if (fcntl(fd, F_PREALLOCATE, &store) < 0) {
+        store.fst_flags = F_ALLOCATEALL;
+
+        if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+            return -1;
+    }
+
+    return ftruncate(fd, size);
+
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+int nuc::fs::deallocate(int fd, off_t offset, off_t len) {
+#if defined(__linux__)
+    return fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len);
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+
+int nuc::fs::clone_file(int in_fd, int out_fd) {
+#if defined(__linux__) && defined(FICLONE)
+    return ioctl(out_fd, FICLONE, in_fd);
+#else
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+ssize_t nuc::fs::copy_range(int in_fd, int out_fd, size_t n, copy_method &method) {
+    ssize_t copied = -1;
+
+    while (method != copy_method_none) {
+        switch (method) {
+#ifdef __linux__
+#ifdef HAVE_COPY_FILE_RANGE
+        case copy_method_range:
+            copied = copy_file_range(in_fd, NULL, out_fd, NULL, n, 0);
+            break;
+#endif
+
+        case copy_method_sendfile:
+            copied = sendfile(out_fd, in_fd, NULL, n);
+            break;
+#endif
+
+        default:
+            copied = -1;
+            errno = ENOSYS;
+            break;
+        }
+
+        if (copied >= 0 || errno == EINTR || !copy_unsupported(errno))
+            return copied;
+
+        method = (copy_method)(method + 1);
+    }
+
+    errno = ENOSYS;
+    return -1;
+}
+
+bool copy_unsupported(int code) {
+    switch (code) {
+    case EXDEV:
+    case EINVAL:
+    case ENOSYS:
+    case EOPNOTSUPP:
+#if ENOTSUP != EOPNOTSUPP
+    case ENOTSUP:
+#endif
+        return true;
+    }
+
+    return false;
+}
+
+
+/* Directory Listing */
+
+bool nuc::fs::entry_stat(int dir_fd, const char *name, uint8_t type, struct stat &st) {
+    switch (type) {
+    case DT_UNKNOWN:
+    case DT_LNK:
+        if (!stat_at(dir_fd, name, 0, st))
+            return true;
+
+        return !stat_at(dir_fd, name, AT_SYMLINK_NOFOLLOW, st);
+
+    default:
+        // Not a symbolic link, thus there is nothing to follow.
+        return !stat_at(dir_fd, name, AT_SYMLINK_NOFOLLOW, st);
+    }
+}
+
+#if defined(__linux__) && defined(HAVE_STATX)
+
+/**
+ * Flag for whether the kernel supports statx. Cleared when statx
+ * fails with ENOSYS.
+ */
+static std::atomic<bool> has_statx(true);
+
+int stat_at(int dir_fd, const char *name, int flags, struct stat &st) {
+    if (has_statx) {
+        struct statx stx;
+
+        if (!statx(dir_fd, name, flags | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC,
+                   STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx)) {
+            memset(&st, 0, sizeof(st));
+
+            st.st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+            st.st_ino = stx.stx_ino;
+            st.st_mode = stx.stx_mode;
+            st.st_size = stx.stx_size;
+            st.st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+            st.st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+
+            return 0;
+        }
+
+        if (errno != ENOSYS)
+            return -1;
+
+        has_statx = false;
+    }
+
+    return fstatat(dir_fd, name, &st, flags);
+}
+
+#else
+
+int stat_at(int dir_fd, const char *name, int flags, struct stat &st) {
+    return fstatat(dir_fd, name, &st, flags);
+}
+
+#endif
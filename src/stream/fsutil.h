@@ -20,8 +20,11 @@
 #ifndef NUC_STREAM_FSUTIL_H
 #define NUC_STREAM_FSUTIL_H
 
+#include <sys/types.h>
 #include <sys/stat.h>
 
+#include <stdint.h>
+
 #ifdef __APPLE__
 #include <sys/time.h>
 #endif
@@ -82,6 +85,145 @@ namespace nuc {
          * @return Zero if successful, non-zero on failure.
          */
         int set_ftimeat(int fd, const char *path, const time_type *times);
+
+
+        /* Attributes of new files */
+
+        /**
+         * Returns the file mode creation mask of the process, as it
+         * was when the program was started.
+         *
+         * @return The umask.
+         */
+        mode_t file_umask();
+
+        /**
+         * Returns the group ID which a file, created by the process
+         * in a directory, is given.
+         *
+         * @param dir Stat attributes of the directory.
+         *
+         * @return The group ID.
+         */
+        gid_t new_file_gid(const struct stat &dir);
+
+
+        /* Space allocation */
+
+        /**
+         * Allocates disk space for the first @a size bytes of the
+         * file with descriptor @a fd. The file is extended to @a size
+         * bytes, if it is smaller.
+         *
+         * @param fd File descriptor.
+         * @param size Number of bytes to allocate.
+         *
+         * @return Zero if successful, non-zero if the space could not
+         *   be allocated or allocation is not supported.
+         */
+        int preallocate(int fd, off_t size);
+
+        /**
+         * Releases the disk space allocated for a range of the file
+         * with descriptor @a fd, without changing its size. Data in
+         * the range, if any, reads back as zeroes.
+         *
+         * The range should not extend past the end of the file, as
+         * some file systems ignore that part of the range.
+         *
+         * @param fd File descriptor.
+         * @param offset Offset of the start of the range.
+         * @param len Length of the range in bytes.
+         *
+         * @return Zero if successful, non-zero on failure.
+         */
+        int deallocate(int fd, off_t offset, off_t len);
+
+
+        /* Kernel-side copying */
+
+        /**
+         * Kernel copy mechanism, used by copy_range.
+         *
+         * copy_range starts with copy_method_range and downgrades the
+         * method when the kernel or file system does not support it.
+         */
+        enum copy_method {
+            /** copy_file_range(2) */
+            copy_method_range,
+            /** sendfile(2) */
+            copy_method_sendfile,
+            /** No kernel copy mechanism is available. */
+            copy_method_none
+        };
+
+        /**
+         * Makes the file with descriptor @a out_fd a reflink (shared
+         * extent clone) of the file with descriptor @a in_fd.
+         *
+         * Only supported on Linux, by copy-on-write file systems.
+         *
+         * @param in_fd File descriptor of the source file.
+         * @param out_fd File descriptor of the destination file.
+         *
+         * @return Zero if successful, non-zero on failure.
+         */
+        int clone_file(int in_fd, int out_fd);
+
+        /**
+         * Copies up to @a n bytes from the current position of file
+         * @a in_fd to the current position of file @a out_fd, without
+         * passing the data through user space. The positions of both
+         * files are advanced by the number of bytes copied.
+         *
+         * @param in_fd File descriptor of the source file.
+         * @param out_fd File descriptor of the destination file.
+         *
+         * @param n Maximum number of bytes to copy.
+         *
+         * @param method The copy mechanism to use. Updated to the
+         *   next mechanism if the current one is not supported for
+         *   the pair of files.
+         *
+         * @return The number of bytes copied, 0 at the end of the
+         *   source file, -1 on failure. If @a method is
+         *   copy_method_none on failure, no kernel copy mechanism is
+         *   available and the copy should be continued in user space.
+         */
+        ssize_t copy_range(int in_fd, int out_fd, size_t n, copy_method &method);
+
+
+        /* Directory Listing */
+
+        /**
+         * Retrieves the stat attributes of a directory entry, for
+         * display in a file list.
+         *
+         * Only the type, mode, size, modification time, inode and
+         * device fields are retrieved, all other fields are set to
+         * zero. On Linux statx(2) is used, which allows the file
+         * system to skip retrieving the remaining fields.
+         *
+         * Symbolic links are followed. If the target of a symbolic
+         * link cannot be retrieved, the attributes of the link itself
+         * are retrieved. Entries, of which the type is known and is
+         * not a symbolic link, are not followed.
+         *
+         * @param dir_fd File descriptor of the directory containing
+         *   the entry.
+         *
+         * @param name Name of the entry.
+         *
+         * @param type The entry's type as a dirent constant, DT_UNKNOWN
+         *   if it is not known.
+         *
+         * @param st The stat struct into which the attributes are
+         *   stored.
+         *
+         * @return True if the attributes were retrieved, false
+         *   otherwise.
+         */
+        bool entry_stat(int dir_fd, const char *name, uint8_t type, struct stat &st);
     }
 }  // nuc
 
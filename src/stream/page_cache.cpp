@@ -0,0 +1,99 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "page_cache.h"
+
+#include <fcntl.h>
+
+#include "settings/app_settings.h"
+
+using namespace nuc;
+
+
+bool nuc::use_streaming(off_t size) {
+    size_t threshold = app_settings::instance().stream_threshold();
+
+    return threshold && size >= (off_t)(threshold << 20);
+}
+
+bool nuc::use_direct_io() {
+#ifdef O_DIRECT
+    return app_settings::instance().direct_io();
+#else
+    return false;
+#endif
+}
+
+
+cache_dropper::cache_dropper(int fd, bool writing, off_t start) : fd(fd), writing(writing), dropped(start), flushed(start), end(start) {
+#if defined(HAVE_POSIX_FADVISE)
+    // Sequential access doubles the read-ahead window on Linux
+    if (!writing)
+        posix_fadvise(fd, start, 0, POSIX_FADV_SEQUENTIAL);
+
+#elif defined(__APPLE__)
+    // No way to drop pages selectively, thus disable caching for the
+    // file altogether.
+    fcntl(fd, F_NOCACHE, 1);
+#endif
+}
+
+void cache_dropper::advance(off_t n) {
+    end += n;
+
+    if (end - flushed < window)
+        return;
+
+    if (writing) {
+        start_writeback(flushed, end);
+        drop(dropped, flushed);
+
+        dropped = flushed;
+    }
+    else {
+        drop(dropped, end);
+        dropped = end;
+    }
+
+    flushed = end;
+}
+
+void cache_dropper::finish() {
+    drop(dropped, end);
+    dropped = flushed = end;
+}
+
+void cache_dropper::start_writeback(off_t from, off_t to) {
+#ifdef HAVE_SYNC_FILE_RANGE
+    sync_file_range(fd, from, to - from, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+void cache_dropper::drop(off_t from, off_t to) {
+    if (to <= from) return;
+
+#ifdef HAVE_SYNC_FILE_RANGE
+    if (writing)
+        sync_file_range(fd, from, to - from, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(fd, from, to - from, POSIX_FADV_DONTNEED);
+#endif
+}
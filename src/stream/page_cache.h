@@ -0,0 +1,147 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_STREAM_PAGE_CACHE_H
+#define NUC_STREAM_PAGE_CACHE_H
+
+#include <stddef.h>
+
+#include <sys/types.h>
+
+/**
+ * Functions for limiting the page cache used by large files, which
+ * are read or written once, so that copying them does not evict the
+ * cached data of other files.
+ */
+
+namespace nuc {
+    /**
+     * Returns true if a file of @a size bytes should be streamed,
+     * that is its data should be dropped from the page cache once
+     * read or written. Files at least as large as the stream
+     * threshold, in app_settings, are streamed.
+     *
+     * @param size Size of the file.
+     *
+     * @return True if the file should be streamed.
+     */
+    bool use_streaming(off_t size);
+
+    /**
+     * Returns true if streamed files should be read with direct I/O,
+     * bypassing the page cache entirely.
+     *
+     * @return True if direct I/O should be used.
+     */
+    bool use_direct_io();
+
+    /**
+     * Alignment of the buffers, file offsets and sizes of direct I/O
+     * reads.
+     */
+    constexpr size_t direct_io_align = 4096;
+
+    /**
+     * Drops the pages of a file, which is being read or written
+     * sequentially, from the page cache, once the current position
+     * has moved past them.
+     *
+     * Pages are dropped in windows of several megabytes. When
+     * writing, the writeback of each window is started once it is
+     * complete, and the window is dropped once the following window
+     * is complete, by which time it has usually been written back.
+     */
+    class cache_dropper {
+    public:
+        /**
+         * Constructor.
+         *
+         * @param fd File descriptor of the file.
+         *
+         * @param writing True if the file is being written, false if
+         *   it is being read.
+         *
+         * @param start Offset at which reading or writing begins.
+         */
+        cache_dropper(int fd, bool writing, off_t start);
+
+        /**
+         * Advances the position, past a number of bytes which were
+         * read or written.
+         *
+         * @param n Number of bytes.
+         */
+        void advance(off_t n);
+
+        /**
+         * Drops all pages up to the current position. When writing,
+         * waits for them to be written back first.
+         */
+        void finish();
+
+    private:
+        /**
+         * Size of the windows in which pages are dropped.
+         */
+        static constexpr off_t window = 8388608;
+
+        /**
+         * File descriptor.
+         */
+        int fd;
+
+        /**
+         * Flag: true if the file is being written.
+         */
+        bool writing;
+
+        /**
+         * Offset up to which pages were dropped.
+         */
+        off_t dropped;
+
+        /**
+         * Offset up to which writeback was started.
+         */
+        off_t flushed;
+
+        /**
+         * Current position.
+         */
+        off_t end;
+
+        /**
+         * Starts the writeback of the pages from @a from to @a to.
+         */
+        void start_writeback(off_t from, off_t to);
+
+        /**
+         * Drops the pages from @a from to @a to. When writing, waits
+         * for them to be written back first, as dirty pages cannot be
+         * dropped.
+         */
+        void drop(off_t from, off_t to);
+    };
+}
+
+#endif // NUC_STREAM_PAGE_CACHE_H
+
+// Local Variables:
+// mode: c++
+// End:
@@ -46,11 +46,43 @@ using namespace nuc;
  */
 static restart overwrite_restart(int &flags);
 
+/**
+ * Returns true if a file, created by the process in a directory, is
+ * given the owner and group in @a st.
+ *
+ * @param st Stat attributes of the file.
+ *
+ * @param dir Stat attributes of the directory, NULL if unknown.
+ *
+ * @return True if the owner and group need not be set.
+ */
+static bool is_new_file_owner(const struct stat &st, const struct stat *dir);
+
+/**
+ * Returns the mode which a directory, created by mkdir, is given.
+ *
+ * @param parent Stat attributes of the directory in which it is
+ *   created, NULL if unknown.
+ *
+ * @return The mode.
+ */
+static mode_t new_dir_mode(const struct stat *parent);
+
+
 reg_dir_writer::reg_dir_writer(const char *path) {
     TRY_OP((fd = open(path, O_DIRECTORY)) < 0)
+
+    root.fd = fd;
+    root.has_stat = !fstat(fd, &root.st);
 }
 
 void reg_dir_writer::close() {
+    for (auto &dir : dirs) {
+        ::close(dir.second.fd);
+    }
+
+    dirs.clear();
+
     ::close(fd);
 }
 
@@ -60,17 +92,23 @@ void reg_dir_writer::close() {
 outstream * reg_dir_writer::create(const pathname &path, const struct stat *st, int flags) {
     int fflags = flags & stream_flag_exclusive ? O_EXCL : 0;
 
+    // Create the file with the permissions of the source file, so
+    // that the mode usually need not be changed afterwards.
+    int perms = st ? st->st_mode & (S_IRWXU | S_IRWXG | S_IRWXO) : S_IRWXU;
+
     global_restart overwrite(overwrite_restart(fflags));
 
     file_outstream *stream;
 
     try_op([&] {
-        stream = new file_outstream(fd, path.path().c_str(), fflags);
+        stream = new file_outstream(fd, path.path().c_str(), fflags, perms);
     });
 
     stream->times(st);
 
-    set_file_attributes(stream->get_fd(), path.path().c_str(), st);
+    // If the overwrite restart was chosen, the file may have existed
+    // with different attributes.
+    set_file_attributes(stream->get_fd(), path, st, fflags & O_EXCL);
 
     return stream;
 }
@@ -88,12 +126,14 @@ restart overwrite_restart(int &flags) {
 void reg_dir_writer::mkdir(const pathname &path, bool) {
     TRY_OP_(mkdirat(fd, path.path().c_str(), S_IRWXU),
             throw file_error(errno, error::type_create_dir, true, path))
+
+    new_dirs.insert(path.path());
 }
 
 void reg_dir_writer::symlink(const pathname &path, const pathname &target, const struct stat *st) {
     TRY_OP(symlinkat(target.path().c_str(), fd, path.path().c_str()))
 
-    set_attributes(path, st);
+    set_attributes(path, st, true);
 }
 
 void reg_dir_writer::rename(const pathname &src, const pathname &dest) {
@@ -136,25 +176,51 @@ void reg_dir_writer::remove(const pathname &path, bool relative) {
 
 //// Attributes
 
-void reg_dir_writer::set_file_attributes(int fd, const char *path, const struct stat *st) {
+void reg_dir_writer::set_file_attributes(int fd, const pathname &path, const struct stat *st, bool created) {
     if (st) {
-        with_skip_attrib([=] {
-            TRY_OP_(fchmod(fd, st->st_mode & ~S_IFMT),
-                    throw attribute_error(errno, error::type_set_mode, true, path));
-        });
+        std::string name;
+        dir_info dir;
 
-        with_skip_attrib([=] {
-            TRY_OP_(fchown(fd, st->st_uid, st->st_gid),
-                    throw attribute_error(errno, error::type_set_owner, true, path));
-        });
+        if (created)
+            dir = parent_dir(path, name);
+
+        // The file was created with the permission bits of the mode,
+        // less those in the umask.
+        mode_t mode = st->st_mode & ~S_IFMT;
+
+        if (!created || (mode & (S_IRWXU | S_IRWXG | S_IRWXO) & ~fs::file_umask()) != mode)
+            with_skip_attrib([&] {
+                TRY_OP_(fchmod(fd, mode),
+                        throw attribute_error(errno, error::type_set_mode, true, path));
+            });
+
+        if (!created || !is_new_file_owner(*st, dir.has_stat ? &dir.st : nullptr))
+            with_skip_attrib([&] {
+                TRY_OP_(fchown(fd, st->st_uid, st->st_gid),
+                        throw attribute_error(errno, error::type_set_owner, true, path));
+            });
     }
 }
 
 void reg_dir_writer::set_attributes(const pathname &path, const struct stat *st) {
+    bool created = new_dirs.erase(path.path());
+
+    set_attributes(path, st, created);
+
+    // The directory's entries have all been written
+    close_dir(path);
+}
+
+void reg_dir_writer::set_attributes(const pathname &path, const struct stat *st, bool created) {
     if (st) {
-        if (!S_ISLNK(st->st_mode))
-            with_skip_attrib([=] {
-                TRY_OP_(fchmodat(fd, path.path().c_str(), st->st_mode & ~S_IFMT, 0),
+        std::string name;
+        dir_info dir = parent_dir(path, name);
+
+        const struct stat *dir_st = dir.has_stat ? &dir.st : nullptr;
+
+        if (!S_ISLNK(st->st_mode) && (!created || (st->st_mode & ~S_IFMT) != new_dir_mode(dir_st)))
+            with_skip_attrib([&] {
+                TRY_OP_(fchmodat(dir.fd, name.c_str(), st->st_mode & ~S_IFMT, 0),
                         throw attribute_error(errno, error::type_set_mode, true, path));
             });
 
@@ -163,14 +229,80 @@ void reg_dir_writer::set_attributes(const pathname &path, const struct stat *st)
         fs::stat_times(st, times);
 
         with_skip_attrib([&] {
-            TRY_OP_(fs::set_ftimeat(fd, path.path().c_str(), times),
+            TRY_OP_(fs::set_ftimeat(dir.fd, name.c_str(), times),
                     throw attribute_error(errno, error::type_set_times, true, path));
         });
 
-        with_skip_attrib([=] {
-            TRY_OP_(fchownat(fd, path.path().c_str(), st->st_uid, st->st_gid, AT_SYMLINK_NOFOLLOW),
-                    throw attribute_error(errno, error::type_set_owner, true, path));
-        });
+        if (!created || !is_new_file_owner(*st, dir_st))
+            with_skip_attrib([&] {
+                TRY_OP_(fchownat(dir.fd, name.c_str(), st->st_uid, st->st_gid, AT_SYMLINK_NOFOLLOW),
+                        throw attribute_error(errno, error::type_set_owner, true, path));
+            });
+    }
+}
+
+bool is_new_file_owner(const struct stat &st, const struct stat *dir) {
+    return dir && st.st_uid == geteuid() && st.st_gid == fs::new_file_gid(*dir);
+}
+
+mode_t new_dir_mode(const struct stat *parent) {
+    mode_t mode = S_IRWXU & ~fs::file_umask();
+
+#ifdef __linux__
+    // Subdirectories inherit the set-group-ID bit
+    if (parent && (parent->st_mode & S_ISGID))
+        mode |= S_ISGID;
+#endif
+
+    return mode;
+}
+
+
+//// Open Subdirectories
+
+reg_dir_writer::dir_info reg_dir_writer::parent_dir(const pathname &path, std::string &name) {
+    pathname parent = path.remove_last_component();
+
+    if (parent.empty()) {
+        name = path.path();
+        return root;
+    }
+
+    std::lock_guard<std::mutex> lock(dirs_mutex);
+
+    auto it = dirs.find(parent.path());
+
+    if (it == dirs.end()) {
+        dir_info dir;
+
+        if ((dir.fd = openat(fd, parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+            // Fall back to the full subpath, relative to the
+            // directory being written, if the directory cannot be
+            // opened, for example due to lacking read permissions.
+
+            dir.fd = fd;
+            name = path.path();
+
+            return dir;
+        }
+
+        dir.has_stat = !fstat(dir.fd, &dir.st);
+
+        it = dirs.emplace(parent.path(), dir).first;
+    }
+
+    name = path.basename();
+    return it->second;
+}
+
+void reg_dir_writer::close_dir(const pathname &path) {
+    std::lock_guard<std::mutex> lock(dirs_mutex);
+
+    auto it = dirs.find(path.ensure_dir(false).path());
+
+    if (it != dirs.end()) {
+        ::close(it->second.fd);
+        dirs.erase(it);
     }
 }
 
@@ -20,6 +20,13 @@
 #ifndef NUC_STREAM_REG_DIR_WRITER_H
 #define NUC_STREAM_REG_DIR_WRITER_H
 
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <sys/stat.h>
+
 #include "dir_writer.h"
 
 
@@ -62,23 +69,111 @@ namespace nuc {
 
         virtual file_id get_file_id(const pathname &path);
 
+        virtual bool concurrent_create() const {
+            return true;
+        }
+
     private:
         /**
          * File descriptor of the directory.
          */
         int fd;
 
+        /**
+         * Open directory, within the directory being written.
+         */
+        struct dir_info {
+            /**
+             * File descriptor of the directory.
+             */
+            int fd = -1;
+
+            /**
+             * Flag: true if @a st holds the directory's attributes.
+             */
+            bool has_stat = false;
+
+            /**
+             * Stat attributes of the directory.
+             */
+            struct stat st;
+        };
+
+        /**
+         * Attributes of the directory being written.
+         */
+        dir_info root;
+
+        /**
+         * Subdirectories, in which files were created or whose
+         * attributes were set, which are kept open so that the
+         * attributes of their entries can be set relative to them
+         * rather than by resolving the full subpath each time.
+         *
+         * The map is indexed by subpath, and is protected by
+         * dirs_mutex, as files may be created concurrently.
+         */
+        std::unordered_map<std::string, dir_info> dirs;
+        std::mutex dirs_mutex;
+
+        /**
+         * Subpaths of the directories created by mkdir, for which
+         * set_attributes has not been called yet.
+         */
+        std::unordered_set<std::string> new_dirs;
+
+        /**
+         * Returns the directory containing a file, opening it if it
+         * is not open already.
+         *
+         * @param path Subpath of the file.
+         *
+         * @param name Set to the path of the file relative to the
+         *   directory returned, which is the full subpath if the
+         *   directory could not be opened.
+         *
+         * @return The directory.
+         */
+        dir_info parent_dir(const pathname &path, std::string &name);
+
+        /**
+         * Closes a subdirectory, if it was opened by parent_dir.
+         *
+         * @param path Subpath of the directory.
+         */
+        void close_dir(const pathname &path);
+
         /**
          * Sets the attributes of an open file.
          *
+         * Attributes which a newly created file already has, are not
+         * set.
+         *
          * @param fd File descriptor of the file.
          *
-         * @param path Path to the file whose attributes are being
-         *   set. Only used for error reporting.
+         * @param path Subpath of the file whose attributes are being
+         *   set.
          *
          * @param st Stat attributes to set.
+         *
+         * @param created True if the file was created, with
+         *   permissions from @a st, rather than overwritten.
+         */
+        void set_file_attributes(int fd, const pathname &path, const struct stat *st, bool created);
+
+        /**
+         * Sets the attributes of the directory or symbolic link at @a
+         * path, without following symbolic links.
+         *
+         * @param path Subpath of the file.
+         *
+         * @param st Stat attributes to set.
+         *
+         * @param created True if the file was created by the writer,
+         *   in which case attributes which it already has are not
+         *   set.
          */
-        void set_file_attributes(int fd, const char *path, const struct stat *st);
+        void set_attributes(const pathname &path, const struct stat *st, bool created);
     };
 }
 
@@ -19,6 +19,8 @@
 
 #include "sub_archive_dir_writer.h"
 
+#include <time.h>
+
 #include "file_instream.h"
 
 using namespace nuc;
@@ -29,7 +31,14 @@ sub_archive_dir_writer::sub_archive_dir_writer(archive_plugin *plugin, dir_type
     open_old();
 
     try {
-        open_temp(dtype->path());
+        // If the parent archive requires the size of the nested
+        // archive upfront, it is written to a temporary file, next to
+        // the outermost archive, first.
+
+        if (parent_writer->streams_unknown_size())
+            open_stream();
+        else
+            open_temp(dtype->path());
     }
     catch (...) {
         close_handles();
@@ -37,25 +46,86 @@ sub_archive_dir_writer::sub_archive_dir_writer(archive_plugin *plugin, dir_type
     }
 }
 
+sub_archive_dir_writer::~sub_archive_dir_writer() {
+    close_handles();
+}
+
 void sub_archive_dir_writer::open_old() {
     try_op([this] {
         in_lister = std::unique_ptr<archive_lister>(dynamic_cast<archive_lister*>(dtype->create_lister()));
     });
 }
 
+void sub_archive_dir_writer::open_stream() {
+    // TODO: Get stat attributes from file in archive.
+
+    struct stat st{};
+
+    st.st_mode = S_IFREG | 0644;
+    st.st_mtime = time(nullptr);
+
+    parent_out.reset(parent_writer->create(path, &st, 0));
+
+    try_op([=] {
+        int err;
+
+        if (!(out_handle = plugin->open_pack(write_fn, this, &err)))
+            raise_error(errno, err);
+    });
+
+    get_old_entries();
+}
+
+ssize_t sub_archive_dir_writer::write_fn(void *ctx, const void *buffer, size_t length) {
+    sub_archive_dir_writer *self = static_cast<sub_archive_dir_writer*>(ctx);
+
+    try {
+        self->parent_out->write(static_cast<const outstream::byte*>(buffer), length);
+        return length;
+    }
+    catch (const nuc::error &e) {
+        self->write_error = std::current_exception();
+        errno = e.code();
+
+        return -1;
+    }
+    catch (...) {
+        // Exceptions must not unwind through the plugin's frames
+
+        self->write_error = std::current_exception();
+        errno = EIO;
+
+        return -1;
+    }
+}
+
+void sub_archive_dir_writer::rethrow_write_error() {
+    if (write_error)
+        std::rethrow_exception(write_error);
+}
+
 void sub_archive_dir_writer::close() {
     open_old();
-    copy_old_entries();
 
-    if (out_handle) {
-        int err = plugin->close(out_handle);
-        out_handle = nullptr;
+    try {
+        copy_old_entries();
+        close_out_handle();
+    }
+    catch (...) {
+        rethrow_write_error();
+        throw;
+    }
+
+    rethrow_write_error();
 
-        if (err)
-            raise_error(errno, false);
+    if (parent_out) {
+        parent_out->close();
+        parent_out.reset();
+    }
+    else {
+        pack_to_parent();
     }
 
-    pack_to_parent();
     parent_writer->close();
 }
 
@@ -77,4 +147,6 @@ void sub_archive_dir_writer::pack_to_parent() {
     while (const instream::byte *block = in->read_block(size, offset)) {
         out->write(block, size, offset);
     }
+
+    out->close();
 }
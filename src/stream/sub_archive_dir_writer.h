@@ -20,6 +20,8 @@
 #ifndef NUC_STREAM_SUB_ARCHIVE_DIR_WRITER_H
 #define NUC_STREAM_SUB_ARCHIVE_DIR_WRITER_H
 
+#include <exception>
+
 #include "archive_dir_writer.h"
 #include "directory/dir_type.h"
 
@@ -46,6 +48,12 @@ namespace nuc {
          */
         sub_archive_dir_writer(archive_plugin *plugin, dir_type *dtype, dir_writer *parent_writer, const pathname &path, const pathname &subpath);
 
+        /**
+         * Closes the handle of the nested archive, while the output
+         * stream, to which it writes, still exists.
+         */
+        virtual ~sub_archive_dir_writer();
+
         virtual void close();
 
     private:
@@ -58,16 +66,62 @@ namespace nuc {
          */
         std::unique_ptr<dir_writer> parent_writer;
 
+        /**
+         * Output stream of the nested archive's entry in the parent
+         * archive, to which the new nested archive is written
+         * directly. NULL if the nested archive is written to a
+         * temporary file.
+         */
+        std::unique_ptr<outstream> parent_out;
+
+        /**
+         * The error which occurred while writing to the parent
+         * archive's output stream, if any.
+         */
+        std::exception_ptr write_error;
+
         /**
          * Create a lister for the old archive.
          */
         void open_old();
 
+        /**
+         * Creates the nested archive's entry in the parent archive
+         * and opens a new archive handle which writes directly to
+         * it, rather than to a temporary file.
+         *
+         * Should only be used if the parent archive writes entries
+         * of unknown size directly, otherwise the entire nested
+         * archive would be buffered by the parent archive's plugin.
+         */
+        void open_stream();
+
         /**
          * Write the new archive file, stored at a temporary location,
          * to the parent archive.
          */
         void pack_to_parent();
+
+        /**
+         * Rethrows the error which occurred while writing to the
+         * parent archive's output stream, if any.
+         */
+        void rethrow_write_error();
+
+        /**
+         * Archive write callback function, which writes the data to
+         * the parent archive's output stream.
+         *
+         * @param ctx Pointer to the sub_archive_dir_writer.
+         * @param buffer Data to write.
+         * @param length Number of bytes to write.
+         *
+         * @return The number of bytes written, -1 if there was an
+         *   error, in which case the exception is stored in
+         *   write_error and its code in errno, or EIO if it is not a
+         *   nuc::error.
+         */
+        static ssize_t write_fn(void *ctx, const void *buffer, size_t length);
     };
 
 }  // nuc
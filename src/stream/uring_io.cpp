@@ -0,0 +1,409 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "uring_io.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <atomic>
+
+#ifdef NUC_USE_IO_URING
+#include <sys/uio.h>
+#include <liburing.h>
+#else
+struct io_uring {};
+#endif
+
+using namespace nuc;
+
+
+/**
+ * Flag: true if io_uring was found to be unavailable, either because
+ * it is not supported by the kernel or it has been disabled.
+ */
+static std::atomic<bool> uring_unavailable{false};
+
+/**
+ * Number of buffers, and thus the maximum number of requests in
+ * flight, of each queue.
+ */
+static constexpr unsigned queue_depth = 4;
+
+
+//// uring_queue
+
+uring_queue::uring_queue(int fd, unsigned depth, size_t buf_size)
+    : fd(fd), depth(depth), buf_size(buf_size) {}
+
+uring_queue::~uring_queue() {
+#ifdef NUC_USE_IO_URING
+    if (ring) {
+        // If the requests in flight could not be waited for, the
+        // buffers are leaked as the kernel may still write to them.
+
+        if (!drain()) buffers = nullptr;
+
+        io_uring_queue_exit(ring.get());
+    }
+#endif
+
+    free(buffers);
+}
+
+bool uring_queue::init() {
+#ifdef NUC_USE_IO_URING
+    if (uring_unavailable) return false;
+
+    if (posix_memalign((void **)&buffers, 4096, depth * buf_size)) {
+        buffers = nullptr;
+        return false;
+    }
+
+    ring.reset(new io_uring());
+
+    if (int err = io_uring_queue_init(depth, ring.get(), 0)) {
+        ring.reset();
+
+        if (err == -ENOSYS || err == -EPERM || err == -EACCES)
+            uring_unavailable = true;
+
+        return false;
+    }
+
+    // Registering the buffers may fail if the locked memory limit is
+    // too low, in which case regular reads/writes are used.
+
+    std::vector<struct iovec> iov(depth);
+
+    for (unsigned i = 0; i < depth; ++i) {
+        iov[i].iov_base = buffer(i);
+        iov[i].iov_len = buf_size;
+    }
+
+    fixed = !io_uring_register_buffers(ring.get(), iov.data(), depth);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring_queue::submit_read(unsigned i, off_t offset, size_t n) {
+#ifdef NUC_USE_IO_URING
+    io_uring_sqe *sqe = io_uring_get_sqe(ring.get());
+
+    if (!sqe) return false;
+
+    if (fixed)
+        io_uring_prep_read_fixed(sqe, fd, buffer(i), n, offset, i);
+    else
+        io_uring_prep_read(sqe, fd, buffer(i), n, offset);
+
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)i);
+
+    return submit();
+#else
+    return false;
+#endif
+}
+
+bool uring_queue::submit_write(unsigned i, off_t offset, size_t n) {
+#ifdef NUC_USE_IO_URING
+    io_uring_sqe *sqe = io_uring_get_sqe(ring.get());
+
+    if (!sqe) return false;
+
+    if (fixed)
+        io_uring_prep_write_fixed(sqe, fd, buffer(i), n, offset, i);
+    else
+        io_uring_prep_write(sqe, fd, buffer(i), n, offset);
+
+    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)i);
+
+    return submit();
+#else
+    return false;
+#endif
+}
+
+bool uring_queue::submit() {
+#ifdef NUC_USE_IO_URING
+    int n;
+
+    while ((n = io_uring_submit(ring.get())) == -EINTR);
+
+    if (n > 0) inflight += n;
+
+    return n > 0;
+#else
+    return false;
+#endif
+}
+
+bool uring_queue::wait(unsigned &i, ssize_t &result) {
+#ifdef NUC_USE_IO_URING
+    io_uring_cqe *cqe;
+    int err;
+
+    while ((err = io_uring_wait_cqe(ring.get(), &cqe)) == -EINTR);
+
+    if (err) return false;
+
+    i = (uintptr_t)io_uring_cqe_get_data(cqe);
+    result = cqe->res;
+
+    io_uring_cqe_seen(ring.get(), cqe);
+    inflight--;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring_queue::drain() {
+#ifdef NUC_USE_IO_URING
+    if (!inflight) return true;
+
+    // Cancel the requests which have not started yet. The completions
+    // of the cancel requests are identified by an index equal to
+    // depth.
+
+    for (unsigned i = 0; i < depth; ++i) {
+        if (io_uring_sqe *sqe = io_uring_get_sqe(ring.get())) {
+            io_uring_prep_cancel(sqe, (void *)(uintptr_t)i, 0);
+            io_uring_sqe_set_data(sqe, (void *)(uintptr_t)depth);
+        }
+    }
+
+    submit();
+
+    unsigned i;
+    ssize_t result;
+
+    while (inflight) {
+        if (!wait(i, result))
+            return false;
+    }
+#endif
+
+    return true;
+}
+
+
+//// uring_reader
+
+uring_reader::uring_reader(int fd, off_t offset, size_t buf_size, read_fn sync_read)
+    : uring_queue(fd, queue_depth, buf_size), sync_read(sync_read), next_offset(offset),
+      offsets(queue_depth), sizes(queue_depth), results(queue_depth), completed(queue_depth) {}
+
+uring_reader *uring_reader::create(int fd, off_t offset, size_t buf_size, read_fn sync_read) {
+    std::unique_ptr<uring_reader> reader(new uring_reader(fd, offset, buf_size, sync_read));
+
+    if (!reader->init())
+        return nullptr;
+
+    for (unsigned i = 0; i < reader->depth; ++i) {
+        reader->request(i);
+    }
+
+    return reader.release();
+}
+
+void uring_reader::request(unsigned i) {
+    offsets[i] = next_offset;
+    sizes[i] = buf_size;
+    completed[i] = false;
+
+    next_offset += buf_size;
+    pending++;
+
+    // If the request could not be submitted, the block is read
+    // synchronously when it is reached.
+
+    if (!submit_read(i, offsets[i], sizes[i])) {
+        completed[i] = true;
+        results[i] = -1;
+    }
+}
+
+const uring_reader::byte *uring_reader::read(size_t &size) {
+    if (broken) return read_sync(size);
+
+    // The buffer of the previous block can now be reused
+
+    if (returned) {
+        returned = false;
+
+        if (!eof) request((head + depth - 1) % depth);
+    }
+
+    if (eof || !pending) return nullptr;
+
+    unsigned i = head;
+
+    while (!completed[i]) {
+        unsigned j;
+        ssize_t result;
+
+        if (!wait(j, result)) {
+            // The requests in flight may still write to the buffers,
+            // thus the remainder of the file, starting from this
+            // block, is read synchronously into a separate buffer.
+
+            broken = true;
+            next_offset = offsets[i];
+            sync_buf.reset(new byte[buf_size]);
+
+            return read_sync(size);
+        }
+
+        completed[j] = true;
+        results[j] = result;
+    }
+
+    ssize_t result = results[i];
+    size_t n = result > 0 ? result : 0;
+
+    // Complete failed and short reads synchronously. A short read
+    // may also indicate the end of the file, in which case the
+    // synchronous read returns 0.
+
+    if (n < sizes[i])
+        n += sync_read(buffer(i) + n, sizes[i] - n, offsets[i] + n);
+
+    if (n < sizes[i])
+        eof = true;
+
+    head = (head + 1) % depth;
+    pending--;
+    returned = true;
+
+    size = n;
+    return n ? buffer(i) : nullptr;
+}
+
+const uring_reader::byte *uring_reader::read_sync(size_t &size) {
+    size = eof ? 0 : sync_read(sync_buf.get(), buf_size, next_offset);
+
+    next_offset += size;
+    if (size < buf_size) eof = true;
+
+    return size ? sync_buf.get() : nullptr;
+}
+
+
+//// uring_writer
+
+uring_writer::uring_writer(int fd, size_t buf_size, write_fn sync_write)
+    : uring_queue(fd, queue_depth, buf_size), sync_write(sync_write),
+      offsets(queue_depth), sizes(queue_depth), busy(queue_depth) {}
+
+uring_writer *uring_writer::create(int fd, size_t buf_size, write_fn sync_write) {
+    std::unique_ptr<uring_writer> writer(new uring_writer(fd, buf_size, sync_write));
+
+    if (!writer->init())
+        return nullptr;
+
+    return writer.release();
+}
+
+void uring_writer::write(const byte *buf, size_t n, off_t offset) {
+    if (broken) {
+        sync_write(buf, n, offset, 0);
+        return;
+    }
+
+    while (n) {
+        unsigned i = free_buffer();
+
+        // Waiting for a free buffer failed
+        if (broken) {
+            sync_write(buf, n, offset, 0);
+            return;
+        }
+
+        size_t chunk = std::min(n, buf_size);
+
+        memcpy(buffer(i), buf, chunk);
+
+        offsets[i] = offset;
+        sizes[i] = chunk;
+
+        if (submit_write(i, offset, chunk)) {
+            busy[i] = true;
+            n_busy++;
+        }
+        else {
+            sync_write(buffer(i), chunk, offset, 0);
+        }
+
+        buf += chunk;
+        offset += chunk;
+        n -= chunk;
+    }
+}
+
+void uring_writer::flush() {
+    while (n_busy) complete_one();
+}
+
+unsigned uring_writer::free_buffer() {
+    while (n_busy == depth) complete_one();
+
+    return std::find(busy.begin(), busy.end(), false) - busy.begin();
+}
+
+void uring_writer::complete_one() {
+    unsigned i;
+    ssize_t result;
+
+    if (!wait(i, result)) {
+        // Writes are idempotent, thus the data of all requests in
+        // flight is simply written again synchronously. The buffers
+        // are not modified, as the requests may still be running,
+        // and are not used for any further writes.
+
+        broken = true;
+
+        for (unsigned j = 0; j < depth; ++j) {
+            if (busy[j]) {
+                busy[j] = false;
+                n_busy--;
+
+                sync_write(buffer(j), sizes[j], offsets[j], 0);
+            }
+        }
+
+        return;
+    }
+
+    busy[i] = false;
+    n_busy--;
+
+    if (result < 0) {
+        sync_write(buffer(i), sizes[i], offsets[i], -result);
+    }
+    else if ((size_t)result < sizes[i]) {
+        sync_write(buffer(i) + result, sizes[i] - result, offsets[i] + result, 0);
+    }
+}
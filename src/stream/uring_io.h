@@ -0,0 +1,388 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_STREAM_URING_IO_H
+#define NUC_STREAM_URING_IO_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct io_uring;
+
+/**
+ * Asynchronous file I/O using io_uring.
+ *
+ * Only available if NuCommander was configured with
+ * --enable-io-uring, otherwise the create functions always return
+ * NULL and file streams perform synchronous I/O.
+ */
+
+namespace nuc {
+    /**
+     * Queue of asynchronous read or write requests on a single file.
+     *
+     * The queue has a fixed number of buffers, registered with the
+     * kernel if possible, each of which is the target or source of at
+     * most one request at a time.
+     */
+    class uring_queue {
+    public:
+        typedef uint8_t byte;
+
+        virtual ~uring_queue();
+
+        uring_queue(const uring_queue &) = delete;
+        uring_queue &operator=(const uring_queue &) = delete;
+
+    protected:
+        /**
+         * Constructor. Does not create the io_uring instance, init
+         * has to be called for that.
+         *
+         * @param fd File descriptor of the file.
+         * @param depth Number of buffers.
+         * @param buf_size Size of each buffer.
+         */
+        uring_queue(int fd, unsigned depth, size_t buf_size);
+
+        /**
+         * Creates the io_uring instance and allocates the buffers.
+         *
+         * @return True if successful, false if io_uring is not
+         *   available.
+         */
+        bool init();
+
+        /**
+         * File descriptor.
+         */
+        int fd;
+
+        /**
+         * Number of buffers.
+         */
+        unsigned depth;
+
+        /**
+         * Size of each buffer.
+         */
+        size_t buf_size;
+
+        /**
+         * Returns a pointer to the buffer with index @a i.
+         *
+         * @param i Buffer index.
+         *
+         * @return Pointer to the buffer.
+         */
+        byte *buffer(unsigned i) {
+            return buffers + i * buf_size;
+        }
+
+        /**
+         * Submits a request to read @a n bytes, at @a offset, into
+         * the buffer with index @a i.
+         *
+         * @param i Buffer index.
+         * @param offset Offset within the file.
+         * @param n Number of bytes to read.
+         *
+         * @return True if the request was submitted.
+         */
+        bool submit_read(unsigned i, off_t offset, size_t n);
+
+        /**
+         * Submits a request to write @a n bytes, from the buffer with
+         * index @a i, at @a offset.
+         *
+         * @param i Buffer index.
+         * @param offset Offset within the file.
+         * @param n Number of bytes to write.
+         *
+         * @return True if the request was submitted.
+         */
+        bool submit_write(unsigned i, off_t offset, size_t n);
+
+        /**
+         * Waits for a request to complete.
+         *
+         * @param i Set to the index of the buffer of the request.
+         *
+         * @param result Set to the result of the request: the number
+         *   of bytes read/written or a negated error code.
+         *
+         * @return True if a request completed, false if waiting
+         *   failed.
+         */
+        bool wait(unsigned &i, ssize_t &result);
+
+        /**
+         * Cancels all requests in flight and waits for them to
+         * complete, after which the buffers are no longer accessed
+         * by the kernel.
+         *
+         * @return True if all requests completed, false if waiting
+         *   failed.
+         */
+        bool drain();
+
+    private:
+        /**
+         * The io_uring instance.
+         */
+        std::unique_ptr<io_uring> ring;
+
+        /**
+         * Flag: true if the buffers are registered with the kernel.
+         */
+        bool fixed = false;
+
+        /**
+         * Memory containing all the buffers.
+         */
+        byte *buffers = nullptr;
+
+        /**
+         * Number of submitted requests which have not completed yet.
+         */
+        unsigned inflight = 0;
+
+        /**
+         * Submits the prepared request.
+         *
+         * @return True if successful.
+         */
+        bool submit();
+    };
+
+    /**
+     * Reads a file sequentially with multiple read requests in
+     * flight.
+     */
+    class uring_reader : public uring_queue {
+    public:
+        /**
+         * Synchronous read function, which is called to read data
+         * that could not be read asynchronously.
+         *
+         * Should read @a n bytes at @a offset into @a buf and return
+         * the number of bytes read, which is less than @a n only at
+         * the end of the file. Errors should be reported by throwing
+         * an exception.
+         */
+        typedef std::function<size_t(byte *buf, size_t n, off_t offset)> read_fn;
+
+        /**
+         * Creates a reader.
+         *
+         * @param fd File descriptor of the file.
+         * @param offset Offset at which to begin reading.
+         * @param buf_size Block size.
+         * @param sync_read Synchronous read function.
+         *
+         * @return The reader, or NULL if io_uring is not available.
+         */
+        static uring_reader *create(int fd, off_t offset, size_t buf_size, read_fn sync_read);
+
+        /**
+         * Returns the next block of the file. The block remains
+         * valid until the next call.
+         *
+         * @param size Set to the size of the block.
+         *
+         * @return Pointer to the block, NULL at the end of the file.
+         */
+        const byte *read(size_t &size);
+
+    private:
+        uring_reader(int fd, off_t offset, size_t buf_size, read_fn sync_read);
+
+        /**
+         * Synchronous read function.
+         */
+        read_fn sync_read;
+
+        /**
+         * Offset of the next read request.
+         */
+        off_t next_offset;
+
+        /**
+         * Index of the buffer containing the next block.
+         */
+        unsigned head = 0;
+
+        /**
+         * Number of buffers with a request which has not been
+         * returned by read yet.
+         */
+        unsigned pending = 0;
+
+        /**
+         * Flag: true if the end of the file has been reached.
+         */
+        bool eof = false;
+
+        /**
+         * Flag: true if the block before 'head' was returned and its
+         * buffer can be reused.
+         */
+        bool returned = false;
+
+        /**
+         * Flag: true if waiting for completions failed, after which
+         * all reads are performed synchronously into sync_buf.
+         */
+        bool broken = false;
+
+        /**
+         * Buffer into which blocks are read once the reader is
+         * broken. The ring buffers are no longer used at that point,
+         * as requests in flight may still write to them.
+         */
+        std::unique_ptr<byte[]> sync_buf;
+
+        /**
+         * Offset, size, result and completion flag of the request of
+         * each buffer.
+         */
+        std::vector<off_t> offsets;
+        std::vector<size_t> sizes;
+        std::vector<ssize_t> results;
+        std::vector<bool> completed;
+
+        /**
+         * Submits a read request for the next block into the buffer
+         * @a i.
+         *
+         * @param i Buffer index.
+         */
+        void request(unsigned i);
+
+        /**
+         * Reads the next block synchronously into sync_buf.
+         *
+         * @param size Set to the size of the block.
+         *
+         * @return Pointer to the block, NULL at the end of the file.
+         */
+        const byte *read_sync(size_t &size);
+    };
+
+    /**
+     * Writes to a file with multiple write requests in flight.
+     */
+    class uring_writer : public uring_queue {
+    public:
+        /**
+         * Synchronous write function, which is called to write data
+         * that could not be written asynchronously.
+         *
+         * Should write @a n bytes from @a buf at @a offset. If @a
+         * error is non-zero, it is the error code with which the
+         * asynchronous write failed and should be reported, before
+         * retrying the write. Errors should be reported by throwing
+         * an exception.
+         */
+        typedef std::function<void(const byte *buf, size_t n, off_t offset, int error)> write_fn;
+
+        /**
+         * Creates a writer.
+         *
+         * @param fd File descriptor of the file.
+         * @param buf_size Size of the buffers.
+         * @param sync_write Synchronous write function.
+         *
+         * @return The writer, or NULL if io_uring is not available.
+         */
+        static uring_writer *create(int fd, size_t buf_size, write_fn sync_write);
+
+        /**
+         * Writes @a n bytes, from @a buf, at @a offset. The data is
+         * copied into the buffers thus @a buf can be reused as soon
+         * as the function returns.
+         *
+         * @param buf The data to write.
+         * @param n Number of bytes to write.
+         * @param offset Offset within the file.
+         */
+        void write(const byte *buf, size_t n, off_t offset);
+
+        /**
+         * Waits for all write requests to complete.
+         */
+        void flush();
+
+    private:
+        uring_writer(int fd, size_t buf_size, write_fn sync_write);
+
+        /**
+         * Synchronous write function.
+         */
+        write_fn sync_write;
+
+        /**
+         * Number of buffers with a request in flight.
+         */
+        unsigned n_busy = 0;
+
+        /**
+         * Flag: true if waiting for completions failed, after which
+         * all writes are performed synchronously, directly from the
+         * data passed to write, as the kernel may still be reading
+         * from the buffers.
+         */
+        bool broken = false;
+
+        /**
+         * Offset, size and in flight flag of the request of each
+         * buffer.
+         */
+        std::vector<off_t> offsets;
+        std::vector<size_t> sizes;
+        std::vector<bool> busy;
+
+        /**
+         * Returns the index of a buffer without a request in flight,
+         * waiting for a request to complete if necessary.
+         *
+         * @return The buffer index.
+         */
+        unsigned free_buffer();
+
+        /**
+         * Waits for a request to complete and completes the
+         * remainder of it synchronously if it failed or was short.
+         *
+         * If waiting fails, the data of all requests in flight is
+         * written synchronously and the writer is marked broken.
+         */
+        void complete_one();
+    };
+}
+
+#endif // NUC_STREAM_URING_IO_H
+
+// Local Variables:
+// mode: c++
+// End:
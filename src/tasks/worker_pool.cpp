@@ -0,0 +1,105 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "worker_pool.h"
+
+#include "async_task.h"
+
+using namespace nuc;
+
+
+worker_pool::~worker_pool() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    errors.abort();
+
+    cond.wait(lock, [this] {
+        return !running;
+    });
+}
+
+void worker_pool::add(job_fn job, job_fn done) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    wait(lock, [this] {
+        return running < max_jobs;
+    });
+
+    running++;
+    lock.unlock();
+
+    dispatch_async([this, job, done] {
+        run(job, done);
+    });
+}
+
+void worker_pool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    wait(lock, [this] {
+        return !running;
+    });
+}
+
+template <typename F>
+void worker_pool::wait(std::unique_lock<std::mutex> &lock, F pred) {
+    while (true) {
+        while (errors.pending())
+            errors.handle(lock);
+
+        while (!finished.empty()) {
+            result res = std::move(finished.front());
+            finished.pop_front();
+
+            if (res.error)
+                std::rethrow_exception(res.error);
+
+            lock.unlock();
+            res.done();
+            lock.lock();
+        }
+
+        if (pred()) return;
+
+        cond.wait(lock);
+    }
+}
+
+void worker_pool::run(const job_fn &job, const job_fn &done) {
+    result res;
+    res.done = done;
+
+    {
+        error_handler handler(errors.handler());
+
+        try {
+            job();
+        }
+        catch (...) {
+            res.error = std::current_exception();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    finished.push_back(std::move(res));
+    running--;
+
+    cond.notify_all();
+}
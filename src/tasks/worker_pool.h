@@ -0,0 +1,161 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NUC_TASKS_WORKER_POOL_H
+#define NUC_TASKS_WORKER_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+
+#include "errors/error_forwarder.h"
+
+namespace nuc {
+    /**
+     * Runs jobs, on behalf of a task, on background threads with at
+     * most a fixed number of jobs running at a time.
+     *
+     * The pool is owned by the thread which created it, which should
+     * be the only thread calling its methods. Errors raised by the
+     * jobs are forwarded to the owner thread, where they are handled
+     * by the owner's error handler (see error_forwarder). The
+     * completion functions of the jobs are called on the owner
+     * thread, thus they may emit progress events.
+     *
+     * Destroying the pool, before all jobs have completed, waits
+     * for the running jobs to complete. Errors raised by the jobs
+     * in the meantime are aborted.
+     */
+    class worker_pool {
+    public:
+        /**
+         * Job function type.
+         */
+        typedef std::function<void()> job_fn;
+
+        /**
+         * Creates a pool.
+         *
+         * @param max_jobs Maximum number of jobs running at a time.
+         */
+        worker_pool(size_t max_jobs) : max_jobs(max_jobs) {}
+
+        worker_pool(const worker_pool &) = delete;
+        worker_pool &operator=(const worker_pool &) = delete;
+
+        /**
+         * Waits for the running jobs to complete.
+         */
+        ~worker_pool();
+
+        /**
+         * Runs a job on a background thread.
+         *
+         * If the maximum number of jobs are already running, blocks
+         * until a job completes. Forwarded errors are handled and the
+         * completion functions of the jobs, which completed in the
+         * meantime, are called.
+         *
+         * @param job Function to run on the background thread.
+         *
+         * @param done Function to call on the owner thread, once @a
+         *   job returns. If @a job throws an exception, @a done is
+         *   not called and the exception is rethrown on the owner
+         *   thread, by add or wait.
+         */
+        void add(job_fn job, job_fn done);
+
+        /**
+         * Waits until all jobs have completed, handling forwarded
+         * errors and calling the completion functions of the jobs.
+         */
+        void wait();
+
+    private:
+        /**
+         * Completed job.
+         */
+        struct result {
+            /** Completion function. */
+            job_fn done;
+
+            /** Exception thrown by the job, if any. */
+            std::exception_ptr error;
+        };
+
+        /**
+         * Protects the following members.
+         */
+        std::mutex mutex;
+
+        /**
+         * Signalled when a job completes or an error is forwarded.
+         */
+        std::condition_variable cond;
+
+        /**
+         * Forwards errors raised by the jobs to the owner thread.
+         */
+        error_forwarder errors{mutex, cond};
+
+        /**
+         * Maximum number of jobs running at a time.
+         */
+        size_t max_jobs;
+
+        /**
+         * Number of jobs running.
+         */
+        size_t running = 0;
+
+        /**
+         * Completed jobs, in the order of completion, for which the
+         * completion functions have not been called yet.
+         */
+        std::deque<result> finished;
+
+        /**
+         * Job thread function. Runs a job and adds its result to the
+         * finished queue.
+         *
+         * @param job The job function.
+         * @param done The job's completion function.
+         */
+        void run(const job_fn &job, const job_fn &done);
+
+        /**
+         * Waits, on the owner thread, until @a pred returns true,
+         * handling forwarded errors and completed jobs in the
+         * meantime.
+         *
+         * @param lock Lock on the mutex.
+         * @param pred The predicate.
+         */
+        template <typename F>
+        void wait(std::unique_lock<std::mutex> &lock, F pred);
+    };
+}
+
+#endif // NUC_TASKS_WORKER_POOL_H
+
+// Local Variables:
+// mode: c++
+// End:
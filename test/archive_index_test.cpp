@@ -0,0 +1,306 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE archive_index
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "directory/archive_index.h"
+
+using namespace nuc;
+
+/**
+ * Creates a temporary directory which is used as the user's cache
+ * directory, so that the indices saved by the tests are isolated
+ * from the user's indices.
+ */
+struct cache_dir_fixture {
+    std::string dir;
+
+    cache_dir_fixture() {
+        char tmpl[] = "/tmp/nucommander-test-XXXXXX";
+
+        if (!mkdtemp(tmpl))
+            throw std::runtime_error("Cannot create temporary cache directory");
+
+        dir = tmpl;
+        setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+    }
+
+    ~cache_dir_fixture() {
+        std::string cmd = "rm -rf '" + dir + "'";
+
+        if (system(cmd.c_str()))
+            std::cerr << "Cannot remove temporary cache directory " << dir << std::endl;
+    }
+};
+
+BOOST_GLOBAL_FIXTURE(cache_dir_fixture);
+
+/**
+ * Returns the path to the directory in which indices are saved.
+ */
+static std::string index_dir() {
+    return std::string(getenv("XDG_CACHE_HOME")) + "/nucommander/archive-index";
+}
+
+/**
+ * Returns the paths to the index files in the index directory.
+ */
+static std::vector<std::string> index_files() {
+    std::vector<std::string> files;
+
+    if (DIR *dp = opendir(index_dir().c_str())) {
+        while (struct dirent *ent = readdir(dp)) {
+            if (ent->d_name[0] != '.')
+                files.push_back(index_dir() + "/" + ent->d_name);
+        }
+
+        closedir(dp);
+    }
+
+    return files;
+}
+
+/**
+ * Removes all saved indices.
+ */
+static void clear_indices() {
+    for (auto &file : index_files())
+        unlink(file.c_str());
+}
+
+/**
+ * Creates a file, standing in for an archive, with contents @a
+ * data.
+ *
+ * @param name Name of the file within the cache directory.
+ * @param data Contents of the file.
+ *
+ * @return Path to the file.
+ */
+static std::string make_archive(const std::string &name, const std::string &data) {
+    std::string path = std::string(getenv("XDG_CACHE_HOME")) + "/" + name;
+    std::ofstream(path, std::ios::binary) << data;
+
+    return path;
+}
+
+/**
+ * Saves an index, of the archive @a path, containing a regular file
+ * and a directory entry.
+ *
+ * @param key Logical path to the archive.
+ * @param path Path to the archive file.
+ */
+static void save_index(const std::string &key, const std::string &path) {
+    archive_index index(key, path);
+
+    struct stat st{};
+
+    st.st_size = 1234;
+    st.st_mtime = 1500000000;
+    st.st_mode = S_IFREG | 0644;
+
+    index.add(lister::entry{"dir/file.txt", DT_REG}, st);
+
+    st.st_size = 0;
+    st.st_mode = S_IFDIR | 0755;
+
+    index.add(lister::entry{"dir", DT_DIR}, st);
+
+    index.save();
+}
+
+
+BOOST_AUTO_TEST_SUITE(archive_index_tests)
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+    clear_indices();
+
+    std::string path = make_archive("round_trip.tar", "archive data");
+    save_index(path, path);
+
+    BOOST_CHECK_EQUAL(index_files().size(), 1);
+
+    archive_index index(path, path);
+    BOOST_REQUIRE(index.load());
+
+    auto &ents = index.entries();
+    BOOST_REQUIRE_EQUAL(ents.size(), 2);
+
+    BOOST_CHECK_EQUAL(ents[0].name, "dir/file.txt");
+    BOOST_CHECK_EQUAL(ents[0].type, DT_REG);
+    BOOST_CHECK_EQUAL(ents[0].size, 1234);
+    BOOST_CHECK_EQUAL(ents[0].mtime, 1500000000);
+    BOOST_CHECK_EQUAL(ents[0].mode, S_IFREG | 0644);
+
+    BOOST_CHECK_EQUAL(ents[1].name, "dir");
+    BOOST_CHECK_EQUAL(ents[1].type, DT_DIR);
+    BOOST_CHECK_EQUAL(ents[1].mode, S_IFDIR | 0755);
+
+    struct stat st = ents[0].attributes();
+
+    BOOST_CHECK_EQUAL(st.st_size, 1234);
+    BOOST_CHECK_EQUAL(st.st_mtime, 1500000000);
+    BOOST_CHECK_EQUAL(st.st_mode, S_IFREG | 0644);
+
+    lister::entry ent = ents[1].lister_entry();
+
+    BOOST_CHECK_EQUAL(ent.name, "dir");
+    BOOST_CHECK_EQUAL(ent.type, DT_DIR);
+}
+
+BOOST_AUTO_TEST_CASE(empty_index) {
+    clear_indices();
+
+    std::string path = make_archive("empty.tar", "archive data");
+    archive_index(path, path).save();
+
+    archive_index index(path, path);
+
+    BOOST_CHECK(index.load());
+    BOOST_CHECK(index.entries().empty());
+}
+
+BOOST_AUTO_TEST_CASE(no_saved_index) {
+    clear_indices();
+
+    std::string path = make_archive("unsaved.tar", "archive data");
+    archive_index index(path, path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index.entries().empty());
+}
+
+BOOST_AUTO_TEST_CASE(different_key) {
+    clear_indices();
+
+    std::string path = make_archive("key.tar", "archive data");
+    save_index(path, path);
+
+    archive_index index(path + "/nested.zip", path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index.entries().empty());
+}
+
+BOOST_AUTO_TEST_CASE(changed_size) {
+    clear_indices();
+
+    std::string path = make_archive("size.tar", "archive data");
+    save_index(path, path);
+
+    make_archive("size.tar", "changed archive data");
+
+    archive_index index(path, path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index.entries().empty());
+
+    // The stale index is removed
+    BOOST_CHECK(index_files().empty());
+}
+
+BOOST_AUTO_TEST_CASE(changed_mtime) {
+    clear_indices();
+
+    std::string path = make_archive("mtime.tar", "archive data");
+    save_index(path, path);
+
+    struct timespec times[2] = {{0, UTIME_OMIT}, {1000000000, 0}};
+    BOOST_REQUIRE_EQUAL(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+
+    archive_index index(path, path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index_files().empty());
+}
+
+BOOST_AUTO_TEST_CASE(corrupt_index) {
+    clear_indices();
+
+    std::string path = make_archive("corrupt.tar", "archive data");
+    save_index(path, path);
+
+    auto files = index_files();
+    BOOST_REQUIRE_EQUAL(files.size(), 1);
+
+    // Cut the index off in the middle of the last entry
+
+    struct stat st;
+    BOOST_REQUIRE_EQUAL(stat(files[0].c_str(), &st), 0);
+    BOOST_REQUIRE_EQUAL(truncate(files[0].c_str(), st.st_size - 3), 0);
+
+    archive_index index(path, path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index.entries().empty());
+    BOOST_CHECK(index_files().empty());
+}
+
+BOOST_AUTO_TEST_CASE(bad_magic) {
+    clear_indices();
+
+    std::string path = make_archive("magic.tar", "archive data");
+    save_index(path, path);
+
+    auto files = index_files();
+    BOOST_REQUIRE_EQUAL(files.size(), 1);
+
+    {
+        std::fstream file(files[0], std::ios::binary | std::ios::in | std::ios::out);
+        file.write("XXXX", 4);
+    }
+
+    archive_index index(path, path);
+
+    BOOST_CHECK(!index.load());
+    BOOST_CHECK(index_files().empty());
+}
+
+BOOST_AUTO_TEST_CASE(missing_archive) {
+    clear_indices();
+
+    std::string path = std::string(getenv("XDG_CACHE_HOME")) + "/missing.tar";
+
+    // Indices of archives which do not exist are neither saved nor
+    // loaded.
+
+    save_index(path, path);
+    BOOST_CHECK(index_files().empty());
+
+    archive_index index(path, path);
+    BOOST_CHECK(!index.load());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
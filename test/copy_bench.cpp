@@ -0,0 +1,158 @@
+/*
+ * NuCommander
+ * Copyright (C) 2019  Alexander Gutev <alex.gutev@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/**
+ * Copy block size benchmark.
+ *
+ * Copies a file using the file_instream and file_outstream classes,
+ * with each of a range of block sizes, and reports the throughput
+ * achieved with each block size.
+ *
+ * The I/O backend, synchronous read/write or io_uring, is selected
+ * at configure time, thus the throughput of the two backends is
+ * compared by running the benchmark built with and without
+ * --enable-io-uring.
+ *
+ * Usage: bench-copy SOURCE DEST [BLOCK SIZE]...
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "stream/file_instream.h"
+#include "stream/file_outstream.h"
+#include "stream/block_size.h"
+
+using namespace nuc;
+
+
+/**
+ * Block sizes which are tried if none are given on the command line.
+ */
+static const std::vector<size_t> default_sizes = {
+    16384, 65536, 131072, 262144, 1048576, 4194304, 16777216
+};
+
+/**
+ * Drops the cached pages of a file, so that each run reads the file
+ * from the device.
+ *
+ * @param path Path to the file.
+ */
+static void drop_cache(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd >= 0) {
+        fdatasync(fd);
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        close(fd);
+    }
+}
+
+/**
+ * Copies the file at @a src to @a dest using blocks of size @a
+ * block_size.
+ *
+ * @return The number of bytes copied.
+ */
+static size_t copy(const char *src, const char *dest, size_t block_size) {
+    std::unique_ptr<instream> in(new file_instream(src, block_size));
+    std::unique_ptr<file_outstream> out(new file_outstream(dest, 0, S_IRUSR | S_IWUSR));
+
+    size_t total = 0, size;
+    off_t offset;
+
+    while (const instream::byte *block = in->read_block(size, offset)) {
+        out->write(block, size, offset);
+        total += size + offset;
+    }
+
+    fdatasync(out->get_fd());
+    out->close();
+
+    return total;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s SOURCE DEST [BLOCK SIZE]...\n", argv[0]);
+        return 1;
+    }
+
+    const char *src = argv[1];
+    const char *dest = argv[2];
+
+    std::vector<size_t> sizes;
+
+    for (int i = 3; i < argc; ++i) {
+        sizes.push_back(strtoul(argv[i], nullptr, 10));
+    }
+
+    if (sizes.empty()) sizes = default_sizes;
+
+    int fd = open(src, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(src);
+        return 1;
+    }
+
+#ifdef NUC_USE_IO_URING
+    printf("I/O backend: io_uring\n");
+#else
+    printf("I/O backend: read/write\n");
+#endif
+
+    printf("Automatic block size: %zu\n\n", block_size_for(st, get_device_type(fd, st)));
+    close(fd);
+
+    printf("%12s %12s %12s\n", "Block Size", "Seconds", "MiB/s");
+
+    for (size_t size : sizes) {
+        drop_cache(src);
+        drop_cache(dest);
+
+        auto start = std::chrono::steady_clock::now();
+
+        try {
+            size_t bytes = copy(src, dest, size);
+
+            std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+            printf("%12zu %12.3f %12.1f\n", size, secs.count(), bytes / 1048576.0 / secs.count());
+        }
+        catch (const error &e) {
+            fprintf(stderr, "Error copying file: %d\n", e.code());
+            return 1;
+        }
+    }
+
+    unlink(dest);
+
+    return 0;
+}
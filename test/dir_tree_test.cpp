@@ -49,7 +49,7 @@ BOOST_AUTO_TEST_CASE(add_entry) {
     BOOST_CHECK_EQUAL(foo->subpath().path(), "foo.txt");
     BOOST_CHECK_EQUAL(foo->type(), dir_entry::type_reg);
     BOOST_CHECK_EQUAL(foo->ent_type(), dir_entry::type_lnk);
-    BOOST_CHECK_EQUAL(foo->attr().st_mode & ~S_IFMT, S_IRWXU);
+    BOOST_CHECK_EQUAL(foo->attr().mode & ~S_IFMT, S_IRWXU);
 
     BOOST_CHECK_EQUAL(tree.get_entry("foo.txt"), foo);
 
@@ -91,11 +91,52 @@ BOOST_AUTO_TEST_CASE(get_entry) {
     BOOST_CHECK_EQUAL(tree.get_entry("bar.txt"), bar);
     BOOST_CHECK_EQUAL(tree.get_entry("baz"), (dir_entry *)nullptr);
 
-    auto its = tree.get_entries("foo");
+    auto ents = tree.get_entries("foo");
 
-    BOOST_REQUIRE(its.first != its.second);
-    BOOST_CHECK_EQUAL(&(its.first->second), foo);
-    BOOST_CHECK(++its.first == its.second);
+    BOOST_REQUIRE_EQUAL(ents.size(), 1);
+    BOOST_CHECK_EQUAL(ents[0], foo);
+}
+
+BOOST_AUTO_TEST_CASE(remove_entries) {
+    dir_tree tree;
+
+    // Add enough entries for the index to be resized multiple
+    // times.
+    for (int i = 0; i < 1000; i++) {
+        tree.add_entry(dir_entry(std::to_string(i), dir_entry::type_reg));
+    }
+
+    dir_entry *foo = tree.add_entry(dir_entry("foo", dir_entry::type_reg));
+
+    BOOST_CHECK_EQUAL(tree.index().erase("10"), 1);
+    BOOST_CHECK_EQUAL(tree.index().erase("10"), 0);
+    BOOST_CHECK_EQUAL(tree.get_entry("10"), (dir_entry *)nullptr);
+
+    BOOST_CHECK_EQUAL(tree.index().size(), 1000);
+    BOOST_CHECK_EQUAL(tree.get_entry("foo"), foo);
+    BOOST_CHECK_EQUAL(tree.get_entry("999")->file_name(), "999");
+
+    // Check that removed entries are not copied
+
+    dir_tree copy;
+    copy.index() = tree.index();
+
+    BOOST_CHECK_EQUAL(copy.index().size(), 1000);
+    BOOST_CHECK_EQUAL(copy.get_entry("10"), (dir_entry *)nullptr);
+
+    dir_entry *foo_copy = copy.get_entry("foo");
+
+    BOOST_REQUIRE(foo_copy);
+    BOOST_CHECK(foo_copy != foo);
+    BOOST_CHECK_EQUAL(foo_copy->subpath().path(), "foo");
+
+    size_t n = 0;
+    for (dir_entry &ent : copy.index()) {
+        BOOST_CHECK(ent.file_name() != "10");
+        n++;
+    }
+
+    BOOST_CHECK_EQUAL(n, 1000);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -128,7 +169,7 @@ BOOST_AUTO_TEST_CASE(add_entry) {
     BOOST_CHECK_EQUAL(foo->subpath().path(), "foo.txt");
     BOOST_CHECK_EQUAL(foo->type(), dir_entry::type_reg);
     BOOST_CHECK_EQUAL(foo->ent_type(), dir_entry::type_lnk);
-    BOOST_CHECK_EQUAL(foo->attr().st_mode & ~S_IFMT, S_IRWXU);
+    BOOST_CHECK_EQUAL(foo->attr().mode & ~S_IFMT, S_IRWXU);
     BOOST_CHECK_EQUAL(tree.get_entry("foo.txt"), foo);
 
     // Check bar.x
@@ -195,29 +236,27 @@ BOOST_AUTO_TEST_CASE(duplicates) {
     ent.type = DT_LNK;
 
     struct stat st{};
-    st.st_ino = 1;
+    st.st_size = 1;
     st.st_mode = S_IFREG | S_IRWXU;
 
     dir_entry *foo1 = tree.add_entry(ent, st);
 
     dir_entry *foo2 = tree.add_entry(dir_entry("foo", dir_entry::type_dir));
 
-    st.st_ino = 2;
+    st.st_size = 2;
     st.st_mode = S_IFREG | S_IRUSR;
     dir_entry *foo3 = tree.add_entry(dir_entry("foo", st));
 
     auto ents = tree.get_entries("foo");
-    BOOST_CHECK_EQUAL(std::distance(ents.first, ents.second), 3);
-
-    for (auto it = ents.first; it != ents.second; ++it) {
-        dir_entry *ent = &it->second;
+    BOOST_CHECK_EQUAL(ents.size(), 3);
 
+    for (dir_entry *ent : ents) {
         BOOST_CHECK_EQUAL(ent->subpath().path(), "foo");
 
         if (ent == foo1) {
             BOOST_CHECK_EQUAL(ent->ent_type(), dir_entry::type_lnk);
-            BOOST_CHECK_EQUAL(ent->attr().st_ino, 1);
-            BOOST_CHECK_EQUAL(ent->attr().st_mode, S_IFREG | S_IRWXU);
+            BOOST_CHECK_EQUAL(ent->attr().size, 1);
+            BOOST_CHECK_EQUAL(ent->attr().mode, S_IFREG | S_IRWXU);
 
             // Set to null in order for test to fail if foo1 is
             // duplicated
@@ -231,8 +270,8 @@ BOOST_AUTO_TEST_CASE(duplicates) {
             foo2 = nullptr;
         }
         else if (ent == foo3) {
-            BOOST_CHECK_EQUAL(ent->attr().st_ino, 2);
-            BOOST_CHECK_EQUAL(ent->attr().st_mode, S_IFREG | S_IRUSR);
+            BOOST_CHECK_EQUAL(ent->attr().size, 2);
+            BOOST_CHECK_EQUAL(ent->attr().mode, S_IFREG | S_IRUSR);
 
             // Set to null in order for test to fail if foo1 is
             // duplicated
@@ -269,7 +308,7 @@ BOOST_AUTO_TEST_CASE(directories) {
         ent.name = "foo";
         ent.type = DT_DIR;
 
-        st.st_ino = 100;
+        st.st_size = 100;
 
         tree.add_entry(ent, st);
     }
@@ -282,7 +321,7 @@ BOOST_AUTO_TEST_CASE(directories) {
         ent.name = "bar";
         ent.type = DT_DIR;
 
-        st.st_ino = 500;
+        st.st_size = 500;
 
         tree.add_entry(ent, st);
     }
@@ -297,13 +336,13 @@ BOOST_AUTO_TEST_CASE(directories) {
 
     dir_entry *foo = tree.get_entry("foo");
     BOOST_REQUIRE(foo);
-    BOOST_CHECK_EQUAL(foo->attr().st_ino, 100);
+    BOOST_CHECK_EQUAL(foo->attr().size, 100);
 
     // Check bar directory
 
     dir_entry *bar = tree.get_entry("bar");
     BOOST_REQUIRE(bar);
-    BOOST_CHECK_EQUAL(bar->attr().st_ino, 500);
+    BOOST_CHECK_EQUAL(bar->attr().size, 500);
 }
 
 BOOST_AUTO_TEST_SUITE_END()